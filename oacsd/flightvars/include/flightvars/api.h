@@ -19,6 +19,10 @@
 #ifndef OAC_FV_API_H
 #define OAC_FV_API_H
 
+#include <vector>
+
+#include <boost/chrono.hpp>
+
 #include <liboac/exception.h>
 
 #include <flightvars/subscription.h>
@@ -73,6 +77,11 @@ public:
    typedef std::function<void(const variable_id& id,
                               const variable_value& value)> var_update_handler;
 
+   /**
+    * A list of subscription IDs.
+    */
+   typedef std::vector<subscription_id> subscription_id_list;
+
    virtual ~flight_vars() {}
 
    /**
@@ -96,6 +105,23 @@ public:
    virtual void unsubscribe(const subscription_id& id)
    throw (no_such_subscription_error) = 0;
 
+   /**
+    * Remove all the subscriptions with the given IDs at once. Unlike
+    * unsubscribe(), unknown subscriptions are ignored. The default
+    * implementation removes them one by one, so implementations which may
+    * remove them more efficiently are encouraged to override it.
+    *
+    * @param ids  The IDs of the subscriptions to be removed
+    */
+   virtual void unsubscribe_all(const subscription_id_list& ids)
+   {
+      for (auto& id : ids)
+      {
+         try { unsubscribe(id); }
+         catch (const no_such_subscription_error&) {}
+      }
+   }
+
    /**
     * Update a variable by replacing its value with the given one.
     *
@@ -107,6 +133,20 @@ public:
          const subscription_id& subs_id,
          const variable_value& var_value)
    throw (no_such_subscription_error, illegal_value_error) = 0;
+
+   /**
+    * Request the variable of the given subscription to be read at least
+    * once every given interval. This is a hint for those implementations
+    * that poll their variables; the default implementation ignores it.
+    *
+    * @param subs_id the ID of the subscription to the variable
+    * @param interval the maximum time between two reads of the variable
+    */
+   virtual void set_max_polling_interval(
+         const subscription_id& subs_id,
+         const boost::chrono::milliseconds& interval)
+   throw (no_such_subscription_error)
+   {}
 };
 
 }} // namespace oac::fv
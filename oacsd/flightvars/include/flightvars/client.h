@@ -53,6 +53,19 @@ public:
          const var_update_handler& handler)
    throw (no_such_variable_error);
 
+   /**
+    * Subscribe to a variable requesting the given QoS to the server. The
+    * QoS is only sent to servers that negotiated
+    * PROTOCOL_VERSION_SUBSCRIPTION_QOS or newer, and it is ignored when
+    * the variable is already subscribed by this client, since all the
+    * subscriptions to a variable share the same one in the server.
+    */
+   subscription_id subscribe(
+         const variable_id& var,
+         const var_update_handler& handler,
+         const boost::optional<subs::subscription_qos>& qos)
+   throw (no_such_variable_error);
+
    virtual void unsubscribe(
          const subscription_id& id)
    throw (no_such_subscription_error);
@@ -71,6 +71,8 @@ public:
 
 private:
 
+   struct in_place_dispatcher;
+
    typedef buffer::ring_buffer input_buffer_type;
    typedef buffer::linear_buffer output_buffer_type;
    typedef output_buffer_type::ptr_type output_buffer_ptr;
@@ -80,6 +82,9 @@ private:
    std::shared_ptr<boost::asio::io_service> _io_service;
    network::async_tcp_client _client;
    input_buffer_type _input_buffer;
+   buffer::buffer_pool<output_buffer_type> _output_buffers;
+   proto::protocol_version _proto_ver;
+   proto::frame_decoder _frames;
    std::thread _client_thread;
    subscription_db _db;
    request_pool _request_pool;
@@ -108,6 +113,9 @@ private:
    void on_message_received(
          const attempt<std::size_t>& bytes_read);
 
+   void dispatch_message(
+         const proto::message& msg);
+
    void on_subscription_reply_received(
          const proto::subscription_reply_message& msg);
 
@@ -117,6 +125,18 @@ private:
    void on_variable_update_received(
          const proto::var_update_message& msg);
 
+   void on_variable_update_batch_received(
+         const proto::var_update_batch_message& msg);
+
+   bool supports_framing() const
+   { return _proto_ver >= proto::PROTOCOL_VERSION_FRAMED; }
+
+   bool supports_qos() const
+   { return _proto_ver >= proto::PROTOCOL_VERSION_SUBSCRIPTION_QOS; }
+
+   template <typename Message>
+   void serialize_message(const Message& msg, output_buffer_type& buff);
+
    template <typename Message>
    void send_message(const Message& msg);
 
@@ -23,6 +23,8 @@
 #include <list>
 #include <unordered_map>
 
+#include <boost/optional.hpp>
+
 #include <liboac/exception.h>
 #include <liboac/logging.h>
 
@@ -120,9 +122,11 @@ public:
 
    subscription_request(
          const variable_id& var_id,
-         const flight_vars::var_update_handler& handler)
+         const flight_vars::var_update_handler& handler,
+         const boost::optional<subs::subscription_qos>& qos = boost::none)
       : _var_id(var_id),
-        _handler(handler)
+        _handler(handler),
+        _qos(qos)
    {}
 
    const variable_id& var_id() const
@@ -131,10 +135,14 @@ public:
    const flight_vars::var_update_handler& handler() const
    { return _handler; }
 
+   const boost::optional<subs::subscription_qos>& qos() const
+   { return _qos; }
+
 private:
 
    variable_id _var_id;
    flight_vars::var_update_handler _handler;
+   boost::optional<subs::subscription_qos> _qos;
 };
 
 typedef std::shared_ptr<subscription_request> subscription_request_ptr;
@@ -24,6 +24,7 @@
 
 #include <liboac/logging.h>
 #include <liboac/network.h>
+#include <liboac/slot_map.h>
 
 #include <flightvars/api.h>
 #include <flightvars/subscription.h>
@@ -239,7 +240,13 @@ private:
 
    std::unordered_map<variable_id, entry_ptr, variable_id_hash> _var_id_map;
    std::unordered_map<subscription_id, entry_ptr> _master_subs_id_map;
-   std::unordered_map<subscription_id, entry_ptr> _virtual_subs_id_map;
+
+   /**
+    * The virtual subscription IDs are issued by this slot map, so looking
+    * them up requires no hashing and the IDs of removed virtual
+    * subscriptions are never confused with new ones.
+    */
+   slot_map<entry_ptr> _virtual_subs_id_map;
 
    bool variable_defined(
          const variable_id& var_id) const;
@@ -20,6 +20,10 @@
 #define OAC_FV_CORE_H
 
 #include <map>
+#include <memory>
+
+#include <boost/thread.hpp>
+#include <liboac/slot_map.h>
 
 #include <flightvars/api.h>
 
@@ -31,6 +35,18 @@ namespace oac { namespace fv {
  * of Flight Vars. It is implemented as a singleton so any other module
  * running in the simulator is able to interact with the core object in
  * order to register a new variable group master.
+ *
+ * The core may be used from any thread. Its routing tables are immutable
+ * snapshots which are replaced as a whole on modification (copy on write),
+ * so the lookups on the update path never wait for a modification in
+ * progress: they only copy the pointer to the current snapshot.
+ * Modifications are serialized by a mutex and are expected to be rare
+ * compared to updates.
+ *
+ * The subscription IDs returned by the core are issued by the core itself,
+ * and they are mapped to the subscription IDs issued by the group masters.
+ * Since they are slot map keys, routing an update is an array access, and
+ * stale IDs are reliably detected.
  */
 class flight_vars_core : public flight_vars
 {
@@ -61,11 +77,23 @@ public:
          const subscription_id& id)
    throw (no_such_subscription_error);
 
+   /**
+    * Remove the given subscriptions with a single snapshot modification,
+    * and let each group master remove its own ones at once.
+    */
+   virtual void unsubscribe_all(
+         const subscription_id_list& ids);
+
    virtual void update(
          const subscription_id& subs_id,
          const variable_value& var_value)
    throw (no_such_subscription_error, illegal_value_error);
 
+   virtual void set_max_polling_interval(
+         const subscription_id& subs_id,
+         const boost::chrono::milliseconds& interval)
+   throw (no_such_subscription_error);
+
    /**
     * Register a master for given variable group. If there is already a
     * master for given group, a master_already_registered is thrown.
@@ -80,21 +108,46 @@ private:
    typedef std::map<
          variable_group,
          std::shared_ptr<flight_vars>> group_master_dict;
-   typedef std::map<
-         subscription_id,
-         std::shared_ptr<flight_vars>> subscription_master_dict;
+   /**
+    * The group master which attends a subscription, and the ID of the
+    * subscription issued by it.
+    */
+   struct subscription_route
+   {
+      std::shared_ptr<flight_vars> master;
+      subscription_id master_subs_id;
+   };
+
+   typedef slot_map<subscription_route> subscription_master_dict;
+
+   typedef std::shared_ptr<const group_master_dict> group_master_snapshot;
+   typedef std::shared_ptr<const subscription_master_dict>
+         subscription_master_snapshot;
+
+   /**
+    * The current snapshots of the routing tables. They must be accessed
+    * using the atomic operations for shared pointers.
+    */
+   group_master_snapshot _group_masters;
+   subscription_master_snapshot _subscriptions;
 
-   group_master_dict _group_masters;
-   subscription_master_dict _subscriptions;
+   /** The mutex which serializes the modification of the snapshots. */
+   boost::mutex _write_mutex;
 
-   flight_vars_core() {}
+   flight_vars_core();
 
-   std::shared_ptr<flight_vars>& get_master_by_var_id(
+   std::shared_ptr<flight_vars> get_master_by_var_id(
          const variable_id& var_id)
    throw (no_such_variable_error);
 
-   std::shared_ptr<flight_vars> get_master_by_subs_id(
-         const subscription_id& subs_id);
+   /**
+    * Obtain the route for given subscription, if any, from the current
+    * snapshot. The snapshot is returned as well, so the route remains
+    * valid while it is in use.
+    */
+   const subscription_route* get_route_by_subs_id(
+         const subscription_id& subs_id,
+         subscription_master_snapshot& snapshot);
 };
 
 }} // namespace oac::fv
@@ -57,6 +57,34 @@ throw (protocol_exception, io_exception)
    return subscription_request_message(var_grp, var_name);
 }
 
+template <typename Deserializer, typename InputStream>
+subscription_request_message
+deserialize_subscription_qos_request_contents(
+      InputStream& input)
+throw (protocol_exception, io_exception)
+{
+   auto var_grp = Deserializer::read_string_value(input);
+   auto var_name = Deserializer::read_string_value(input);
+   auto min_interval = Deserializer::read_uint32_value(input);
+   auto deadband_type = Deserializer::read_uint8_value(input);
+   auto deadband = Deserializer::read_float_value(input);
+   auto priority = Deserializer::read_uint8_value(input);
+   auto max_interval = Deserializer::read_uint32_value(input);
+   if (deadband_type > std::uint8_t(subs::deadband_kind::RELATIVE_DELTA))
+      OAC_THROW_EXCEPTION(invalid_qos_code(deadband_type));
+   if (priority >= subs::SUBSCRIPTION_PRIORITY_COUNT)
+      OAC_THROW_EXCEPTION(invalid_qos_code(priority));
+   return subscription_request_message(
+            var_grp,
+            var_name,
+            subs::subscription_qos(
+                  min_interval,
+                  static_cast<subs::deadband_kind>(deadband_type),
+                  deadband,
+                  static_cast<subs::subscription_priority>(priority),
+                  max_interval));
+}
+
 template <typename Deserializer, typename InputStream>
 subscription_reply_message
 deserialize_subscription_reply_contents(
@@ -96,46 +124,60 @@ throw (protocol_exception, io_exception)
 }
 
 template <typename Deserializer, typename InputStream>
-var_update_message
-deserialize_var_update_contents(
+variable_value
+deserialize_var_value(
       InputStream& input)
 throw (protocol_exception, io_exception)
 {
-   auto subs_id = Deserializer::read_uint32_value(input);
    auto var_type = Deserializer::read_uint8_value(input);
    switch (var_type)
    {
       case variable_type::BOOLEAN:
-         return var_update_message(
-                  subs_id,
-                  variable_value::from_bool(
-                     (Deserializer::read_uint8_value(input) > 0) ?
-                                         true : false));
+         return variable_value::from_bool(
+               (Deserializer::read_uint8_value(input) > 0) ? true : false);
       case variable_type::BYTE:
-         return var_update_message(
-                  subs_id,
-                  variable_value::from_byte(
-                     Deserializer::read_uint8_value(input)));
+         return variable_value::from_byte(
+               Deserializer::read_uint8_value(input));
       case variable_type::WORD:
-         return var_update_message(
-                  subs_id,
-                  variable_value::from_word(
-                     Deserializer::read_uint16_value(input)));
+         return variable_value::from_word(
+               Deserializer::read_uint16_value(input));
       case variable_type::DWORD:
-         return var_update_message(
-                  subs_id,
-                  variable_value::from_dword(
-                     Deserializer::read_uint32_value(input)));
+         return variable_value::from_dword(
+               Deserializer::read_uint32_value(input));
       case variable_type::FLOAT:
-         return var_update_message(
-                  subs_id,
-                  variable_value::from_float(
-                     Deserializer::read_float_value(input)));
+         return variable_value::from_float(
+               Deserializer::read_float_value(input));
       default:
          OAC_THROW_EXCEPTION(invalid_variable_type(var_type));
    }
 }
 
+template <typename Deserializer, typename InputStream>
+var_update_message
+deserialize_var_update_contents(
+      InputStream& input)
+throw (protocol_exception, io_exception)
+{
+   auto subs_id = Deserializer::read_uint32_value(input);
+   auto var_value = deserialize_var_value<Deserializer>(input);
+   return var_update_message(subs_id, var_value);
+}
+
+template <typename Deserializer, typename InputStream>
+var_update_batch_message
+deserialize_var_update_batch_contents(
+      InputStream& input)
+throw (protocol_exception, io_exception)
+{
+   var_update_batch_message msg;
+   auto count = Deserializer::read_uint16_value(input);
+   msg.updates.reserve(count);
+   for (unsigned int i = 0; i < count; i++)
+      msg.updates.push_back(
+            deserialize_var_update_contents<Deserializer>(input));
+   return msg;
+}
+
 template <typename Deserializer, typename InputStream>
 message
 deserialize(
@@ -164,6 +206,13 @@ throw (protocol_exception, io_exception)
          Deserializer::read_msg_end(input);
          return msg;
       }
+      case message_type::SUBSCRIPTION_QOS_REQ:
+      {
+         auto msg = deserialize_subscription_qos_request_contents<Deserializer>(
+                  input);
+         Deserializer::read_msg_end(input);
+         return msg;
+      }
       case message_type::SUBSCRIPTION_REP:
       {
          auto msg = deserialize_subscription_reply_contents<Deserializer>(
@@ -191,6 +240,13 @@ throw (protocol_exception, io_exception)
          Deserializer::read_msg_end(input);
          return msg;
       }
+      case message_type::VAR_UPDATE_BATCH:
+      {
+         auto msg = deserialize_var_update_batch_contents<Deserializer>(
+                  input);
+         Deserializer::read_msg_end(input);
+         return msg;
+      }
       default:
          OAC_THROW_EXCEPTION(invalid_message_type(int(msg_begin)));
    }
@@ -0,0 +1,137 @@
+/*
+ * This file is part of Open Airbus Cockpit
+ * Copyright (C) 2012, 2013 Alvaro Polo
+ *
+ * Open Airbus Cockpit is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Open Airbus Cockpit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Open Airbus Cockpit. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OAC_FV_PROTO_ENCODED_H
+#define OAC_FV_PROTO_ENCODED_H
+
+#include <algorithm>
+#include <cstring>
+
+#include <liboac/io.h>
+#include <liboac/stream.h>
+
+#include <flightvars/proto/serial.h>
+
+namespace oac { namespace fv { namespace proto {
+
+/**
+ * A variable update whose subscription ID and value are already serialized.
+ * The serialized form of an update is the same in var update messages and
+ * in var update batch messages, so it may be encoded once and then copied
+ * into the messages sent to every subscribed peer. It conforms the
+ * OutputStream concept, so serializers write into it directly. It never
+ * allocates memory.
+ */
+class encoded_var_update
+{
+public:
+
+   /**
+    * The maximum number of bytes of an encoded update.
+    */
+   static const std::size_t MAX_SIZE = 16;
+
+   encoded_var_update() : _subs_id(0), _size(0) {}
+
+   encoded_var_update(const subscription_id& subs_id)
+      : _subs_id(subs_id), _size(0)
+   {}
+
+   /**
+    * The subscription ID of the encoded update. It is kept besides its
+    * encoded form so updates may be conflated without decoding them.
+    */
+   subscription_id subs_id() const
+   { return _subs_id; }
+
+   std::size_t write(const void* src, std::size_t count)
+   {
+      auto nwrite = std::min(count, MAX_SIZE - _size);
+      std::memcpy(_data + _size, src, nwrite);
+      _size += nwrite;
+      return nwrite;
+   }
+
+   void flush() {}
+
+   const std::uint8_t* data() const
+   { return _data; }
+
+   std::size_t size() const
+   { return _size; }
+
+private:
+
+   subscription_id _subs_id;
+   std::uint8_t _data[MAX_SIZE];
+   std::size_t _size;
+};
+
+/**
+ * Encode the update of given variable value for given subscription.
+ */
+template <typename Serializer>
+encoded_var_update
+encode_var_update(
+      const subscription_id& subs_id,
+      const variable_value& var_value)
+throw (io_exception)
+{
+   encoded_var_update result(subs_id);
+   Serializer::write_uint32_value(result, subs_id);
+   serialize_var_value<Serializer>(var_value, result);
+   return result;
+}
+
+/**
+ * Serialize a var update message from an already encoded update.
+ */
+template <typename Serializer, typename OutputStream>
+void
+serialize_encoded_var_update(
+      const encoded_var_update& update,
+      OutputStream& output)
+throw (io_exception)
+{
+   Serializer::write_msg_begin(output, message_type::VAR_UPDATE);
+   stream::write_all(output, update.data(), update.size());
+   Serializer::write_msg_end(output);
+}
+
+/**
+ * Serialize a var update batch message from the already encoded updates
+ * in range [first, last).
+ */
+template <typename Serializer, typename InputIterator, typename OutputStream>
+void
+serialize_encoded_var_update_batch(
+      InputIterator first,
+      InputIterator last,
+      OutputStream& output)
+throw (io_exception)
+{
+   Serializer::write_msg_begin(output, message_type::VAR_UPDATE_BATCH);
+   Serializer::write_uint16_value(output, std::distance(first, last));
+   for (; first != last; ++first)
+      stream::write_all(output, first->data(), first->size());
+   Serializer::write_msg_end(output);
+}
+
+}}} // namespace oac::fv::proto
+
+#endif
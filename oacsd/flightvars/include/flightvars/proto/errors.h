@@ -46,6 +46,14 @@ OAC_DECL_EXCEPTION_WITH_PARAMS(invalid_variable_type, protocol_exception,
    ("invalid variable type code 0x%x received", var_code),
    (var_code, std::uint8_t));
 
+/**
+ * An exception indicating a invalid deadband kind or priority code of a
+ * subscription QoS while deserializing.
+ */
+OAC_DECL_EXCEPTION_WITH_PARAMS(invalid_qos_code, protocol_exception,
+   ("invalid subscription QoS code 0x%x received", qos_code),
+   (qos_code, std::uint8_t));
+
 /**
  * An exception indicating a invalid message type code while deserializing.
  */
@@ -64,6 +72,27 @@ OAC_DECL_EXCEPTION_WITH_PARAMS(invalid_termination_mark, protocol_exception,
    ),
    (termination_mark, std::uint16_t));
 
+/**
+ * An exception indicating a frame whose length cannot be handled by the
+ * receiver.
+ */
+OAC_DECL_EXCEPTION_WITH_PARAMS(invalid_frame_length, protocol_exception,
+   ("invalid frame length %d received", frame_length),
+   (frame_length, std::size_t));
+
+/**
+ * An exception indicating a frame whose contents do not match the length
+ * declared in its header.
+ */
+OAC_DECL_EXCEPTION_WITH_PARAMS(frame_length_mismatch, protocol_exception,
+   (
+      "frame declares %d bytes, but its message comprises %d bytes",
+      declared_length,
+      actual_length
+   ),
+   (declared_length, std::size_t),
+   (actual_length, std::size_t));
+
 }}} // namespace oac::fv::proto
 
 #endif
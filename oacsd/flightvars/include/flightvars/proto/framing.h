@@ -0,0 +1,232 @@
+/*
+ * This file is part of Open Airbus Cockpit
+ * Copyright (C) 2012, 2013 Alvaro Polo
+ *
+ * Open Airbus Cockpit is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Open Airbus Cockpit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Open Airbus Cockpit. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OAC_FV_PROTO_FRAMING_H
+#define OAC_FV_PROTO_FRAMING_H
+
+#include <vector>
+
+#include <boost/optional.hpp>
+
+#include <liboac/io.h>
+#include <liboac/stream.h>
+
+#include <flightvars/proto/deserial.h>
+#include <flightvars/proto/serial.h>
+#include <flightvars/proto/view.h>
+
+namespace oac { namespace fv { namespace proto {
+
+/**
+ * The length of a frame, excluding the frame header. The frame header is
+ * the length itself, encoded as a 16-bits unsigned integer.
+ */
+typedef std::uint16_t frame_length;
+
+/**
+ * The number of bytes occupied by the header of a frame.
+ */
+const std::size_t FRAME_HEADER_SIZE = sizeof(frame_length);
+
+/**
+ * The maximum number of bytes a frame may contain.
+ */
+const std::size_t MAX_FRAME_LENGTH = UINT16_MAX;
+
+/**
+ * An output stream that discards the written bytes and just counts them.
+ * It is used to determine the length of a message before serializing it.
+ */
+class frame_length_counter
+{
+public:
+
+   frame_length_counter() : _count(0) {}
+
+   std::size_t write(const void* src, std::size_t count)
+   { _count += count; return count; }
+
+   void flush() {}
+
+   std::size_t count() const
+   { return _count; }
+
+private:
+
+   std::size_t _count;
+};
+
+/**
+ * Serialize given message encapsulated into a frame. The message is
+ * serialized as usual, preceded by a header indicating its length.
+ */
+template <typename Serializer, typename OutputStream>
+void
+serialize_frame(
+      const message& msg,
+      OutputStream& output)
+throw (protocol_exception, io_exception)
+{
+   frame_length_counter counter;
+   serialize<Serializer>(msg, counter);
+   if (counter.count() > MAX_FRAME_LENGTH)
+      OAC_THROW_EXCEPTION(invalid_frame_length(counter.count()));
+   Serializer::write_uint16_value(output, frame_length(counter.count()));
+   serialize<Serializer>(msg, output);
+}
+
+/**
+ * Serialize a message encapsulated into a frame using given message writer.
+ * The writer is a function object that serializes the message into the
+ * output stream passed as argument. It is invoked with different stream
+ * types, so it must provide a template function call operator. This makes
+ * possible to frame messages which are not represented by message objects,
+ * as the ones built from encoded var updates.
+ */
+template <typename Serializer, typename MessageWriter, typename OutputStream>
+void
+serialize_frame_with(
+      const MessageWriter& writer,
+      OutputStream& output)
+throw (protocol_exception, io_exception)
+{
+   frame_length_counter counter;
+   writer(counter);
+   if (counter.count() > MAX_FRAME_LENGTH)
+      OAC_THROW_EXCEPTION(invalid_frame_length(counter.count()));
+   Serializer::write_uint16_value(output, frame_length(counter.count()));
+   writer(output);
+}
+
+/**
+ * A resumable decoder of frames. It consumes the header of the next frame
+ * as soon as it is available in the input stream, and remembers its
+ * length across invocations. That makes possible to determine whether a
+ * complete frame was received before parsing any message, so a fragmented
+ * frame is never parsed more than once.
+ *
+ * The InputStream type used with this decoder must be a Buffer providing
+ * available_for_read() function, as ring_buffer or linear_buffer do.
+ * Decoding in place additionally requires read_region() and skip().
+ */
+class frame_decoder
+{
+public:
+
+   frame_decoder() {}
+
+   /**
+    * Check whether the next frame is completely available in given input
+    * buffer. If the header of the frame is available but it was not read
+    * yet, it is consumed. It never fails because of lack of data.
+    */
+   template <typename Deserializer, typename InputStream>
+   bool frame_ready(InputStream& input)
+   throw (protocol_exception, io_exception)
+   {
+      if (!_pending_length)
+      {
+         if (input.available_for_read() < FRAME_HEADER_SIZE)
+            return false;
+         _pending_length = Deserializer::read_uint16_value(input);
+      }
+      return input.available_for_read() >= *_pending_length;
+   }
+
+   /**
+    * Decode the message contained in the next frame. It is a precondition
+    * for this function that frame_ready() returned true.
+    */
+   template <typename Deserializer, typename InputStream>
+   message decode(InputStream& input)
+   throw (protocol_exception, io_exception)
+   {
+      auto expected_length = *_pending_length;
+      auto available = input.available_for_read();
+      _pending_length.reset();
+      try
+      {
+         auto msg = deserialize<Deserializer>(input);
+         auto actual_length = available - input.available_for_read();
+         if (actual_length != expected_length)
+            OAC_THROW_EXCEPTION(
+                  frame_length_mismatch(expected_length, actual_length));
+         return msg;
+      }
+      catch (const io::eof_error& e)
+      {
+         // The frame is complete, so the message is longer than declared
+         OAC_THROW_EXCEPTION(
+               frame_length_mismatch(expected_length, available, e));
+      }
+   }
+
+   /**
+    * Decode the message contained in the next frame in place, passing it
+    * to the given visitor as deserialize_in_place() does. The objects
+    * passed to the visitor refer to the input buffer, so they are only
+    * valid during the visitor invocation. If the frame is not contiguous
+    * in the input buffer, it is first copied into an internal scratch
+    * area. It is a precondition for this function that frame_ready()
+    * returned true.
+    */
+   template <typename InputStream, typename Visitor>
+   void decode_in_place(InputStream& input, Visitor& visitor)
+   throw (protocol_exception, io_exception)
+   {
+      auto expected_length = *_pending_length;
+      _pending_length.reset();
+
+      auto region = input.read_region();
+      auto contiguous = boost::asio::buffer_size(region) >= expected_length;
+      if (!contiguous)
+      {
+         if (_scratch.size() < expected_length)
+            _scratch.resize(expected_length);
+         stream::read_all(input, _scratch.data(), expected_length);
+         region = boost::asio::const_buffer(_scratch.data(), expected_length);
+      }
+
+      region_input_stream frame(boost::asio::buffer(region, expected_length));
+      try
+      {
+         deserialize_in_place(frame, visitor);
+      }
+      catch (const io::eof_error& e)
+      {
+         // The frame is shorter than the message it contains
+         OAC_THROW_EXCEPTION(invalid_frame_length(expected_length, e));
+      }
+      if (frame.available_for_read())
+         OAC_THROW_EXCEPTION(
+               frame_length_mismatch(
+                     expected_length,
+                     expected_length - frame.available_for_read()));
+      if (contiguous)
+         input.skip(expected_length);
+   }
+
+private:
+
+   boost::optional<frame_length> _pending_length;
+   std::vector<std::uint8_t> _scratch;
+};
+
+}}} // namespace oac::fv::proto
+
+#endif
@@ -19,6 +19,9 @@
 #ifndef OAC_FV_PROTO_MESSAGES_H
 #define OAC_FV_PROTO_MESSAGES_H
 
+#include <vector>
+
+#include <boost/optional.hpp>
 #include <boost/variant.hpp>
 
 #include <flightvars/proto/errors.h>
@@ -66,11 +69,22 @@ struct subscription_request_message
    variable_group var_grp;
    variable_name var_name;
 
+   /**
+    * The quality of service and priority requested for the subscription,
+    * if any. When
+    * present, the request is sent as a subscription with QoS request,
+    * which is only understood by peers that negotiated
+    * PROTOCOL_VERSION_SUBSCRIPTION_QOS or newer.
+    */
+   boost::optional<subs::subscription_qos> qos;
+
    subscription_request_message(
          const variable_group& grp,
-         const variable_name& name)
+         const variable_name& name,
+         const boost::optional<subs::subscription_qos>& q = boost::none)
       : var_grp(grp),
-        var_name(name)
+        var_name(name),
+        qos(q)
    {}
 };
 
@@ -202,6 +216,27 @@ struct var_update_message
    {}
 };
 
+/**
+ * This message is sent by the server to report several variable updates at
+ * once. All the updates it carries were observed in the same tick, so the
+ * server sends at most one batch per session and tick rather than a var
+ * update message for each changed variable. It is only sent to peers that
+ * negotiated PROTOCOL_VERSION_VAR_UPDATE_BATCH or newer in the begin session
+ * message.
+ */
+struct var_update_batch_message
+{
+   typedef std::vector<var_update_message> update_list;
+
+   update_list updates;
+
+   var_update_batch_message() {}
+
+   var_update_batch_message(const update_list& updates)
+      : updates(updates)
+   {}
+};
+
 /**
  * This union wraps all kinds of messages into a single one.
  */
@@ -212,7 +247,8 @@ typedef boost::variant<
       subscription_reply_message,
       unsubscription_request_message,
       unsubscription_reply_message,
-      var_update_message
+      var_update_message,
+      var_update_batch_message
 > message;
 
 /**
@@ -267,6 +303,12 @@ get_message_type(
          return message_type::VAR_UPDATE;
       }
 
+      message_type operator()(const var_update_batch_message& msg) const
+      throw (io_exception)
+      {
+         return message_type::VAR_UPDATE_BATCH;
+      }
+
    } visit;
    return boost::apply_visitor(visit, msg);
 }
@@ -57,9 +57,25 @@ serialize_subscription_request(
       OutputStream& output)
 throw (io_exception)
 {
-   Serializer::write_msg_begin(output, message_type::SUBSCRIPTION_REQ);
-   Serializer::write_string_value(output, msg.var_grp);
-   Serializer::write_string_value(output, msg.var_name);
+   if (msg.qos)
+   {
+      Serializer::write_msg_begin(output, message_type::SUBSCRIPTION_QOS_REQ);
+      Serializer::write_string_value(output, msg.var_grp);
+      Serializer::write_string_value(output, msg.var_name);
+      Serializer::write_uint32_value(output, msg.qos->min_interval);
+      Serializer::write_uint8_value(
+               output, static_cast<int>(msg.qos->deadband_type));
+      Serializer::write_float_value(output, msg.qos->deadband);
+      Serializer::write_uint8_value(
+               output, static_cast<int>(msg.qos->priority));
+      Serializer::write_uint32_value(output, msg.qos->max_interval);
+   }
+   else
+   {
+      Serializer::write_msg_begin(output, message_type::SUBSCRIPTION_REQ);
+      Serializer::write_string_value(output, msg.var_grp);
+      Serializer::write_string_value(output, msg.var_name);
+   }
    Serializer::write_msg_end(output);
 }
 
@@ -107,47 +123,60 @@ throw (io_exception)
 
 template <typename Serializer, typename OutputStream>
 void
-serialize_var_update(
-      const var_update_message& msg,
+serialize_var_value(
+      const variable_value& var_value,
       OutputStream& output)
 throw (io_exception)
 {
-   auto var_type = msg.var_value.get_type();
-   Serializer::write_msg_begin(output, message_type::VAR_UPDATE);
-   Serializer::write_uint32_value(output, msg.subs_id);
+   auto var_type = var_value.get_type();
+   Serializer::write_uint8_value(output, var_type_to_code(var_type));
    switch (var_type)
    {
       case variable_type::BOOLEAN:
-         Serializer::write_uint8_value(
-                  output, var_type_to_code(variable_type::BOOLEAN));
-         Serializer::write_uint8_value(
-                  output, msg.var_value.as_bool() ? 1 : 0);
+         Serializer::write_uint8_value(output, var_value.as_bool() ? 1 : 0);
          break;
       case variable_type::BYTE:
-         Serializer::write_uint8_value(
-                  output, var_type_to_code(variable_type::BYTE));
-         Serializer::write_uint8_value(
-                  output, msg.var_value.as_byte());
+         Serializer::write_uint8_value(output, var_value.as_byte());
          break;
       case variable_type::WORD:
-         Serializer::write_uint8_value(
-                  output, var_type_to_code(variable_type::WORD));
-         Serializer::write_uint16_value(
-                  output, msg.var_value.as_word());
+         Serializer::write_uint16_value(output, var_value.as_word());
          break;
       case variable_type::DWORD:
-         Serializer::write_uint8_value(
-                  output, var_type_to_code(variable_type::DWORD));
-         Serializer::write_uint32_value(
-                  output, msg.var_value.as_dword());
+         Serializer::write_uint32_value(output, var_value.as_dword());
          break;
       case variable_type::FLOAT:
-         Serializer::write_uint8_value(
-                  output, var_type_to_code(variable_type::FLOAT));
-         Serializer::write_float_value(
-                  output, msg.var_value.as_float());
+         Serializer::write_float_value(output, var_value.as_float());
          break;
    }
+}
+
+template <typename Serializer, typename OutputStream>
+void
+serialize_var_update(
+      const var_update_message& msg,
+      OutputStream& output)
+throw (io_exception)
+{
+   Serializer::write_msg_begin(output, message_type::VAR_UPDATE);
+   Serializer::write_uint32_value(output, msg.subs_id);
+   serialize_var_value<Serializer>(msg.var_value, output);
+   Serializer::write_msg_end(output);
+}
+
+template <typename Serializer, typename OutputStream>
+void
+serialize_var_update_batch(
+      const var_update_batch_message& msg,
+      OutputStream& output)
+throw (io_exception)
+{
+   Serializer::write_msg_begin(output, message_type::VAR_UPDATE_BATCH);
+   Serializer::write_uint16_value(output, msg.updates.size());
+   for (auto& update : msg.updates)
+   {
+      Serializer::write_uint32_value(output, update.subs_id);
+      serialize_var_value<Serializer>(update.var_value, output);
+   }
    Serializer::write_msg_end(output);
 }
 
@@ -213,6 +242,13 @@ throw (io_exception)
          return serialize_var_update<Serializer, OutputStream>(msg, output);
       }
 
+      void operator()(const var_update_batch_message& msg) const
+      throw (io_exception)
+      {
+         return serialize_var_update_batch<Serializer, OutputStream>(
+               msg, output);
+      }
+
    } visit(output);
    boost::apply_visitor(visit, msg);
 }
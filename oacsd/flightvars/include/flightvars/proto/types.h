@@ -23,7 +23,7 @@
 #include <string>
 
 #ifndef FLIGHTVARS_PROTOCOL_VERSION
-#define FLIGHTVARS_PROTOCOL_VERSION 0x0100
+#define FLIGHTVARS_PROTOCOL_VERSION 0x0103
 #endif
 
 namespace oac { namespace fv { namespace proto {
@@ -33,6 +33,25 @@ namespace oac { namespace fv { namespace proto {
  */
 typedef std::uint16_t protocol_version;
 
+/**
+ * The first protocol version which supports variable update batch messages.
+ * Peers negotiating an older version only exchange single var updates.
+ */
+const protocol_version PROTOCOL_VERSION_VAR_UPDATE_BATCH = 0x0101;
+
+/**
+ * The first protocol version which encapsulates the messages exchanged after
+ * the begin session handshake into length-prefixed frames. Begin session
+ * messages are never framed, since the version is not known yet.
+ */
+const protocol_version PROTOCOL_VERSION_FRAMED = 0x0102;
+
+/**
+ * The first protocol version which supports subscription requests carrying
+ * a quality of service (minimum update interval and deadband).
+ */
+const protocol_version PROTOCOL_VERSION_SUBSCRIPTION_QOS = 0x0103;
+
 /**
  * The name of a peer that communicates using the protocol.
  */
@@ -50,7 +69,9 @@ enum class message_type
    SUBSCRIPTION_REP,
    UNSUBSCRIPTION_REQ,
    UNSUBSCRIPTION_REP,
-   VAR_UPDATE
+   VAR_UPDATE,
+   VAR_UPDATE_BATCH,
+   SUBSCRIPTION_QOS_REQ
 };
 
 /**
@@ -77,6 +98,10 @@ message_type_to_string(
          return "unsubscription reply message";
       case message_type::VAR_UPDATE:
          return "variable update message";
+      case message_type::VAR_UPDATE_BATCH:
+         return "variable update batch message";
+      case message_type::SUBSCRIPTION_QOS_REQ:
+         return "subscription with QoS request message";
       default:
          OAC_THROW_EXCEPTION(enum_out_of_range_error<message_type>(msg_type));
    }
@@ -0,0 +1,255 @@
+/*
+ * This file is part of Open Airbus Cockpit
+ * Copyright (C) 2012, 2013 Alvaro Polo
+ *
+ * Open Airbus Cockpit is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Open Airbus Cockpit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Open Airbus Cockpit. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OAC_FV_PROTO_VIEW_H
+#define OAC_FV_PROTO_VIEW_H
+
+#include <cmath>
+#include <cstring>
+
+#include <boost/asio/buffer.hpp>
+#include <boost/utility/string_ref.hpp>
+
+#include <liboac/io.h>
+
+#include <flightvars/proto/binary.h>
+#include <flightvars/proto/deserial.h>
+
+namespace oac { namespace fv { namespace proto {
+
+/**
+ * A non-owning reference to a string stored in an input buffer. It is only
+ * valid as long as the buffer contents are not modified.
+ */
+typedef boost::string_ref string_view;
+
+/**
+ * An input stream over a contiguous region of memory. Apart of conforming
+ * InputStream concept, it allows to consume its bytes in place without
+ * copying them.
+ */
+class region_input_stream
+{
+public:
+
+   region_input_stream(const void* data, std::size_t size)
+      : _next((const std::uint8_t*) data),
+        _end(_next + size)
+   {}
+
+   explicit region_input_stream(const boost::asio::const_buffer& region)
+      : _next(boost::asio::buffer_cast<const std::uint8_t*>(region)),
+        _end(_next + boost::asio::buffer_size(region))
+   {}
+
+   std::size_t read(void* dest, std::size_t count)
+   {
+      count = std::min(count, available_for_read());
+      std::memcpy(dest, _next, count);
+      _next += count;
+      return count;
+   }
+
+   std::size_t available_for_read() const
+   { return _end - _next; }
+
+   /**
+    * Obtain a pointer to the next count bytes of the region, and consume
+    * them. If there are not enough bytes, a eof_error is thrown.
+    */
+   const std::uint8_t* consume(std::size_t count)
+   throw (io::eof_error)
+   {
+      if (count > available_for_read())
+         OAC_THROW_EXCEPTION(io::eof_error());
+      auto result = _next;
+      _next += count;
+      return result;
+   }
+
+private:
+
+   const std::uint8_t* _next;
+   const std::uint8_t* _end;
+};
+
+/**
+ * A deserializer that decodes the fields in place from a region input
+ * stream. It conforms the same interface as binary_message_deserializer,
+ * so it may be used with deserialize() function. In addition, it is able
+ * to read strings as views to the region.
+ */
+struct binary_view_deserializer
+{
+   static message_type
+   read_msg_begin(region_input_stream& input)
+   throw (protocol_exception, io_exception)
+   {
+      return code_to_msg_type(read_uint16_value(input));
+   }
+
+   static void
+   read_msg_end(region_input_stream& input)
+   throw (protocol_exception, io_exception)
+   {
+      auto eol = read_uint16_value(input);
+      if (eol != 0x0d0a)
+         OAC_THROW_EXCEPTION(invalid_termination_mark(eol));
+   }
+
+   static string_view
+   read_string_view(region_input_stream& input)
+   throw (protocol_exception, io_exception)
+   {
+      auto str_len = read_uint16_value(input);
+      auto str = (const char*) input.consume(str_len);
+      return string_view(str, str_len);
+   }
+
+   static std::string
+   read_string_value(region_input_stream& input)
+   throw (protocol_exception, io_exception)
+   {
+      return read_string_view(input).to_string();
+   }
+
+   static std::uint8_t
+   read_uint8_value(region_input_stream& input)
+   throw (protocol_exception, io_exception)
+   {
+      return *input.consume(1);
+   }
+
+   static std::uint16_t
+   read_uint16_value(region_input_stream& input)
+   throw (protocol_exception, io_exception)
+   {
+      auto p = input.consume(2);
+      return std::uint16_t((p[0] << 8) | p[1]);
+   }
+
+   static std::uint32_t
+   read_uint32_value(region_input_stream& input)
+   throw (protocol_exception, io_exception)
+   {
+      auto p = input.consume(4);
+      return (std::uint32_t(p[0]) << 24) |
+             (std::uint32_t(p[1]) << 16) |
+             (std::uint32_t(p[2]) << 8) |
+             std::uint32_t(p[3]);
+   }
+
+   static float
+   read_float_value(region_input_stream& input)
+   throw (protocol_exception, io_exception)
+   {
+      // See binary_message_deserializer::read_float_value()
+      auto nsig = read_uint32_value(input);
+      auto exp = read_uint32_value(input);
+      float sig = nsig * 0.5f / UINT32_MAX + 0.5f;
+      return std::ldexp(sig, exp);
+   }
+};
+
+/**
+ * A subscription reply message whose strings refer to the input buffer.
+ * It must be converted into a subscription_reply_message if it is meant
+ * to outlive the buffer contents.
+ */
+struct subscription_reply_view
+{
+   subscription_status st;
+   string_view var_grp;
+   string_view var_name;
+   subscription_id subs_id;
+   string_view cause;
+
+   subscription_reply_message to_message() const
+   {
+      return subscription_reply_message(
+            st,
+            var_grp.to_string(),
+            var_name.to_string(),
+            subs_id,
+            cause.to_string());
+   }
+};
+
+inline subscription_reply_view
+deserialize_subscription_reply_view_contents(
+      region_input_stream& input)
+throw (protocol_exception, io_exception)
+{
+   typedef binary_view_deserializer deserializer;
+   subscription_reply_view result;
+   result.st = static_cast<subscription_status>(
+         deserializer::read_uint8_value(input));
+   result.var_grp = deserializer::read_string_view(input);
+   result.var_name = deserializer::read_string_view(input);
+   result.subs_id = deserializer::read_uint32_value(input);
+   result.cause = deserializer::read_string_view(input);
+   return result;
+}
+
+/**
+ * Deserialize the message contained in given region without copying its
+ * contents, and pass it to the visitor. Variable updates, including each
+ * one of the updates of a batch, are passed as var_update_message objects.
+ * Subscription replies are passed as subscription_reply_view objects. Any
+ * other message is passed as a message object.
+ */
+template <typename Visitor>
+void
+deserialize_in_place(
+      region_input_stream& input,
+      Visitor& visitor)
+throw (protocol_exception, io_exception)
+{
+   typedef binary_view_deserializer deserializer;
+   auto msg_start = input;
+   switch (deserializer::read_msg_begin(input))
+   {
+      case message_type::VAR_UPDATE:
+         visitor(deserialize_var_update_contents<deserializer>(input));
+         deserializer::read_msg_end(input);
+         break;
+      case message_type::VAR_UPDATE_BATCH:
+      {
+         auto count = deserializer::read_uint16_value(input);
+         for (unsigned int i = 0; i < count; i++)
+            visitor(deserialize_var_update_contents<deserializer>(input));
+         deserializer::read_msg_end(input);
+         break;
+      }
+      case message_type::SUBSCRIPTION_REP:
+      {
+         auto view = deserialize_subscription_reply_view_contents(input);
+         deserializer::read_msg_end(input);
+         visitor(view);
+         break;
+      }
+      default:
+         input = msg_start;
+         visitor(deserialize<deserializer>(input));
+         break;
+   }
+}
+
+}}} // namespace oac::fv::proto
+
+#endif
@@ -21,9 +21,12 @@
 
 #include <flightvars/proto/binary.h>
 #include <flightvars/proto/deserial.h>
+#include <flightvars/proto/encoded.h>
 #include <flightvars/proto/errors.h>
+#include <flightvars/proto/framing.h>
 #include <flightvars/proto/messages.h>
 #include <flightvars/proto/serial.h>
 #include <flightvars/proto/types.h>
+#include <flightvars/proto/view.h>
 
 #endif
@@ -21,6 +21,7 @@
 
 #include <flightvars/subscription/errors.h>
 #include <flightvars/subscription/mapper.h>
+#include <flightvars/subscription/qos.h>
 #include <flightvars/subscription/types.h>
 
 #endif
@@ -19,7 +19,7 @@
 #ifndef OAC_FV_SUBSCRIPTION_MAPPER_H
 #define OAC_FV_SUBSCRIPTION_MAPPER_H
 
-#include <boost/bimap.hpp>
+#include <unordered_map>
 
 #include <flightvars/subscription/errors.h>
 #include <flightvars/subscription/types.h>
@@ -99,9 +99,12 @@ public:
 
 private:
 
-   typedef boost::bimap<variable_id, subscription_id> map_type;
-
-   map_type _map;
+   // Variable IDs are not assignable, so they cannot be the keys of a
+   // bimap. Two hash maps are kept instead; the IDs they contain keep
+   // their interned entries alive while they are mapped.
+   std::unordered_map<
+         variable_id, subscription_id, variable_id_hash> _subs_ids;
+   std::unordered_map<subscription_id, variable_id> _var_ids;
 };
 
 }}} // namespace oac::fv::subs
@@ -0,0 +1,164 @@
+/*
+ * This file is part of Open Airbus Cockpit
+ * Copyright (C) 2012, 2013 Alvaro Polo
+ *
+ * Open Airbus Cockpit is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Open Airbus Cockpit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Open Airbus Cockpit. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OAC_FV_SUBSCRIPTION_QOS_H
+#define OAC_FV_SUBSCRIPTION_QOS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <boost/chrono.hpp>
+#include <boost/optional.hpp>
+
+#include <flightvars/var.h>
+
+namespace oac { namespace fv { namespace subs {
+
+/**
+ * The kind of deadband applied to a subscription.
+ */
+enum class deadband_kind
+{
+   /** No deadband: any change is notified. */
+   NONE,
+
+   /** The deadband is expressed in the units of the variable. */
+   ABSOLUTE_DELTA,
+
+   /** The deadband is a fraction of the last notified value. */
+   RELATIVE_DELTA
+};
+
+/**
+ * The priority class of a subscription. The updates of higher classes are
+ * sent to the client before the updates of lower ones.
+ */
+enum class subscription_priority
+{
+   /** Updates that must never wait for others, like warning lights. */
+   CRITICAL,
+
+   /** Regular updates. */
+   NORMAL,
+
+   /** Cosmetic updates. Only the last value of each tick is sent. */
+   BULK
+};
+
+/**
+ * The number of subscription priority classes.
+ */
+const std::size_t SUBSCRIPTION_PRIORITY_COUNT = 3;
+
+/**
+ * The quality of service requested for a subscription. Updates are not
+ * notified more often than the minimum interval, and a numeric value is
+ * not notified unless it differs from the last notified value by more than
+ * the deadband. Boolean values are not affected by the deadband.
+ *
+ * The maximum interval does not filter updates. It is a hint for the
+ * masters which poll their variables, so the variable is read at least
+ * once every that many milliseconds.
+ */
+struct subscription_qos
+{
+   /** The minimum interval between notifications in milliseconds. */
+   std::uint32_t min_interval;
+
+   deadband_kind deadband_type;
+
+   float deadband;
+
+   subscription_priority priority;
+
+   /** The maximum interval between polls in milliseconds, or 0 if none. */
+   std::uint32_t max_interval;
+
+   subscription_qos(
+         std::uint32_t min_interval = 0,
+         deadband_kind deadband_type = deadband_kind::NONE,
+         float deadband = 0.0f,
+         subscription_priority priority = subscription_priority::NORMAL,
+         std::uint32_t max_interval = 0)
+      : min_interval(min_interval),
+        deadband_type(deadband_type),
+        deadband(deadband),
+        priority(priority),
+        max_interval(max_interval)
+   {}
+
+   /**
+    * Check whether this QoS lets every update pass.
+    */
+   bool is_default() const
+   { return !min_interval && deadband_type == deadband_kind::NONE; }
+};
+
+/**
+ * A filter which enforces a subscription QoS on the updates of a variable.
+ * The updates suppressed because of the minimum interval are not discarded
+ * but deferred, so the last value is eventually notified once the interval
+ * elapses even if the variable does not change anymore.
+ */
+class qos_filter
+{
+public:
+
+   typedef boost::chrono::steady_clock clock;
+
+   qos_filter(const subscription_qos& qos = subscription_qos());
+
+   const subscription_qos& qos() const
+   { return _qos; }
+
+   /**
+    * Check whether the given update must be notified at the given instant.
+    * If so, it is considered as notified.
+    */
+   bool accept(
+         const variable_value& value,
+         const clock::time_point& now);
+
+   /**
+    * Check whether there is an update deferred by the minimum interval.
+    */
+   bool has_deferred() const
+   { return _deferred.is_initialized(); }
+
+   /**
+    * Obtain the deferred update if the minimum interval elapsed at the
+    * given instant. If so, it is considered as notified.
+    */
+   boost::optional<variable_value> take_deferred(
+         const clock::time_point& now);
+
+private:
+
+   subscription_qos _qos;
+   boost::optional<variable_value> _last_value;
+   clock::time_point _last_time;
+   boost::optional<variable_value> _deferred;
+
+   bool within_deadband(const variable_value& value) const;
+
+   bool within_interval(const clock::time_point& now) const;
+};
+
+}}} // namespace oac::fv::subs
+
+#endif
@@ -30,7 +30,7 @@ namespace oac { namespace fv {
 typedef std::uint32_t subscription_id;
 
 /**
- * Make a new random subscription ID.
+ * Make a new subscription ID. It is safe to call it from any thread.
  */
 subscription_id make_subscription_id();
 
@@ -19,6 +19,8 @@
 #ifndef OAC_FV_VAR_H
 #define OAC_FV_VAR_H
 
+#include <atomic>
+
 #include <boost/algorithm/string.hpp>
 #include <liboac/buffer.h>
 #include <liboac/exception.h>
@@ -30,6 +32,25 @@ typedef std::string variable_group;
 
 typedef std::string variable_name;
 
+/**
+ * A dense integer handle that univocally identifies a variable ID.
+ */
+typedef std::uint32_t variable_handle;
+
+/**
+ * The identifier of a variable, comprised by its group and its name. Group
+ * and name are interned in a process-wide table the first time the ID is
+ * constructed, and each distinct pair is assigned a variable handle. Once
+ * constructed, variable IDs are copied, compared and hashed by means of
+ * that handle, with no string processing.
+ *
+ * Interned entries are reference counted by the variable IDs that refer to
+ * them. When the last one is destroyed the entry is released and its
+ * handle may be reused for another pair, so names received from the
+ * network do not make the table grow without bound. Containers that are
+ * keyed by handle must keep a variable ID alive for as long as they
+ * contain it.
+ */
 struct variable_id
 {
 
@@ -38,6 +59,11 @@ struct variable_id
       (token, std::string)
    );
 
+   OAC_DECL_EXCEPTION_WITH_PARAMS(no_such_handle_error, oac::exception,
+      ("no variable ID is interned with handle %d", handle),
+      (handle, variable_handle)
+   );
+
    static variable_id
    parse(const std::string& var)
    {
@@ -48,22 +74,90 @@ struct variable_id
       return variable_id(tokens[0], tokens[1]);
    }
 
-   const variable_group group;
-   const variable_name name;
+   /**
+    * Obtain the variable ID interned with the given handle.
+    */
+   static variable_id
+   from_handle(variable_handle handle)
+   throw (no_such_handle_error);
+
+   /**
+    * Obtain the number of entries currently interned.
+    */
+   static std::size_t
+   interned_count();
+
+private:
+
+   struct entry
+   {
+      variable_group group;
+      variable_name name;
+      variable_handle handle;
+      std::atomic<std::uint32_t> refs;
+      bool live;
+
+      entry(variable_handle h) : handle(h), refs(0), live(false) {}
+
+   private:
+
+      entry(const entry&);
+      entry& operator = (const entry&);
+   };
+
+   entry* _entry;
+
+   static entry& intern(
+         const variable_group& group,
+         const variable_name& name);
+
+   static void release(entry& e);
+
+   /**
+    * Create a variable ID that adopts a reference already taken on e.
+    */
+   explicit variable_id(entry& e)
+      : _entry(&e),
+        group(e.group),
+        name(e.name)
+   {}
+
+public:
+
+   const variable_group& group;
+   const variable_name& name;
 
    variable_id(
          const variable_group& group,
          const variable_name& name)
-      : group(boost::algorithm::to_lower_copy(group)),
-        name(boost::algorithm::to_lower_copy(name))
+      : _entry(&intern(group, name)),
+        group(_entry->group),
+        name(_entry->name)
    {
    }
 
+   variable_id(const variable_id& var_id)
+      : _entry(var_id._entry),
+        group(_entry->group),
+        name(_entry->name)
+   {
+      _entry->refs.fetch_add(1, std::memory_order_relaxed);
+   }
+
+   ~variable_id()
+   {
+      if (_entry->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+         release(*_entry);
+   }
+
+   variable_handle handle() const
+   { return _entry->handle; }
+
    std::string to_string() const
    { return format("%s->%s", group, name); }
 
    bool operator == (const variable_id& var_id) const
-   { return group == var_id.group && name == var_id.name; }
+   { return _entry == var_id._entry; }
 
    bool operator < (const variable_id& var_id) const
    {
@@ -85,11 +179,9 @@ inline std::ostream& operator << (
  */
 struct variable_id_hash
 {
-   std::hash<std::string> str_hash;
-
    std::size_t operator()(const variable_id& var_id) const
    {
-      return str_hash(var_id.group) + str_hash(var_id.name);
+      return var_id.handle();
    }
 };
 
@@ -132,6 +224,10 @@ inline std::ostream& operator <<(
 
 
 
+/**
+ * The value of a variable. It is a tagged union stored inline, so it
+ * never requires dynamic memory and it is trivially copied.
+ */
 struct variable_value
 {
    OAC_DECL_EXCEPTION_WITH_PARAMS(invalid_type_error, oac::exception,
@@ -143,36 +239,83 @@ struct variable_value
       (expected_type, variable_type),
       (actual_type, variable_type));
 
-   bool operator == (const variable_value& val) const;
+   inline bool operator == (const variable_value& val) const
+   {
+      if (val._type != _type)
+         return false;
+      switch (_type)
+      {
+         case variable_type::BOOLEAN: return val._data.b == _data.b;
+         case variable_type::BYTE: return val._data.byte == _data.byte;
+         case variable_type::WORD: return val._data.word == _data.word;
+         case variable_type::DWORD: return val._data.dword == _data.dword;
+         case variable_type::FLOAT: return val._data.flt == _data.flt;
+         default:
+            OAC_THROW_EXCEPTION(enum_out_of_range_error<variable_type>(_type));
+      }
+   }
+
+   static variable_value from_bool(bool value)
+   { variable_value v(variable_type::BOOLEAN); v._data.b = value; return v; }
 
-   static variable_value from_bool(bool value);
-   static variable_value from_byte(std::uint8_t value);
-   static variable_value from_word(std::uint16_t value);
-   static variable_value from_dword(std::uint32_t value);
-   static variable_value from_float(float value);
+   static variable_value from_byte(std::uint8_t value)
+   { variable_value v(variable_type::BYTE); v._data.byte = value; return v; }
+
+   static variable_value from_word(std::uint16_t value)
+   { variable_value v(variable_type::WORD); v._data.word = value; return v; }
+
+   static variable_value from_dword(std::uint32_t value)
+   { variable_value v(variable_type::DWORD); v._data.dword = value; return v; }
+
+   static variable_value from_float(float value)
+   { variable_value v(variable_type::FLOAT); v._data.flt = value; return v; }
 
    inline variable_type get_type() const { return _type; }
 
-   bool as_bool() const throw (invalid_type_error);
-   std::uint8_t as_byte() const throw (invalid_type_error);
-   std::uint16_t as_word() const throw (invalid_type_error);
-   std::uint32_t as_dword() const throw (invalid_type_error);
-   float as_float() const throw (invalid_type_error);
+   inline bool as_bool() const throw (invalid_type_error)
+   { check_type(variable_type::BOOLEAN); return _data.b; }
+
+   inline std::uint8_t as_byte() const throw (invalid_type_error)
+   { check_type(variable_type::BYTE); return _data.byte; }
+
+   inline std::uint16_t as_word() const throw (invalid_type_error)
+   { check_type(variable_type::WORD); return _data.word; }
+
+   inline std::uint32_t as_dword() const throw (invalid_type_error)
+   { check_type(variable_type::DWORD); return _data.dword; }
+
+   inline float as_float() const throw (invalid_type_error)
+   { check_type(variable_type::FLOAT); return _data.flt; }
 
    std::string to_string() const;
 
 private:
 
+   union data
+   {
+      bool b;
+      std::uint8_t byte;
+      std::uint16_t word;
+      std::uint32_t dword;
+      float flt;
+   };
+
    variable_type _type;
-   buffer::linear_buffer_ptr _buffer;
+   data _data;
 
-   inline variable_value(
-         const variable_type& type,
-         const buffer::linear_buffer_ptr& buffer)
-      : _type(type), _buffer(buffer) {}
+   inline variable_value(const variable_type& type)
+      : _type(type) { _data.dword = 0; }
+
+   inline void check_type(
+         const variable_type& type) const
+   throw (invalid_type_error)
+   {
+      if (_type != type)
+         throw_invalid_type(type);
+   }
 
-   void check_type(
-         const variable_type& get_type) const
+   void throw_invalid_type(
+         const variable_type& type) const
    throw (invalid_type_error);
 };
 
@@ -16,98 +16,125 @@
  * along with Open Airbus Cockpit. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
 #include <flightvars/api.h>
 
 namespace oac { namespace fv {
 
 namespace {
 
-template <typename T>
-buffer::linear_buffer_ptr make_buffer_of(const T& value)
+std::string
+make_key(const variable_group& group, const variable_name& name)
 {
-   auto buff = std::make_shared<buffer::linear_buffer>(sizeof(T));
-   buffer::write_as(*buff, 0, value);
-   return buff;
+   auto key = group;
+   key.push_back('\0');
+   key.append(name);
+   return key;
 }
 
-} // anonymous namespace
-
-bool
-variable_value::operator == (
-      const variable_value& val) const
+/*
+ * The table of interned variable IDs. Entries are allocated once and never
+ * freed, so a variable ID may safely dereference its entry while it is
+ * being released by another thread. Released entries are recycled by
+ * means of the free list, so the table only grows up to the maximum
+ * number of variables alive at the same time.
+ */
+template <typename Entry>
+struct variable_id_table
 {
-   if (val._type != _type)
-      return false;
-   switch (_type)
+   std::mutex mutex;
+   std::vector<std::unique_ptr<Entry>> entries;
+   std::vector<variable_handle> free_handles;
+   std::unordered_map<std::string, variable_handle> handles;
+
+   static variable_id_table& instance()
    {
-      case variable_type::BOOLEAN: return val.as_bool() == as_bool();
-      case variable_type::BYTE: return val.as_byte() == as_byte();
-      case variable_type::WORD: return val.as_word() == as_word();
-      case variable_type::DWORD: return val.as_dword() == as_dword();
-      case variable_type::FLOAT: return val.as_float() == as_float();
-      default:
-         OAC_THROW_EXCEPTION(enum_out_of_range_error<variable_type>(_type));
+      static variable_id_table table;
+      return table;
    }
-}
-
-variable_value
-variable_value::from_bool(bool value)
-{ return variable_value(variable_type::BOOLEAN, make_buffer_of<bool>(value)); }
-
-variable_value
-variable_value::from_byte(std::uint8_t value)
-{ return variable_value(variable_type::BYTE, make_buffer_of(value)); }
-
-variable_value
-variable_value::from_word(std::uint16_t value)
-{ return variable_value(variable_type::WORD, make_buffer_of(value)); }
-
-variable_value
-variable_value::from_dword(std::uint32_t value)
-{ return variable_value(variable_type::DWORD, make_buffer_of(value)); }
+};
 
-variable_value
-variable_value::from_float(float value)
-{ return variable_value(variable_type::FLOAT, make_buffer_of(value)); }
+} // anonymous namespace
 
-bool
-variable_value::as_bool() const
-throw (invalid_type_error)
+variable_id
+variable_id::from_handle(variable_handle handle)
+throw (no_such_handle_error)
 {
-   check_type(variable_type::BOOLEAN);
-   return buffer::read_as<bool>(*_buffer, 0);
+   auto& table = variable_id_table<entry>::instance();
+   std::lock_guard<std::mutex> lock(table.mutex);
+   if (handle >= table.entries.size() || !table.entries[handle]->live)
+      OAC_THROW_EXCEPTION(no_such_handle_error(handle));
+   auto& e = *table.entries[handle];
+   e.refs.fetch_add(1, std::memory_order_relaxed);
+   return variable_id(e);
 }
 
-std::uint8_t
-variable_value::as_byte() const
-throw (invalid_type_error)
+std::size_t
+variable_id::interned_count()
 {
-   check_type(variable_type::BYTE);
-   return buffer::read_as<std::uint8_t>(*_buffer, 0);
+   auto& table = variable_id_table<entry>::instance();
+   std::lock_guard<std::mutex> lock(table.mutex);
+   return table.handles.size();
 }
 
-std::uint16_t
-variable_value::as_word() const
-throw (invalid_type_error)
+variable_id::entry&
+variable_id::intern(
+      const variable_group& group,
+      const variable_name& name)
 {
-   check_type(variable_type::WORD);
-   return buffer::read_as<std::uint16_t>(*_buffer, 0);
-}
+   auto lower_group = boost::algorithm::to_lower_copy(group);
+   auto lower_name = boost::algorithm::to_lower_copy(name);
+   auto key = make_key(lower_group, lower_name);
+
+   auto& table = variable_id_table<entry>::instance();
+   std::lock_guard<std::mutex> lock(table.mutex);
+   auto h = table.handles.find(key);
+   if (h != table.handles.end())
+   {
+      // The entry might be at zero references, pending to be released by
+      // another thread. Resurrecting it here makes that release a no-op.
+      auto& e = *table.entries[h->second];
+      e.refs.fetch_add(1, std::memory_order_relaxed);
+      return e;
+   }
 
-std::uint32_t
-variable_value::as_dword() const
-throw (invalid_type_error)
-{
-   check_type(variable_type::DWORD);
-   return buffer::read_as<std::uint32_t>(*_buffer, 0);
+   variable_handle handle;
+   if (table.free_handles.empty())
+   {
+      handle = variable_handle(table.entries.size());
+      table.entries.push_back(std::unique_ptr<entry>(new entry(handle)));
+   }
+   else
+   {
+      handle = table.free_handles.back();
+      table.free_handles.pop_back();
+   }
+   auto& e = *table.entries[handle];
+   e.group = lower_group;
+   e.name = lower_name;
+   e.refs.store(1, std::memory_order_relaxed);
+   e.live = true;
+   table.handles[key] = handle;
+   return e;
 }
 
-float
-variable_value::as_float() const
-throw (invalid_type_error)
+void
+variable_id::release(entry& e)
 {
-   check_type(variable_type::FLOAT);
-   return buffer::read_as<float>(*_buffer, 0);
+   auto& table = variable_id_table<entry>::instance();
+   std::lock_guard<std::mutex> lock(table.mutex);
+
+   // Another thread may have interned this entry again since its references
+   // dropped to zero, or it may have been released already.
+   if (!e.live || e.refs.load(std::memory_order_acquire) != 0)
+      return;
+   table.handles.erase(make_key(e.group, e.name));
+   e.live = false;
+   table.free_handles.push_back(e.handle);
 }
 
 std::string
@@ -132,11 +159,10 @@ variable_value::to_string() const
 }
 
 void
-variable_value::check_type(const variable_type& type) const
+variable_value::throw_invalid_type(const variable_type& type) const
 throw (invalid_type_error)
 {
-   if (_type != type)
-      OAC_THROW_EXCEPTION(invalid_type_error(_type, type));
+   OAC_THROW_EXCEPTION(invalid_type_error(_type, type));
 }
 
 
@@ -43,10 +43,21 @@ flight_vars_client::subscribe(
       const variable_id& var,
       const var_update_handler& handler)
 throw (no_such_variable_error)
+{
+   return subscribe(var, handler, boost::none);
+}
+
+subscription_id
+flight_vars_client::subscribe(
+      const variable_id& var,
+      const var_update_handler& handler,
+      const boost::optional<subs::subscription_qos>& qos)
+throw (no_such_variable_error)
 {
    try
    {
-      auto req = std::make_shared<client::subscription_request>(var, handler);
+      auto req = std::make_shared<client::subscription_request>(
+            var, handler, qos);
       _conn_mngr.submit(req);
       return req->get_result(_request_timeout);
    }
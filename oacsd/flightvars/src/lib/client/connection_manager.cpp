@@ -20,6 +20,26 @@
 
 namespace oac { namespace fv { namespace client {
 
+struct connection_manager::in_place_dispatcher
+{
+   connection_manager& manager;
+
+   in_place_dispatcher(connection_manager& m) : manager(m) {}
+
+   void operator()(const proto::var_update_message& msg)
+   { manager.on_variable_update_received(msg); }
+
+   void operator()(const proto::subscription_reply_view& view)
+   {
+      // The reply contents are retained by the subscription DB,
+      // so it must be copied out of the input buffer.
+      manager.on_subscription_reply_received(view.to_message());
+   }
+
+   void operator()(const proto::message& msg)
+   { manager.dispatch_message(msg); }
+};
+
 connection_manager::connection_manager(
       const std::string& client_name,
       const network::hostname& server_host,
@@ -30,7 +50,9 @@ throw (communication_error)
      _error_handler(ehandler),
      _io_service(std::make_shared<boost::asio::io_service>()),
      _client(server_host, server_port, _io_service),
-     _input_buffer(1024)
+     _input_buffer(1024),
+     _output_buffers(std::make_shared<output_buffer_type::factory>(1024)),
+     _proto_ver(0)
 {
    try
    {
@@ -125,8 +147,12 @@ throw (communication_error)
          if (auto* bs_msg = boost::get<begin_session_message>(&msg))
          {
             log_info(
-                  "Begin session response received from server (%s)",
-                  bs_msg->pname);
+                  "Begin session response received from server "
+                  "(%s, protocol %d.%d)",
+                  bs_msg->pname,
+                  (bs_msg->proto_ver >> 8),
+                  (bs_msg->proto_ver & 0x00ff));
+            _proto_ver = bs_msg->proto_ver;
             break;
          }
          else
@@ -177,7 +203,7 @@ throw (communication_error)
 
       log_info("Sending end session message to the server");
       auto end_session_msg = proto::end_session_message("Client disconnected");
-      serialize<binary_message_serializer>(end_session_msg, output_buff);
+      serialize_message(end_session_msg, output_buff);
       auto write_result = _client.connection().write(output_buff);
 
       _io_service->reset();
@@ -265,8 +291,18 @@ connection_manager::on_subscription_requested(
             "requesting subscription to the server",
             var_id.to_string());
       _request_pool.insert(req);
-      auto req = proto::subscription_request_message(var_id.group, var_id.name);
-      send_message(req);
+      auto msg = proto::subscription_request_message(var_id.group, var_id.name);
+      if (req->qos())
+      {
+         if (supports_qos())
+            msg.qos = req->qos();
+         else
+            log_warn(
+                  "The server does not support subscription QoS: "
+                  "subscribing to %s without it",
+                  var_id.to_string());
+      }
+      send_message(msg);
    }
 }
 
@@ -361,37 +397,36 @@ connection_manager::on_message_received(
 
    try
    {
-      auto msg = proto::deserialize<proto::binary_message_deserializer>(
-            _input_buffer);
-      bool match = false;
-      match |= proto::if_message_type<proto::subscription_reply_message>(
-            msg,
-            std::bind(
-                  &connection_manager::on_subscription_reply_received,
-                  this,
-                  std::placeholders::_1));
-      match |= proto::if_message_type<proto::unsubscription_reply_message>(
-            msg,
-            std::bind(
-                  &connection_manager::on_unsubscription_reply_received,
-                  this,
-                  std::placeholders::_1));
-      match |= proto::if_message_type<proto::var_update_message>(
-            msg,
-            std::bind(
-                  &connection_manager::on_variable_update_received,
-                  this,
-                  std::placeholders::_1));
-      if (!match)
-         OAC_THROW_EXCEPTION(
-               proto::unexpected_message_error(
-                     proto::get_message_type(msg)));
-   }
-   catch (const io::eof_error&)
-   {
-      // Not enough bytes while deserialing message
-      // Continue to read again
-      _input_buffer.reset();
+      if (supports_framing())
+      {
+         // Only complete frames are parsed, so no message is deserialized
+         // before all its bytes are received. They are decoded in place
+         // from the input buffer, so var updates involve no copies.
+         in_place_dispatcher dispatcher(*this);
+         while (_frames.frame_ready<proto::binary_message_deserializer>(
+                  _input_buffer))
+            _frames.decode_in_place(_input_buffer, dispatcher);
+      }
+      else
+      {
+         try
+         {
+            while (_input_buffer.available_for_read())
+            {
+               _input_buffer.set_mark();
+               auto msg = proto::deserialize<
+                     proto::binary_message_deserializer>(_input_buffer);
+               _input_buffer.unset_mark();
+               dispatch_message(msg);
+            }
+         }
+         catch (const io::eof_error&)
+         {
+            // Not enough bytes while deserialing message
+            // Continue to read again
+            _input_buffer.reset();
+         }
+      }
    }
    catch (const oac::exception& e)
    {
@@ -406,6 +441,41 @@ connection_manager::on_message_received(
    start_receive();
 }
 
+void
+connection_manager::dispatch_message(
+      const proto::message& msg)
+{
+   bool match = false;
+   match |= proto::if_message_type<proto::subscription_reply_message>(
+         msg,
+         std::bind(
+               &connection_manager::on_subscription_reply_received,
+               this,
+               std::placeholders::_1));
+   match |= proto::if_message_type<proto::unsubscription_reply_message>(
+         msg,
+         std::bind(
+               &connection_manager::on_unsubscription_reply_received,
+               this,
+               std::placeholders::_1));
+   match |= proto::if_message_type<proto::var_update_message>(
+         msg,
+         std::bind(
+               &connection_manager::on_variable_update_received,
+               this,
+               std::placeholders::_1));
+   match |= proto::if_message_type<proto::var_update_batch_message>(
+         msg,
+         std::bind(
+               &connection_manager::on_variable_update_batch_received,
+               this,
+               std::placeholders::_1));
+   if (!match)
+      OAC_THROW_EXCEPTION(
+            proto::unexpected_message_error(
+                  proto::get_message_type(msg)));
+}
+
 void connection_manager::on_subscription_reply_received(
       const proto::subscription_reply_message& msg)
 {
@@ -513,13 +583,33 @@ connection_manager::on_variable_update_received(
    }
 }
 
+void
+connection_manager::on_variable_update_batch_received(
+      const proto::var_update_batch_message& msg)
+{
+   for (auto& update : msg.updates)
+      on_variable_update_received(update);
+}
+
+template <typename Message>
+void
+connection_manager::serialize_message(
+      const Message& msg,
+      output_buffer_type& buff)
+{
+   if (supports_framing())
+      proto::serialize_frame<proto::binary_message_serializer>(msg, buff);
+   else
+      proto::serialize<proto::binary_message_serializer>(msg, buff);
+}
+
 template <typename Message>
 void
 connection_manager::send_message(
       const Message& msg)
 {
-   auto buff = std::make_shared<output_buffer_type>(1024);
-   proto::serialize<proto::binary_message_serializer>(msg, *buff);
+   auto buff = _output_buffers.acquire();
+   serialize_message(msg, *buff);
    send_data(buff);
 }
 
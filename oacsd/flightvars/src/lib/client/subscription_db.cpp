@@ -68,12 +68,11 @@ throw (no_such_element_exception)
 {
    if (!variable_defined(var_id))
       OAC_THROW_EXCEPTION(no_such_variable_error(var_id));
+   auto e = _var_id_map[var_id];
    auto virtual_subs = subscription(
-         make_subscription_id(),
+         _virtual_subs_id_map.insert(e),
          handler);
-   auto e = _var_id_map[var_id];
    e->virtual_subs.push_back(virtual_subs);
-   _virtual_subs_id_map[virtual_subs.id] = e;
    return virtual_subs.id;
 }
 
@@ -139,7 +138,7 @@ bool
 subscription_db::virtual_subscription_defined(
       subscription_id subs_id) const
 {
-   return _virtual_subs_id_map.find(subs_id) != _virtual_subs_id_map.end();
+   return _virtual_subs_id_map.contains(subs_id);
 }
 
 subscription_db::entry_ptr
@@ -180,7 +179,7 @@ throw (no_such_element_exception)
 {
    if (!virtual_subscription_defined(virt_subs_id))
       OAC_THROW_EXCEPTION(no_such_virtual_subscription_error(virt_subs_id));
-   return _virtual_subs_id_map[virt_subs_id];
+   return *_virtual_subs_id_map.find(virt_subs_id);
 }
 
 std::list<subscription_db::subscription>
@@ -23,21 +23,22 @@ namespace oac { namespace fv { namespace subs {
 void
 subscription_mapper::clear()
 {
-   _map.clear();
+   _subs_ids.clear();
+   _var_ids.clear();
 }
 
 bool
 subscription_mapper::subscription_exists(
       const variable_id& var_id) const
 {
-   return (_map.left.find(var_id) != _map.left.end());
+   return (_subs_ids.find(var_id) != _subs_ids.end());
 }
 
 bool
 subscription_mapper::subscription_exists(
       const subscription_id& subs_id) const
 {
-   return (_map.right.find(subs_id) != _map.right.end());
+   return (_var_ids.find(subs_id) != _var_ids.end());
 }
 
 void
@@ -50,14 +51,15 @@ throw (variable_already_exists_error, subscription_already_exists_error)
       OAC_THROW_EXCEPTION(variable_already_exists_error(var_id));
    if (subscription_exists(subs_id))
       OAC_THROW_EXCEPTION(subscription_already_exists_error(subs_id));
-   _map.insert(map_type::value_type(var_id, subs_id));
+   _subs_ids.insert(std::make_pair(var_id, subs_id));
+   _var_ids.insert(std::make_pair(subs_id, var_id));
 }
 
 void
 subscription_mapper::for_each_subscription(
       const std::function<void(const subscription_id&)>& action)
 {
-   for (auto& entry : _map.right)
+   for (auto& entry : _var_ids)
    {
       action(entry.first);
    }
@@ -68,8 +70,8 @@ subscription_mapper::get_var_id(
       const subscription_id& subs_id)
 throw (no_such_subscription_error)
 {
-   auto entry = _map.right.find(subs_id);
-   if (entry == _map.right.end())
+   auto entry = _var_ids.find(subs_id);
+   if (entry == _var_ids.end())
       OAC_THROW_EXCEPTION(no_such_subscription_error(subs_id));
    return entry->second;
 }
@@ -79,8 +81,8 @@ subscription_mapper::get_subscription_id(
       const variable_id& var_id)
 throw (no_such_variable_error)
 {
-   auto entry = _map.left.find(var_id);
-   if (entry == _map.left.end())
+   auto entry = _subs_ids.find(var_id);
+   if (entry == _subs_ids.end())
       OAC_THROW_EXCEPTION(no_such_variable_error(var_id));
    return entry->second;
 }
@@ -90,8 +92,11 @@ subscription_mapper::unregister(
       const variable_id& var_id)
 throw (no_such_variable_error)
 {
-   if (_map.left.erase(var_id) == 0)
+   auto entry = _subs_ids.find(var_id);
+   if (entry == _subs_ids.end())
       OAC_THROW_EXCEPTION(no_such_variable_error(var_id));
+   _var_ids.erase(entry->second);
+   _subs_ids.erase(entry);
 }
 
 void
@@ -99,8 +104,11 @@ subscription_mapper::unregister(
       const subscription_id& subs_id)
 throw (no_such_subscription_error)
 {
-   if (_map.right.erase(subs_id) == 0)
+   auto entry = _var_ids.find(subs_id);
+   if (entry == _var_ids.end())
       OAC_THROW_EXCEPTION(no_such_subscription_error(subs_id));
+   _subs_ids.erase(entry->second);
+   _var_ids.erase(entry);
 }
 
 }}} // namespace oac::fv::subs
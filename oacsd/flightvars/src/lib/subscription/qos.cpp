@@ -0,0 +1,121 @@
+/*
+ * This file is part of Open Airbus Cockpit
+ * Copyright (C) 2012, 2013 Alvaro Polo
+ *
+ * Open Airbus Cockpit is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Open Airbus Cockpit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Open Airbus Cockpit. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+
+#include <flightvars/subscription/qos.h>
+
+namespace oac { namespace fv { namespace subs {
+
+namespace {
+
+bool
+to_number(
+      const variable_value& value,
+      double& result)
+{
+   switch (value.get_type())
+   {
+      case variable_type::BYTE:
+         result = value.as_byte();
+         return true;
+      case variable_type::WORD:
+         result = value.as_word();
+         return true;
+      case variable_type::DWORD:
+         result = value.as_dword();
+         return true;
+      case variable_type::FLOAT:
+         result = value.as_float();
+         return true;
+      default:
+         return false;
+   }
+}
+
+} // anonymous namespace
+
+qos_filter::qos_filter(
+      const subscription_qos& qos)
+   : _qos(qos)
+{}
+
+bool
+qos_filter::accept(
+      const variable_value& value,
+      const clock::time_point& now)
+{
+   if (within_deadband(value))
+   {
+      // A deferred value is superseded by one which is not meaningful
+      _deferred.reset();
+      return false;
+   }
+   if (within_interval(now))
+   {
+      _deferred = value;
+      return false;
+   }
+   _last_value = value;
+   _last_time = now;
+   _deferred.reset();
+   return true;
+}
+
+boost::optional<variable_value>
+qos_filter::take_deferred(
+      const clock::time_point& now)
+{
+   boost::optional<variable_value> result;
+   if (_deferred && !within_interval(now))
+   {
+      result.swap(_deferred);
+      _last_value = result;
+      _last_time = now;
+   }
+   return result;
+}
+
+bool
+qos_filter::within_deadband(
+      const variable_value& value) const
+{
+   double current, last;
+   if (_qos.deadband_type == deadband_kind::NONE ||
+       !_last_value ||
+       _last_value->get_type() != value.get_type() ||
+       !to_number(value, current) ||
+       !to_number(*_last_value, last))
+      return false;
+
+   auto delta = std::abs(current - last);
+   if (_qos.deadband_type == deadband_kind::RELATIVE_DELTA)
+      return delta <= _qos.deadband * std::abs(last);
+   return delta <= _qos.deadband;
+}
+
+bool
+qos_filter::within_interval(
+      const clock::time_point& now) const
+{
+   return _qos.min_interval &&
+          _last_value &&
+          now - _last_time < boost::chrono::milliseconds(_qos.min_interval);
+}
+
+}}} // namespace oac::fv::subs
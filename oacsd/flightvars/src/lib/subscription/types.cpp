@@ -16,13 +16,15 @@
  * along with Open Airbus Cockpit. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <atomic>
+
 #include <flightvars/subscription/types.h>
 
 namespace oac { namespace fv {
 
 namespace {
 
-subscription_id next_id = 1;
+std::atomic<subscription_id> next_id(1);
 
 } // anonymous namespace
 
@@ -20,24 +20,47 @@
 
 namespace oac { namespace fv {
 
+namespace {
+
+std::shared_ptr<flight_vars_core> core_instance;
+boost::once_flag core_instance_flag = BOOST_ONCE_INIT;
+
+} // anonymous namespace
+
 std::shared_ptr<flight_vars_core>
 flight_vars_core::instance()
 {
-   static std::shared_ptr<flight_vars_core> core(nullptr);
-   if (!core)
-      core = std::shared_ptr<flight_vars_core>(new flight_vars_core());
-   return core;
+   boost::call_once(core_instance_flag, []()
+   {
+      core_instance = std::shared_ptr<flight_vars_core>(
+            new flight_vars_core());
+   });
+   return core_instance;
 }
 
+flight_vars_core::flight_vars_core()
+   : _group_masters(std::make_shared<group_master_dict>()),
+     _subscriptions(std::make_shared<subscription_master_dict>())
+{}
+
 subscription_id
 flight_vars_core::subscribe(
       const variable_id& var,
       const var_update_handler& handler)
 throw (no_such_variable_error)
 {
-   auto& master = get_master_by_var_id(var);
-   auto id = master->subscribe(var, handler);
-   _subscriptions[id] = master;
+   // The master is invoked without holding the write mutex, so it may
+   // notify updates or call back the core while subscribing
+   subscription_route route;
+   route.master = get_master_by_var_id(var);
+   route.master_subs_id = route.master->subscribe(var, handler);
+
+   boost::unique_lock<boost::mutex> lock(_write_mutex);
+   auto subscriptions = std::make_shared<subscription_master_dict>(
+         *std::atomic_load(&_subscriptions));
+   auto id = subscriptions->insert(route);
+   std::atomic_store(
+         &_subscriptions, subscription_master_snapshot(subscriptions));
    return id;
 }
 
@@ -46,11 +69,46 @@ flight_vars_core::unsubscribe(
       const subscription_id& id)
 throw (no_such_subscription_error)
 {
-   auto entry = _subscriptions.find(id);
-   if (entry == _subscriptions.end())
-      OAC_THROW_EXCEPTION(no_such_subscription_error(id));
-   entry->second->unsubscribe(id);
-   _subscriptions.erase(entry);
+   subscription_route route;
+   {
+      boost::unique_lock<boost::mutex> lock(_write_mutex);
+      auto current = std::atomic_load(&_subscriptions);
+      auto entry = current->find(id);
+      if (!entry)
+         OAC_THROW_EXCEPTION(no_such_subscription_error(id));
+      route = *entry;
+
+      auto subscriptions = std::make_shared<subscription_master_dict>(
+            *current);
+      subscriptions->erase(id);
+      std::atomic_store(
+            &_subscriptions, subscription_master_snapshot(subscriptions));
+   }
+   route.master->unsubscribe(route.master_subs_id);
+}
+
+void
+flight_vars_core::unsubscribe_all(
+      const subscription_id_list& ids)
+{
+   std::map<std::shared_ptr<flight_vars>, subscription_id_list> master_ids;
+   {
+      boost::unique_lock<boost::mutex> lock(_write_mutex);
+      auto subscriptions = std::make_shared<subscription_master_dict>(
+            *std::atomic_load(&_subscriptions));
+      for (auto& id : ids)
+      {
+         if (auto entry = subscriptions->find(id))
+         {
+            master_ids[entry->master].push_back(entry->master_subs_id);
+            subscriptions->erase(id);
+         }
+      }
+      std::atomic_store(
+            &_subscriptions, subscription_master_snapshot(subscriptions));
+   }
+   for (auto& entry : master_ids)
+      entry.first->unsubscribe_all(entry.second);
 }
 
 void
@@ -59,8 +117,20 @@ flight_vars_core::update(
       const variable_value& var_value)
 throw (no_such_variable_error, illegal_value_error)
 {
-   if (auto master = get_master_by_subs_id(subs_id))
-      master->update(subs_id, var_value);
+   subscription_master_snapshot snapshot;
+   if (auto route = get_route_by_subs_id(subs_id, snapshot))
+      route->master->update(route->master_subs_id, var_value);
+}
+
+void
+flight_vars_core::set_max_polling_interval(
+      const subscription_id& subs_id,
+      const boost::chrono::milliseconds& interval)
+throw (no_such_subscription_error)
+{
+   subscription_master_snapshot snapshot;
+   if (auto route = get_route_by_subs_id(subs_id, snapshot))
+      route->master->set_max_polling_interval(route->master_subs_id, interval);
 }
 
 void
@@ -69,30 +139,36 @@ flight_vars_core::register_group_master(
       const std::shared_ptr<flight_vars>& master)
 throw (master_already_registered)
 {
-   auto entry = _group_masters.find(grp);
-   if (entry != _group_masters.end())
+   boost::unique_lock<boost::mutex> lock(_write_mutex);
+   auto current = std::atomic_load(&_group_masters);
+   if (current->find(grp) != current->end())
       OAC_THROW_EXCEPTION(master_already_registered(grp));
-   _group_masters[grp] = master;
+
+   auto group_masters = std::make_shared<group_master_dict>(*current);
+   (*group_masters)[grp] = master;
+   std::atomic_store(
+         &_group_masters, group_master_snapshot(group_masters));
 }
 
-std::shared_ptr<flight_vars>&
+std::shared_ptr<flight_vars>
 flight_vars_core::get_master_by_var_id(
       const variable_id& var_id)
 throw (no_such_variable_error)
 {
-   auto grp = var_id.group;
-   auto entry = _group_masters.find(grp);
-   if (entry == _group_masters.end())
+   auto group_masters = std::atomic_load(&_group_masters);
+   auto entry = group_masters->find(var_id.group);
+   if (entry == group_masters->end())
       OAC_THROW_EXCEPTION(no_such_variable_error(var_id));
    return entry->second;
 }
 
-std::shared_ptr<flight_vars>
-flight_vars_core::get_master_by_subs_id(
-      const subscription_id& subs_id)
+const flight_vars_core::subscription_route*
+flight_vars_core::get_route_by_subs_id(
+      const subscription_id& subs_id,
+      subscription_master_snapshot& snapshot)
 {
-   auto entry = _subscriptions.find(subs_id);
-   return (entry != _subscriptions.end()) ? entry->second : nullptr;
+   snapshot = std::atomic_load(&_subscriptions);
+   return snapshot->find(subs_id);
 }
 
 }} // namespace oac::fv
@@ -190,26 +190,44 @@ fsuipc_offset_db::create_subscription(
 throw (fsuipc::invalid_var_group_error, fsuipc::var_name_syntax_error)
 {
    auto offset = to_fsuipc_offset(var_id);
-   insert_known_offset(offset);
-   return insert_subscription(offset, var_id, callback);
+   auto offset_match = _offsets.find(offset);
+   if (offset_match == _offsets.end())
+   {
+      offset_entry entry;
+      entry.position = _known_offsets.insert(_known_offsets.end(), offset);
+      offset_match = _offsets.insert(std::make_pair(offset, entry)).first;
+   }
+
+   auto& subscriptions = offset_match->second.subscriptions;
+   auto position = subscriptions.insert(
+         subscriptions.end(), subscription_meta(var_id, callback));
+   subscription_entry entry = { offset, position };
+   _subscriptions.insert(
+         std::make_pair(position->get_subscription_id(), entry));
+   return *position;
 }
 
-void
+std::size_t
 fsuipc_offset_db::remove_subscription(
-      const subscription_id& subs)
+      const subscription_id& subs_id)
+throw (no_such_subscription_error)
 {
-   auto it =_offset_handlers.begin(), end = _offset_handlers.end();
-   while (it != end)
+   auto subs_match = _subscriptions.find(subs_id);
+   if (subs_match == _subscriptions.end())
+      OAC_THROW_EXCEPTION(no_such_subscription_error(subs_id));
+
+   auto offset_match = _offsets.find(subs_match->second.offset);
+   auto& subscriptions = offset_match->second.subscriptions;
+   subscriptions.erase(subs_match->second.position);
+   _subscriptions.erase(subs_match);
+
+   auto remaining = subscriptions.size();
+   if (remaining == 0)
    {
-      auto& offset = it->first;
-      if (remove_subscription(offset, subs) == 0)
-      {
-         remove_known_offset(offset);
-         it = _offset_handlers.erase(it);
-      }
-      else
-         it++;
+      _known_offsets.erase(offset_match->second.position);
+      _offsets.erase(offset_match);
    }
+   return remaining;
 }
 
 const fsuipc_offset_db::subscription_list&
@@ -217,71 +235,21 @@ fsuipc_offset_db::get_subscriptions_for_offset(
       const oac::fsuipc::offset& offset) const
 throw (no_such_offset_error)
 {
-   auto match = _offset_handlers.find(offset);
-   if (match == _offset_handlers.end())
+   auto match = _offsets.find(offset);
+   if (match == _offsets.end())
       OAC_THROW_EXCEPTION(no_such_offset_error(offset.address, offset.length));
-   return match->second;
+   return match->second.subscriptions;
 }
 
 oac::fsuipc::offset
 fsuipc_offset_db::get_offset_for_subscription(
-      const subscription_id& subs_id)
+      const subscription_id& subs_id) const
 throw (no_such_subscription_error)
 {
-   for (auto& elem : _offset_handlers)
-   {
-      auto& offset = elem.first;
-      auto& subscriptions = elem.second;
-      for (auto& subs : subscriptions)
-         if (subs.get_subscription_id() == subs_id)
-            return offset;
-   }
-   OAC_THROW_EXCEPTION(no_such_subscription_error(subs_id));
-}
-
-void
-fsuipc_offset_db::insert_known_offset(
-      const oac::fsuipc::offset& offset)
-{
-   if (std::none_of(
-          _known_offsets.begin(),
-          _known_offsets.end(),
-          [&offset](const oac::fsuipc::offset& elem)
-          { return elem == offset; }))
-   {
-      _known_offsets.push_back(offset);
-   }
-}
-
-void
-fsuipc_offset_db::remove_known_offset(
-      const oac::fsuipc::offset& offset)
-{
-   _known_offsets.remove(offset);
-}
-
-subscription_meta
-fsuipc_offset_db::insert_subscription(
-      const oac::fsuipc::offset& offset,
-      const variable_id& var_id,
-      const flight_vars::var_update_handler& callback)
-{
-   subscription_meta subs(var_id, callback);
-   _offset_handlers[offset].push_back(subs);
-   return subs;
-}
-
-std::size_t
-fsuipc_offset_db::remove_subscription(
-      const oac::fsuipc::offset& offset,
-      const subscription_id& subs_id)
-{
-   auto& list = _offset_handlers[offset];
-   list.remove_if([&subs_id](const subscription_meta& meta)
-   {
-      return meta.get_subscription_id() == subs_id;
-   });
-   return list.size();
+   auto match = _subscriptions.find(subs_id);
+   if (match == _subscriptions.end())
+      OAC_THROW_EXCEPTION(no_such_subscription_error(subs_id));
+   return match->second.offset;
 }
 
 const variable_group local_fsuipc_flight_vars::VAR_GROUP(VAR_GROUP_TAG);
@@ -19,14 +19,19 @@
 #ifndef OAC_FV_FSUIPC_H
 #define OAC_FV_FSUIPC_H
 
+#include <limits>
 #include <list>
 #include <map>
 #include <unordered_map>
+#include <vector>
 
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
 
 #include <boost/bimap.hpp>
+#include <boost/chrono.hpp>
+#include <boost/optional.hpp>
+#include <boost/thread.hpp>
 #include <boost/uuid/uuid_generators.hpp>
 #include <flightvars/api.h>
 #include <flightvars/subscription.h>
@@ -125,6 +130,11 @@ private:
  * A in-memory database that maintains the relation among variables, offsets
  * and subscriptions. It is used internally by fsuipc_flight_vars to implement
  * its logic.
+ *
+ * Subscriptions and offsets are indexed by hash, and each subscription
+ * knows its position in the list of its offset, so creating and removing a
+ * subscription take constant time. An offset is known as long as any
+ * subscription refers to it.
  */
 class fsuipc_offset_db
 {
@@ -157,44 +167,69 @@ public:
          const flight_vars::var_update_handler& callback)
    throw (fsuipc::invalid_var_group_error, fsuipc::var_name_syntax_error);
 
-   void remove_subscription(
-         const subscription_id& subs);
+   /**
+    * Remove the given subscription.
+    *
+    * @return the number of subscriptions which remain on its offset; the
+    *         offset is no longer known when it is zero
+    */
+   std::size_t remove_subscription(
+         const subscription_id& subs)
+   throw (no_such_subscription_error);
 
    const offset_list& get_all_offsets() const
    { return _known_offsets; }
 
+   bool is_known_offset(const oac::fsuipc::offset& offset) const
+   { return _offsets.find(offset) != _offsets.end(); }
+
    const subscription_list& get_subscriptions_for_offset(
          const oac::fsuipc::offset& offset) const
    throw (no_such_offset_error);
 
    oac::fsuipc::offset get_offset_for_subscription(
-         const subscription_id& subs_id)
+         const subscription_id& subs_id) const
    throw (no_such_subscription_error);
 
+   fsuipc_offset_db() {}
+
 private:
 
-   typedef std::unordered_map<
-         oac::fsuipc::offset,
-         subscription_list,
-         oac::fsuipc::offset::hash> offset_handler_map;
+   /**
+    * The subscriptions on a known offset, and the position of the offset
+    * in the list of known offsets.
+    */
+   struct offset_entry
+   {
+      subscription_list subscriptions;
+      offset_list::iterator position;
+   };
 
-   offset_list _known_offsets;
-   offset_handler_map _offset_handlers;
+   /**
+    * The offset of a subscription, and its position in the subscription
+    * list of that offset.
+    */
+   struct subscription_entry
+   {
+      oac::fsuipc::offset offset;
+      subscription_list::iterator position;
+   };
 
-   void insert_known_offset(
-         const oac::fsuipc::offset& offset);
+   typedef std::unordered_map<
+         oac::fsuipc::offset,
+         offset_entry,
+         oac::fsuipc::offset::hash> offset_entry_map;
 
-   void remove_known_offset(
-         const oac::fsuipc::offset& offset);
+   typedef std::unordered_map<
+         subscription_id, subscription_entry> subscription_entry_map;
 
-   subscription_meta insert_subscription(
-         const oac::fsuipc::offset& offset,
-         const variable_id& var_id,
-         const flight_vars::var_update_handler& callback);
+   offset_list _known_offsets;
+   offset_entry_map _offsets;
+   subscription_entry_map _subscriptions;
 
-   std::size_t remove_subscription(
-         const oac::fsuipc::offset& offset,
-         const subscription_id& subs_id);
+   // The entries refer to positions in the lists, so they cannot be copied
+   fsuipc_offset_db(const fsuipc_offset_db&);
+   fsuipc_offset_db& operator = (const fsuipc_offset_db&);
 };
 
 /**
@@ -204,20 +239,55 @@ private:
  * (decimal, hexadecimal...) of the offset and <size> is one of 1, 2 or 4,
  * indicating a value in bytes (BYTE, WORD and DWORD, respectively). E.g.,
  * 0x0354:2 means a WORD variable at offset 0x0354 (transponder code).
+ *
+ * Variable updates are not written immediately. They are batched and
+ * written on the next check for updates, along with its reads.
+ *
+ * Offsets are polled at adaptive rates. Those that do not change for a
+ * while are only read once every several checks, until a change is
+ * detected on them. A subscriber may pin a maximum polling interval for its
+ * variable with set_max_polling_interval(). Polling times are converted
+ * into a number of checks by means of the check period, which must match
+ * the period of the ticks that drive check_for_updates().
+ *
+ * This class is thread-safe. Its members are serialized by a lock, which
+ * also covers the checks for updates, so subscriptions and updates may be
+ * requested from any thread while another one checks for updates. The
+ * changes detected by a check are collected while the lock is held, and
+ * the subscription handlers are invoked after it is released, so a
+ * handler may call back into this object or lock its own mutexes.
  */
 template <typename FsuipcUserAdapter>
 class fsuipc_flight_vars : public flight_vars, public logger_component
 {
 public:
 
+   typedef oac::fsuipc::update_observer<FsuipcUserAdapter> observer_type;
+   typedef typename observer_type::write_stats write_stats;
+   typedef typename observer_type::polling_policy polling_policy;
+   typedef typename observer_type::polling_stats polling_stats;
+
+   typedef boost::chrono::milliseconds duration;
+
+   /** The time between two reads of cold offsets. */
+   static const duration COLD_POLLING_INTERVAL;
+
+   /** The time without changes for an offset to get cold. */
+   static const duration POLLING_COOLDOWN_TIME;
+
+   /** The check period assumed until set_check_period() is invoked. */
+   static const duration DEFAULT_CHECK_PERIOD;
+
    fsuipc_flight_vars()
       : logger_component("fsuipc_flight_vars"),
         _update_observer(
            std::bind(
               &fsuipc_flight_vars::on_offset_update,
               this,
-              std::placeholders::_1))
+              std::placeholders::_1)),
+        _check_period(DEFAULT_CHECK_PERIOD)
    {
+      update_polling_policy();
    }
 
    virtual subscription_id subscribe(
@@ -225,6 +295,7 @@ public:
          const var_update_handler& handler)
    throw (no_such_variable_error)
    {
+      boost::unique_lock<boost::mutex> lock(_mutex);
       try
       {
          auto subs = _db.create_subscription(var, handler);
@@ -251,13 +322,11 @@ public:
          const subscription_id& id)
    throw (no_such_subscription_error)
    {
+      boost::unique_lock<boost::mutex> lock(_mutex);
       try
       {
-         auto offset = _db.get_offset_for_subscription(id);
-         _db.remove_subscription(id);
-         auto offsets = _db.get_all_offsets();
-         if (std::find(offsets.begin(), offsets.end(), offset) == offsets.end())
-            _update_observer.stop_observing(offset);
+         if (auto offset = remove_subscription(id))
+            _update_observer.stop_observing(*offset);
       }
       catch (const fsuipc_offset_db::no_such_subscription_error& e)
       {
@@ -265,11 +334,34 @@ public:
       }
    }
 
+   virtual void unsubscribe_all(
+         const subscription_id_list& ids)
+   {
+      boost::unique_lock<boost::mutex> lock(_mutex);
+
+      // The offsets are stopped being observed at once
+      std::vector<oac::fsuipc::offset> unobserved;
+      for (auto& id : ids)
+      {
+         try
+         {
+            if (auto offset = remove_subscription(id))
+               unobserved.push_back(*offset);
+         }
+         catch (const fsuipc_offset_db::no_such_subscription_error&)
+         {
+            // Unknown subscriptions are ignored
+         }
+      }
+      _update_observer.stop_observing(unobserved);
+   }
+
    virtual void update(
          const subscription_id& subs_id,
          const variable_value& var_value)
    throw (no_such_subscription_error, illegal_value_error)
    {
+      boost::unique_lock<boost::mutex> lock(_mutex);
       try
       {
          auto offset = _db.get_offset_for_subscription(subs_id);
@@ -289,44 +381,239 @@ public:
       }
    }
 
+   /**
+    * Obtain the FSUIPC user adapter. Its access is not serialized with the
+    * other members of this object.
+    */
    const FsuipcUserAdapter& user_adapter() const
    { return _update_observer.get_client().user_adapter(); }
 
    FsuipcUserAdapter& user_adapter()
    { return _update_observer.get_client().user_adapter(); }
 
+   /**
+    * Set the period of the checks for updates. The polling times are
+    * converted into a number of checks from it, so it must be the period
+    * of the ticks that invoke check_for_updates().
+    */
+   void set_check_period(const duration& period)
+   {
+      boost::unique_lock<boost::mutex> lock(_mutex);
+      _check_period = std::max(period, duration(1));
+      update_polling_policy();
+      for (auto& entry : _polling_intervals)
+         update_max_polling_period(
+               _db.get_offset_for_subscription(entry.first));
+   }
+
+   /**
+    * Set the maximum time between two reads of the variable of the given
+    * subscription. When several subscriptions on the same variable set
+    * it, the lowest one applies.
+    *
+    * @param subs_id  The subscription whose variable polling is limited
+    * @param interval The maximum time between two reads
+    */
+   virtual void set_max_polling_interval(
+         const subscription_id& subs_id,
+         const duration& interval)
+   throw (no_such_subscription_error)
+   {
+      boost::unique_lock<boost::mutex> lock(_mutex);
+      try
+      {
+         auto offset = _db.get_offset_for_subscription(subs_id);
+         _polling_intervals[subs_id] = interval;
+         update_max_polling_period(offset);
+      }
+      catch (const fsuipc_offset_db::no_such_subscription_error& e)
+      {
+         OAC_THROW_EXCEPTION(no_such_subscription_error(subs_id, e));
+      }
+   }
+
+   /**
+    * Obtain the statistics on the polling of the subscribed offsets.
+    */
+   polling_stats get_polling_stats() const
+   {
+      boost::unique_lock<boost::mutex> lock(_mutex);
+      return _update_observer.get_polling_stats();
+   }
+
+   /**
+    * Obtain the statistics on the offset writes requested so far.
+    */
+   write_stats get_write_stats() const
+   {
+      boost::unique_lock<boost::mutex> lock(_mutex);
+      return _update_observer.get_write_stats();
+   }
+
+   /**
+    * Start recording the changes detected on each check for updates into a
+    * new capture file on the given path. Any capture in progress is stopped.
+    * If a record cannot be written, e.g. because the disk is full, the
+    * error is logged and the capture is stopped, so the checks for updates
+    * are not affected.
+    */
+   void start_capture(const boost::filesystem::path& path)
+   throw (oac::fsuipc::capture_open_error)
+   {
+      auto writer = std::make_shared<oac::fsuipc::capture_writer>(path);
+      boost::unique_lock<boost::mutex> lock(_mutex);
+      _update_observer.set_check_handler(
+            [this, writer](oac::fsuipc::shadow_memory& shadow) mutable
+      {
+         if (!writer)
+            return;
+         try
+         {
+            writer->record(shadow);
+         }
+         catch (const oac::fsuipc::capture_open_error& e)
+         {
+            log_error(
+                  "Cannot write FSUIPC capture, stopping it:\n%s",
+                  e.report());
+            writer.reset();
+         }
+      });
+   }
+
+   /**
+    * Stop the capture in progress, if any, closing its file.
+    */
+   void stop_capture()
+   {
+      boost::unique_lock<boost::mutex> lock(_mutex);
+      _update_observer.set_check_handler(nullptr);
+   }
+
+   /**
+    * Check for updates on the subscribed offsets, and notify the changes to
+    * their subscribers once the lock is released. This function must not
+    * be invoked concurrently with itself, or the notifications of two
+    * consecutive checks might be interleaved.
+    */
    void check_for_updates()
-   { _update_observer.check_for_updates(); }
+   {
+      std::vector<notification> notifications;
+      {
+         boost::unique_lock<boost::mutex> lock(_mutex);
+         _update_observer.check_for_updates();
+         notifications.swap(_notifications);
+      }
+      for (auto& n : notifications)
+         n.handler(n.var_id, n.var_value);
+   }
 
 private:
 
+   /**
+    * A change detected by a check, pending to be notified to a subscriber.
+    */
+   struct notification
+   {
+      var_update_handler handler;
+      variable_id var_id;
+      variable_value var_value;
+
+      notification(
+            const var_update_handler& h,
+            const variable_id& id,
+            const variable_value& value)
+         : handler(h), var_id(id), var_value(value)
+      {}
+   };
+
    fsuipc_offset_db _db;
-   oac::fsuipc::update_observer<FsuipcUserAdapter> _update_observer;
+   observer_type _update_observer;
+   std::map<subscription_id, duration> _polling_intervals;
+   std::vector<notification> _notifications;
+   duration _check_period;
+   mutable boost::mutex _mutex;
+
+   /**
+    * Convert the given time into a number of checks, at least one.
+    */
+   std::size_t to_checks(const duration& time) const
+   {
+      return std::max<std::size_t>(
+            1, std::size_t(time.count() / _check_period.count()));
+   }
+
+   void update_polling_policy()
+   {
+      _update_observer.set_polling_policy(polling_policy(
+            to_checks(COLD_POLLING_INTERVAL),
+            to_checks(POLLING_COOLDOWN_TIME)));
+   }
+
+   /**
+    * Remove the given subscription, and obtain its offset if no other
+    * subscription remains on it.
+    */
+   boost::optional<oac::fsuipc::offset> remove_subscription(
+         const subscription_id& id)
+   throw (fsuipc_offset_db::no_such_subscription_error)
+   {
+      auto offset = _db.get_offset_for_subscription(id);
+      auto pinned = _polling_intervals.erase(id) > 0;
+      if (_db.remove_subscription(id) == 0)
+         return offset;
+      if (pinned)
+         update_max_polling_period(offset);
+      return boost::none;
+   }
+
+   void update_max_polling_period(const oac::fsuipc::offset& offset)
+   {
+      auto period = std::numeric_limits<std::size_t>::max();
+      for (auto& subs : _db.get_subscriptions_for_offset(offset))
+      {
+         auto entry = _polling_intervals.find(subs.get_subscription_id());
+         if (entry != _polling_intervals.end())
+            period = std::min(period, to_checks(entry->second));
+      }
+      _update_observer.set_max_polling_period(offset, period);
+   }
 
    void on_offset_update(
          const oac::fsuipc::valued_offset valued_offset)
    {
+      // The value is converted once for all the subscribers. This is
+      // invoked during the check, so the notification is deferred until
+      // the lock is released.
+      auto var_value = to_variable_value(valued_offset);
       for (auto& subs : _db.get_subscriptions_for_offset(valued_offset))
-      {
-         subs.get_update_handler()(
-                  subs.get_variable(),
-                  to_variable_value(valued_offset));
-      }
+         _notifications.push_back(notification(
+               subs.get_update_handler(),
+               subs.get_variable(),
+               var_value));
    }
 
    void update_offset(
          const oac::fsuipc::offset& offset,
          const variable_value& value)
    {
-      std::list<oac::fsuipc::valued_offset> updates(
-               1,
-               oac::fsuipc::valued_offset(
-                  offset,
-                  to_fsuipc_offset_value(value)));
-      _update_observer.get_client().update(updates);
+      _update_observer.write(
+            oac::fsuipc::valued_offset(offset, to_fsuipc_offset_value(value)));
    }
 };
 
+template <typename FsuipcUserAdapter>
+const typename fsuipc_flight_vars<FsuipcUserAdapter>::duration
+fsuipc_flight_vars<FsuipcUserAdapter>::COLD_POLLING_INTERVAL(1000);
+
+template <typename FsuipcUserAdapter>
+const typename fsuipc_flight_vars<FsuipcUserAdapter>::duration
+fsuipc_flight_vars<FsuipcUserAdapter>::POLLING_COOLDOWN_TIME(5000);
+
+template <typename FsuipcUserAdapter>
+const typename fsuipc_flight_vars<FsuipcUserAdapter>::duration
+fsuipc_flight_vars<FsuipcUserAdapter>::DEFAULT_CHECK_PERIOD(166);
+
 class local_fsuipc_flight_vars :
       public fsuipc_flight_vars<oac::fsuipc::local_user_adapter>
 {
@@ -338,6 +625,18 @@ public:
 typedef fsuipc_flight_vars<
       oac::fsuipc::dummy_user_adapter> dummy_fsuipc_flight_vars;
 
+/**
+ * A FSUIPC Flight Vars on a simulated FSUIPC, useful for benchmarking.
+ */
+typedef fsuipc_flight_vars<
+      oac::fsuipc::simulator_user_adapter> simulated_fsuipc_flight_vars;
+
+/**
+ * A FSUIPC Flight Vars replaying a capture of FSUIPC offsets.
+ */
+typedef fsuipc_flight_vars<
+      oac::fsuipc::replay_user_adapter> replayed_fsuipc_flight_vars;
+
 }} // namespace oac::fv
 
 #endif
@@ -30,15 +30,33 @@
 
 #define LOG_FILE "C:\\Windows\\Temp\\FlightVars.log"
 
+/*
+ * The number of threads that run the IO service of the server. Zero means
+ * as many threads as hardware threads are available.
+ */
+#ifndef FLIGHTVARS_IO_THREADS
+#define FLIGHTVARS_IO_THREADS 0
+#endif
+
+/*
+ * The tick group that drives the checks for FSUIPC offset updates and the
+ * flush of variable updates to the clients. It must be one of the groups
+ * created by the tick scheduler: "30hz", "6hz" or "1hz". The FSUIPC
+ * polling times are converted into checks from the period of this group.
+ */
+#ifndef FLIGHTVARS_FSUIPC_TICK_GROUP
+#define FLIGHTVARS_FSUIPC_TICK_GROUP "6hz"
+#endif
+
 using namespace oac;
 using namespace oac::fv;
 
 namespace {
 
 std::shared_ptr<boost::asio::io_service> io_srv;
-std::shared_ptr<simconnect_tick_observer> tick_obs;
+std::shared_ptr<tick_scheduler> tick_sched;
 std::shared_ptr<flight_vars_server> server;
-boost::thread srv_thread;
+boost::thread_group srv_threads;
 
 }
 
@@ -49,6 +67,36 @@ struct flight_vars_component_launcher : logger_component
       : logger_component("flight_vars_component_launcher")
    {}
 
+   static unsigned int
+   io_thread_count()
+   {
+      unsigned int nthreads = FLIGHTVARS_IO_THREADS;
+      if (!nthreads)
+         nthreads = boost::thread::hardware_concurrency();
+      return nthreads ? nthreads : 1;
+   }
+
+   static void
+   run_io_service()
+   {
+      for (;;)
+      {
+         try
+         {
+            io_srv->run();
+            break; // run terminates, exit normally
+         }
+         catch (oac::exception& e)
+         {
+            // The launcher that started the thread may not exist anymore
+            flight_vars_component_launcher launcher;
+            launcher.log_error(
+                  "Unexpected error while running the IO service: %s",
+                  e.report());
+         }
+      }
+   }
+
    void
    start_io_service()
    {
@@ -57,20 +105,23 @@ struct flight_vars_component_launcher : logger_component
    }
 
    void
-   start_tick_observer()
+   start_tick_scheduler()
    {
-      if (!tick_obs)
+      if (!tick_sched)
       {
          try
          {
-            log_info("Initializing tick observer via SimConnect");
-            tick_obs = std::make_shared<simconnect_tick_observer>();
-            log_info("Tick observer successfully initialized");
+            log_info("Initializing tick scheduler");
+            tick_sched = std::make_shared<tick_scheduler>(io_srv);
+            tick_sched->add_group("30hz", tick_scheduler::duration(33));
+            tick_sched->add_group("6hz", tick_scheduler::duration(166));
+            tick_sched->add_group("1hz", tick_scheduler::duration(1000));
+            log_info("Tick scheduler successfully initialized");
          }
          catch (oac::exception& e)
          {
             log_error(
-                  "Unexpected error while initializing tick observer:\n%s",
+                  "Unexpected error while initializing tick scheduler:\n%s",
                   e.report());
             throw e;
          }
@@ -84,10 +135,18 @@ struct flight_vars_component_launcher : logger_component
       {
          log_info("Initializing FSUIPC FlightVars object");
          auto fsuipc = std::make_shared<local_fsuipc_flight_vars>();
-               tick_obs->register_handler(
-                     std::bind(
-                           &local_fsuipc_flight_vars::check_for_updates,
-                           fsuipc));
+         auto& group = tick_sched->group(FLIGHTVARS_FSUIPC_TICK_GROUP);
+         fsuipc->set_check_period(group.period());
+
+         // The ticks run on the IO threads. The check takes the lock of the
+         // FSUIPC object, which serializes it with the subscriptions and
+         // updates requested by the sessions. The handlers of a group are
+         // invoked in order by the same timer handler, so the flush
+         // registered by the server always follows the check.
+         group.register_handler(
+               std::bind(
+                     &local_fsuipc_flight_vars::check_for_updates,
+                     fsuipc));
 
          flight_vars_core::instance()->register_group_master(
                local_fsuipc_flight_vars::VAR_GROUP,
@@ -119,25 +178,22 @@ struct flight_vars_component_launcher : logger_component
                   core,
                   flight_vars_server::DEFAULT_PORT,
                   io_srv);
-
-            srv_thread = boost::thread([this]() {
-               for (;;)
-               {
-                  try
-                  {
-                     io_srv->run();
-                     break; // run terminates, exit normally
-                  }
-                  catch (oac::exception& e)
-                  {
-                     log_error(
-                           "Unexpected error while running the IO service: %s",
-                           e.report());
-                  }
-               }
-            });
-
-            log_info("FlightVars TCP server successfully initialized");
+            tick_sched->register_handler(
+                  FLIGHTVARS_FSUIPC_TICK_GROUP,
+                  std::bind(
+                        &flight_vars_server::flush_var_updates,
+                        server));
+
+            auto nthreads = io_thread_count();
+            for (unsigned int i = 0; i < nthreads; i++)
+               srv_threads.create_thread(
+                     &flight_vars_component_launcher::run_io_service);
+
+            log(
+                  log_level::INFO,
+                  "FlightVars TCP server successfully initialized "
+                  "with %d IO threads",
+                  nthreads);
          } catch (oac::exception& e)
          {
             log_error("Unexpected error: %s", e.report());
@@ -150,8 +206,9 @@ struct flight_vars_component_launcher : logger_component
    stop_server()
    {
       log_info("Stopping FlightVars server");
+      tick_sched->stop();
       io_srv->stop();
-      srv_thread.join();
+      srv_threads.join_all();
       log_info("FlightVars server stopped");
    }
 };
@@ -166,7 +223,7 @@ void __stdcall DLLStart(void)
       flight_vars_component_launcher launcher;
 
       launcher.start_io_service();
-      launcher.start_tick_observer();
+      launcher.start_tick_scheduler();
       launcher.start_fsuipc();
       launcher.start_server();
    }
@@ -16,6 +16,9 @@
  * along with Open Airbus Cockpit.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <iterator>
+
 #include <flightvars/core.h>
 #include <liboac/logging.h>
 
@@ -35,10 +38,45 @@ unmarshall(StreamBuffer& buff)
    return result;
 }
 
+/**
+ * The maximum size of a var update message built from an encoded update,
+ * which comprises the message begin and end marks besides the update.
+ */
+const std::size_t MAX_ENCODED_VAR_UPDATE_MSG_SIZE =
+      proto::encoded_var_update::MAX_SIZE + 4;
+
+typedef std::vector<proto::encoded_var_update>::const_iterator
+      encoded_var_update_iterator;
+
+/**
+ * A message writer for serialize_frame_with() that serializes a var update
+ * batch message from a range of encoded updates.
+ */
+struct encoded_var_update_batch_writer
+{
+   encoded_var_update_iterator first;
+   encoded_var_update_iterator last;
+
+   encoded_var_update_batch_writer(
+         encoded_var_update_iterator f,
+         encoded_var_update_iterator l)
+      : first(f), last(l)
+   {}
+
+   template <typename OutputStream>
+   void operator()(OutputStream& output) const
+   {
+      proto::serialize_encoded_var_update_batch<
+            proto::binary_message_serializer>(first, last, output);
+   }
+};
+
 } // anonymous namespace
 
 const int flight_vars_server::DEFAULT_PORT(8642);
 const proto::peer_name flight_vars_server::PEER_NAME("FlightVars Server");
+const std::size_t flight_vars_server::MAX_VAR_UPDATE_BATCH_SIZE(64);
+const std::size_t flight_vars_server::DEFAULT_MAX_OUTPUT_QUEUE_SIZE(64*1024);
 
 flight_vars_server::flight_vars_server(
       const std::shared_ptr<flight_vars>& delegate,
@@ -53,7 +91,11 @@ flight_vars_server::flight_vars_server(
                  this,
                  std::placeholders::_1),
            io_srv,
-           network::error_handler())
+           network::error_handler()),
+     _output_buffers(std::make_shared<output_buffer_type::factory>(1024)),
+     _max_output_queue_size(DEFAULT_MAX_OUTPUT_QUEUE_SIZE),
+     _max_session_lag(0),
+     _deferred_updates(0)
 {
    log(log_level::INFO, "Initialized on port %d", port);
    if (!_delegate)
@@ -65,6 +107,36 @@ flight_vars_server::~flight_vars_server()
    log_info("Stopping service");
 }
 
+void
+flight_vars_server::flush_var_updates()
+{
+   // The incoming updates of each session are only sent from its strand.
+   // The dirty sessions list is swapped out before the sessions are
+   // locked, since releasing the last reference to a session while the
+   // dirty sessions mutex is locked would lead to a deadlock. See
+   // handle_var_update().
+   if (_deferred_updates)
+      deliver_deferred_updates();
+
+   boost::unique_lock<boost::mutex> flush_lock(_flush_mutex);
+   {
+      boost::unique_lock<boost::mutex> lock(_dirty_sessions_mutex);
+      _flushing_sessions.swap(_dirty_sessions);
+   }
+   for (auto& weak_session : _flushing_sessions)
+   {
+      if (auto session = weak_session.lock())
+      {
+         session->strand.post(
+               std::bind(
+                     &flight_vars_server::send_pending_var_updates,
+                     shared_from_this(),
+                     session));
+      }
+   }
+   _flushing_sessions.clear();
+}
+
 flight_vars_server::session::~session()
 {
    log_info(
@@ -76,32 +148,92 @@ flight_vars_server::session::~session()
 void
 flight_vars_server::session::unsubscribe_all()
 {
-   subscriptions.for_each_subscription([this](const subscription_id& subs)
+   std::vector<variable_id> var_ids;
+   subscriptions.for_each_subscription(
+         [this, &var_ids](const subscription_id& subs)
    {
-      server->_delegate->unsubscribe(subs);
+      var_ids.push_back(subscriptions.get_var_id(subs));
    });
+   server->unregister_subscribers(this, var_ids);
    subscriptions.clear();
 }
 
+bool
+flight_vars_server::session::push_update(
+      const proto::encoded_var_update& update,
+      subs::subscription_priority priority)
+{
+   boost::unique_lock<boost::mutex> lock(updates_mutex);
+   auto was_clean = std::all_of(
+         std::begin(updates),
+         std::end(updates),
+         [](const update_class& cls) { return cls.incoming.empty(); });
+   auto& cls = updates_of(priority);
+   if (cls.incoming.empty())
+      cls.incoming_since = boost::chrono::steady_clock::now();
+   cls.incoming.push_back(update);
+   return was_clean;
+}
+
 void
 flight_vars_server::accept_connection(
       const network::async_tcp_connection_ptr& conn)
 {
    auto s = std::make_shared<session>(shared_from_this(), conn);
+   {
+      boost::unique_lock<boost::mutex> lock(_sessions_mutex);
+      _sessions.erase(
+            std::remove_if(
+                  _sessions.begin(),
+                  _sessions.end(),
+                  [](const session_wptr& elem) { return elem.expired(); }),
+            _sessions.end());
+      _sessions.push_back(s);
+   }
    read_begin_session(s);
 }
 
+std::vector<flight_vars_server::session_stats>
+flight_vars_server::get_session_stats() const
+{
+   std::vector<session_stats> result;
+   boost::unique_lock<boost::mutex> lock(_sessions_mutex);
+   for (auto& weak_session : _sessions)
+   {
+      if (auto session = weak_session.lock())
+      {
+         session_stats stats;
+         stats.remote = session->conn->remote_to_string();
+         stats.queue_depth = session->queued_bytes;
+         stats.held_updates = session->held_updates;
+         stats.dropped_updates = session->dropped_updates;
+         for (std::size_t i = 0; i < subs::SUBSCRIPTION_PRIORITY_COUNT; i++)
+         {
+            auto& cls = session->updates[i];
+            auto& latency = stats.latency[i];
+            latency.samples = cls.samples;
+            latency.mean = boost::chrono::microseconds(
+                  latency.samples ? cls.total_latency / latency.samples : 0);
+            latency.max = boost::chrono::microseconds(cls.max_latency);
+         }
+         result.push_back(stats);
+      }
+   }
+   return result;
+}
+
 void
 flight_vars_server::read_begin_session(
       const session_ptr& session)
 {
    session->conn->read(
             *session->input_buffer,
-            std::bind(
-               &flight_vars_server::on_read_begin_session,
-               shared_from_this(),
-               session,
-               std::placeholders::_1));
+            session->strand.wrap(
+               std::bind(
+                  &flight_vars_server::on_read_begin_session,
+                  shared_from_this(),
+                  session,
+                  std::placeholders::_1)));
 }
 
 void
@@ -124,14 +256,15 @@ flight_vars_server::on_read_begin_session(
                bs_msg->pname,
                (bs_msg->proto_ver >> 8),
                (bs_msg->proto_ver & 0x00ff));
-         auto rep = begin_session_message(PEER_NAME);
-         write_message(
-                  session->conn,
-                  rep,
-                  std::bind(
-                     &flight_vars_server::read_request,
-                     shared_from_this(),
-                     session));
+         auto proto_ver = std::min<protocol_version>(
+               bs_msg->proto_ver, FLIGHTVARS_PROTOCOL_VERSION);
+         auto rep = begin_session_message(PEER_NAME, proto_ver);
+
+         // The begin session reply is never framed, so it is queued before
+         // the negotiated version takes effect for the session
+         send_message(session, rep);
+         session->proto_ver = proto_ver;
+         read_request(session);
       }
       else
       {
@@ -163,11 +296,12 @@ flight_vars_server::read_request(
    {
       session->conn->read(
                *session->input_buffer,
-               std::bind(
-                  &flight_vars_server::on_read_request,
-                  shared_from_this(),
-                  session,
-                  std::placeholders::_1));
+               session->strand.wrap(
+                  std::bind(
+                     &flight_vars_server::on_read_request,
+                     shared_from_this(),
+                     session,
+                     std::placeholders::_1)));
    }
    catch (io_exception& e)
    {
@@ -197,60 +331,47 @@ flight_vars_server::on_read_request(
             "Connection unexpectedly reset by remote peer: session discarded");
       return;
    }
+   catch (const io_exception& e)
+   {
+      log_warn(
+            "Connection closed with an error: session discarded:\n%s",
+            e.report());
+      return;
+   }
 
    try
    {
-      auto msg = unmarshall(*session->input_buffer);
-      if (auto es_msg = boost::get<proto::end_session_message>(&msg))
-      {
-         log_info("Session closed by peer (%s)", es_msg->cause);
-         return;
-      }
-      else if (auto s_req = boost::get<subscription_request_message>(&msg))
-      {
-         log(
-               log_level::INFO,
-               "Processing subscription request for variable %s",
-               variable_id(s_req->var_grp, s_req->var_name).to_string());
-         auto rep = handle_subscription_request(session, *s_req);
-         write_message(
-                  session->conn,
-                  rep,
-                  std::bind(
-                     &flight_vars_server::read_request,
-                     shared_from_this(),
-                     session));
-      }
-      else if (auto us_req = boost::get<unsubscription_request_message>(&msg))
-      {
-         log_info(
-               "Processing unsubscription request for ID %d",
-               us_req->subs_id);
-         auto rep = handle_unsubscription_request(session, *us_req);
-         write_message(
-                  session->conn,
-                  rep,
-                  std::bind(
-                     &flight_vars_server::read_request,
-                     shared_from_this(),
-                     session));
-      }
-      else if (auto vu_req = boost::get<var_update_message>(&msg))
+      auto& input = *session->input_buffer;
+      if (session->supports_framing())
       {
-         handle_var_update_request(*vu_req);
-         read_request(session);
+         // The frame decoder tells whether a complete message is available
+         // before parsing it, so partially received messages are left in
+         // the buffer until the next read.
+         while (session->frames.frame_ready<binary_message_deserializer>(
+                  input))
+         {
+            auto msg = session->frames.decode<binary_message_deserializer>(
+                  input);
+            if (!process_request(session, msg))
+               return;
+         }
       }
       else
       {
-         log_warn(
-             "Protocol error: unexpected message while expecting "
-             "an end session, supscription request or variable update message");
+         try
+         {
+            while (input.available_for_read())
+            {
+               if (!process_request(session, unmarshall(input)))
+                  return;
+            }
+         }
+         catch (io::eof_error&)
+         {
+            // message partially received, try to obtain more bytes
+            input.reset();
+         }
       }
-   }
-   catch (io::eof_error&)
-   {
-      // message partially received, try to obtain more bytes
-      session->input_buffer->reset();
       read_request(session);
    }
    catch (oac::exception& e)
@@ -261,6 +382,51 @@ flight_vars_server::on_read_request(
    }
 }
 
+bool
+flight_vars_server::process_request(
+      const session_ptr& session,
+      const proto::message& msg)
+{
+   using namespace proto;
+
+   if (auto es_msg = boost::get<proto::end_session_message>(&msg))
+   {
+      log_info("Session closed by peer (%s)", es_msg->cause);
+      return false;
+   }
+   else if (auto s_req = boost::get<subscription_request_message>(&msg))
+   {
+      log(
+            log_level::INFO,
+            "Processing subscription request for variable %s",
+            variable_id(s_req->var_grp, s_req->var_name).to_string());
+      auto rep = handle_subscription_request(session, *s_req);
+      send_message(session, rep);
+      return true;
+   }
+   else if (auto us_req = boost::get<unsubscription_request_message>(&msg))
+   {
+      log_info(
+            "Processing unsubscription request for ID %d",
+            us_req->subs_id);
+      auto rep = handle_unsubscription_request(session, *us_req);
+      send_message(session, rep);
+      return true;
+   }
+   else if (auto vu_req = boost::get<var_update_message>(&msg))
+   {
+      handle_var_update_request(*vu_req);
+      return true;
+   }
+   else
+   {
+      log_warn(
+          "Protocol error: unexpected message while expecting "
+          "an end session, supscription request or variable update message");
+      return false;
+   }
+}
+
 proto::subscription_reply_message
 flight_vars_server::handle_subscription_request(
       const session_ptr& session,
@@ -285,18 +451,8 @@ flight_vars_server::handle_subscription_request(
 
    try
    {
-      session_wptr weak_session(session);
-      auto subs_id = _delegate->subscribe(
-               var_id,
-               std::bind(
-                  &flight_vars_server::handle_var_update,
-                  shared_from_this(),
-                  weak_session,
-                  std::placeholders::_1,
-                  std::placeholders::_2));
-      log(
-            log_level::INFO,
-            "Subscription for %s registered by delegate", var_str);
+      auto subs_id = register_subscriber(
+            session, var_id, req.qos.get_value_or(subs::subscription_qos()));
       session->subscriptions.register_subscription(var_id, subs_id);
       return proto::subscription_reply_message(
             proto::subscription_status::SUBSCRIBED,
@@ -329,16 +485,16 @@ flight_vars_server::handle_unsubscription_request(
    auto subs_id = req.subs_id;
    try
    {
-      _delegate->unsubscribe(subs_id);
-      log_info("Unsubscription for %d registered by delegate", subs_id);
+      auto var_id = session->subscriptions.get_var_id(subs_id);
       session->subscriptions.unregister(subs_id);
+      unregister_subscriber(session.get(), var_id);
 
       return proto::unsubscription_reply_message(
             proto::subscription_status::UNSUBSCRIBED,
             subs_id,
             "");
    }
-   catch (const flight_vars::no_such_subscription_error& e)
+   catch (const subs::no_such_subscription_error& e)
    {
       log_warn(
             "cannot unsubscribe from %d: unknown subscription:\n%s",
@@ -349,12 +505,12 @@ flight_vars_server::handle_unsubscription_request(
             subs_id,
             format("No such subscription with ID %d", subs_id));
    }
-   catch (const subs::no_such_subscription_error& e)
+   catch (const flight_vars::no_such_subscription_error& e)
    {
       log_warn(
-            "internal inconsistency detected; delegate succeed to "
-            "unsubscribe from %d, but subscription mapper indicates that "
-            "the subscription doesn't exists:\n%s",
+            "internal inconsistency detected; subscription mapper succeed "
+            "to unregister %d, but delegate indicates that the "
+            "subscription doesn't exists:\n%s",
             subs_id,
             e.report());
       return proto::unsubscription_reply_message(
@@ -364,101 +520,559 @@ flight_vars_server::handle_unsubscription_request(
    }
 }
 
+subscription_id
+flight_vars_server::register_subscriber(
+      const session_ptr& session,
+      const variable_id& var_id,
+      const subs::subscription_qos& qos)
+throw (flight_vars::no_such_variable_error)
+{
+   subscriber subs = { session.get(), session, subs::qos_filter(qos) };
+   boost::unique_lock<boost::mutex> lock(_subscribers_mutex);
+   for (;;)
+   {
+      auto entry = _subscribers.find(var_id);
+      if (entry == _subscribers.end())
+         break;
+      if (!entry->second.pending)
+      {
+         entry->second.sessions.push_back(subs);
+         auto subs_id = entry->second.subs_id;
+         auto lowered = lower_max_interval(entry->second, qos);
+         lock.unlock();
+         if (lowered)
+            request_max_polling_interval(var_id);
+         return subs_id;
+      }
+      // Another session is subscribing to the delegate, which may fail
+      _subscribers_ready.wait(lock);
+   }
+
+   // The pending entry makes other sessions wait for this subscription
+   // rather than requesting another one to the delegate
+   var_subscribers placeholder;
+   placeholder.pending = true;
+   _subscribers.insert(std::make_pair(var_id, placeholder));
+   lock.unlock();
+
+   subscription_id subs_id;
+   try
+   {
+      subs_id = _delegate->subscribe(
+               var_id,
+               std::bind(
+                  &flight_vars_server::handle_var_update,
+                  shared_from_this(),
+                  std::placeholders::_1,
+                  std::placeholders::_2));
+   }
+   catch (...)
+   {
+      lock.lock();
+      _subscribers.erase(var_id);
+      _subscribers_ready.notify_all();
+      throw;
+   }
+   log(
+         log_level::INFO,
+         "Subscription for %s registered by delegate with ID %d",
+         var_id.to_string(),
+         subs_id);
+
+   lock.lock();
+   auto& subscribers = _subscribers.find(var_id)->second;
+   subscribers.subs_id = subs_id;
+   subscribers.pending = false;
+   subscribers.sessions.push_back(subs);
+   if (auto update = subscribers.pending_update)
+   {
+      subscribers.pending_update = boost::none;
+      dispatch_var_update(subscribers, *update);
+   }
+   auto lowered = lower_max_interval(subscribers, qos);
+   _subscribers_ready.notify_all();
+   lock.unlock();
+   if (lowered)
+      request_max_polling_interval(var_id);
+   return subs_id;
+}
+
+bool
+flight_vars_server::lower_max_interval(
+      var_subscribers& subscribers,
+      const subs::subscription_qos& qos)
+{
+   if (!qos.max_interval ||
+       (subscribers.max_interval &&
+        subscribers.max_interval <= qos.max_interval))
+      return false;
+   subscribers.max_interval = qos.max_interval;
+   return true;
+}
+
+void
+flight_vars_server::request_max_polling_interval(
+      const variable_id& var_id)
+{
+   boost::unique_lock<boost::mutex> polling_lock(_polling_mutex);
+   subscription_id subs_id;
+   std::uint32_t max_interval;
+   {
+      boost::unique_lock<boost::mutex> lock(_subscribers_mutex);
+      auto entry = _subscribers.find(var_id);
+      if (entry == _subscribers.end() || entry->second.pending)
+         return;
+      subs_id = entry->second.subs_id;
+      max_interval = entry->second.max_interval;
+   }
+   try
+   {
+      _delegate->set_max_polling_interval(
+            subs_id, boost::chrono::milliseconds(max_interval));
+   }
+   catch (flight_vars::no_such_subscription_error&)
+   {
+      // The last session unsubscribed from the variable meanwhile
+      log_trace(
+         "Discarding polling interval of %s: no session is subscribed to it "
+         "anymore",
+         var_id.to_string());
+   }
+}
+
+void
+flight_vars_server::unregister_subscriber(
+      const session* session,
+      const variable_id& var_id)
+throw (flight_vars::no_such_subscription_error)
+{
+   boost::optional<subscription_id> subs_id;
+   {
+      boost::unique_lock<boost::mutex> lock(_subscribers_mutex);
+      subs_id = remove_subscriber(session, var_id);
+   }
+   if (subs_id)
+   {
+      _delegate->unsubscribe(*subs_id);
+      log_info("Unsubscription for %d registered by delegate", *subs_id);
+   }
+}
+
+void
+flight_vars_server::unregister_subscribers(
+      const session* session,
+      const std::vector<variable_id>& var_ids)
+{
+   flight_vars::subscription_id_list subs_ids;
+   {
+      boost::unique_lock<boost::mutex> lock(_subscribers_mutex);
+      for (auto& var_id : var_ids)
+      {
+         if (auto subs_id = remove_subscriber(session, var_id))
+            subs_ids.push_back(*subs_id);
+      }
+   }
+   if (!subs_ids.empty())
+   {
+      _delegate->unsubscribe_all(subs_ids);
+      log_info(
+            "Unsubscription for %d variables registered by delegate",
+            subs_ids.size());
+   }
+}
+
+boost::optional<subscription_id>
+flight_vars_server::remove_subscriber(
+      const session* session,
+      const variable_id& var_id)
+{
+   auto entry = _subscribers.find(var_id);
+   if (entry == _subscribers.end() || entry->second.pending)
+      return boost::none;
+
+   auto& sessions = entry->second.sessions;
+   sessions.erase(
+         std::remove_if(
+               sessions.begin(),
+               sessions.end(),
+               [this, session](const subscriber& subs) -> bool
+               {
+                  if (subs.target != session)
+                     return false;
+                  if (subs.filter.has_deferred())
+                     _deferred_updates--;
+                  return true;
+               }),
+         sessions.end());
+   if (!sessions.empty())
+      return boost::none;
+
+   auto subs_id = entry->second.subs_id;
+   _subscribers.erase(entry);
+   return subs_id;
+}
+
 void
 flight_vars_server::handle_var_update(
-      const session_wptr& session,
       const variable_id& var_id,
       const variable_value& var_value)
 {
-   // This function does not send the var update directly. Instead, it
-   // requests the IO service of the TCP server to do it. That avoids
-   // the delegate notification thread to handle the session at the same
-   // time the TCP server thread does. In other words, it guarantees only
-   // one thread accessing the internal state of the server.
-   auto s = session.lock();
-   if (s)
-   {
-      _tcp_server.io_service().post(
-            std::bind(
-                  &flight_vars_server::send_var_update,
-                  shared_from_this(),
-                  s,
-                  var_id,
-                  var_value));
+   // This function does not send the var update directly. Instead, the
+   // update is encoded once and appended to the incoming updates of every
+   // subscribed session, which are sent from the strand of the session on
+   // the next flush. That avoids the delegate notification thread to handle
+   // the session at the same time an IO thread does. No session reference
+   // is acquired here: releasing the last one would destroy the session,
+   // which locks the subscribers mutex to unregister itself.
+   boost::unique_lock<boost::mutex> lock(_subscribers_mutex);
+   auto entry = _subscribers.find(var_id);
+   if (entry == _subscribers.end())
+   {
+      // The delegate may notify the changes detected by a check after the
+      // last session unsubscribed, once it released its own lock
+      log_trace(
+         "Discarding update of %s: no session is subscribed to it anymore",
+         var_id.to_string());
+      return;
    }
-   else
-      log_warn(
-         "Inconsistency found while sending variable update to remote peer: "
-         "the session object has been destroyed but the subscription still "
-         "persists");
+   if (entry->second.pending)
+   {
+      // The delegate notified the update before the subscription returned
+      entry->second.pending_update = var_value;
+      return;
+   }
+   dispatch_var_update(entry->second, var_value);
 }
 
 void
-flight_vars_server::send_var_update(
-      const session_ptr& session,
-      const variable_id& var_id,
+flight_vars_server::dispatch_var_update(
+      var_subscribers& subscribers,
       const variable_value& var_value)
 {
-   // This function does send the var update. It is guaranteed to be invoked
-   // from the same thread that attends the TCP server, removing any chance
-   // of concurrency issues. See the comment in handle_var_update().
    try
    {
-      auto subs_id = session->subscriptions.get_subscription_id(var_id);
-      proto::var_update_message msg(subs_id, var_value);
-      write_message(session->conn, msg, [](){});
+      // The update is only encoded if any subscriber QoS accepts it
+      auto now = subs::qos_filter::clock::now();
+      boost::optional<proto::encoded_var_update> update;
+      for (auto& subs : subscribers.sessions)
+      {
+         auto was_deferred = subs.filter.has_deferred();
+         auto accepted = subs.filter.accept(var_value, now);
+         if (subs.filter.has_deferred() != was_deferred)
+         {
+            if (was_deferred)
+               _deferred_updates--;
+            else
+               _deferred_updates++;
+         }
+         if (!accepted)
+            continue;
+         if (!update)
+            update = proto::encode_var_update<
+                  proto::binary_message_serializer>(
+                        subscribers.subs_id, var_value);
+         deliver_update(subs, *update);
+      }
    }
-   catch (subs::no_such_variable_error& e)
+   catch (io_exception& e)
    {
-      log(
-            log_level::WARN,
-            "Internal state error: a var update was notified for "
-            "variable %s, but no associated subscription ID was found:\n%s",
-            var_id.to_string(),
+      log_error(
+            "Unexpected IO exception thrown while "
+            "encoding a var update:\n%s",
             e.report());
    }
+}
+
+void
+flight_vars_server::deliver_deferred_updates()
+{
+   boost::unique_lock<boost::mutex> lock(_subscribers_mutex);
+   auto now = subs::qos_filter::clock::now();
+   for (auto& entry : _subscribers)
+   {
+      for (auto& subs : entry.second.sessions)
+      {
+         if (!subs.filter.has_deferred())
+            continue;
+         if (auto value = subs.filter.take_deferred(now))
+         {
+            _deferred_updates--;
+            try
+            {
+               deliver_update(
+                     subs,
+                     proto::encode_var_update<
+                           proto::binary_message_serializer>(
+                                 entry.second.subs_id, *value));
+            }
+            catch (io_exception& e)
+            {
+               log_error(
+                     "Unexpected IO exception thrown while "
+                     "encoding a deferred var update:\n%s",
+                     e.report());
+            }
+         }
+      }
+   }
+}
+
+void
+flight_vars_server::deliver_update(
+      const subscriber& subs,
+      const proto::encoded_var_update& update)
+{
+   if (subs.target->push_update(update, subs.filter.qos().priority))
+   {
+      boost::unique_lock<boost::mutex> dirty_lock(_dirty_sessions_mutex);
+      _dirty_sessions.push_back(subs.weak_target);
+   }
+}
+
+void
+flight_vars_server::send_pending_var_updates(
+      const session_ptr& session)
+{
+   conflate_updates(session);
+
+   if (is_lagging(session))
+   {
+      // The client does not consume the output as fast as it is produced.
+      // Updates are held back, so the output queue does not grow anymore
+      // and only the most recent value of each variable will be sent.
+      auto now = boost::chrono::steady_clock::now();
+      if (!session->lagging_since)
+         session->lagging_since = now;
+      else if (_max_session_lag.count() &&
+               now - *session->lagging_since > _max_session_lag)
+      {
+         log_warn(
+               "Session from %s lagging for more than %d ms; disconnecting",
+               session->conn->remote_to_string(),
+               _max_session_lag.count());
+         for (auto& cls : session->updates)
+            cls.pending.clear();
+         boost::system::error_code ec;
+         session->conn->socket().close(ec);
+         return;
+      }
+
+      // Critical updates are never held back, since they are expected to
+      // be few and the client is expected to act on them promptly.
+      write_pending_updates(session, subs::subscription_priority::CRITICAL);
+      session->held_updates =
+            session->updates_of(subs::subscription_priority::NORMAL)
+                  .pending.size() +
+            session->updates_of(subs::subscription_priority::BULK)
+                  .pending.size();
+      return;
+   }
+
+   write_pending_updates(session);
+}
+
+void
+flight_vars_server::conflate_updates(
+      const session_ptr& session)
+{
+   boost::unique_lock<boost::mutex> lock(session->updates_mutex);
+   for (std::size_t i = 0; i < subs::SUBSCRIPTION_PRIORITY_COUNT; i++)
+   {
+      auto& cls = session->updates[i];
+      auto& pending = cls.pending;
+      auto& incoming = cls.incoming;
+      if (incoming.empty())
+         continue;
+      if (pending.empty())
+      {
+         cls.pending_since = cls.incoming_since;
+         if (i != static_cast<std::size_t>(subs::subscription_priority::BULK))
+         {
+            pending.swap(incoming);
+            continue;
+         }
+      }
+
+      // There are updates held back since the previous flushes, or the
+      // updates are bulk, so only the most recent value of each variable
+      // is worth sending. Each incoming update replaces the last pending
+      // one for the same subscription. The pending list is bounded by the
+      // number of subscriptions, so a linear search is cheaper than
+      // maintaining an index.
+      for (auto& update : incoming)
+      {
+         auto match = std::find_if(
+               pending.rbegin(),
+               pending.rend(),
+               [&update](const proto::encoded_var_update& elem)
+               { return elem.subs_id() == update.subs_id(); });
+         if (match != pending.rend())
+         {
+            *match = update;
+            session->dropped_updates++;
+         }
+         else
+            pending.push_back(update);
+      }
+      incoming.clear();
+   }
+}
+
+void
+flight_vars_server::write_pending_updates(
+      const session_ptr& session)
+{
+   write_pending_updates(session, subs::subscription_priority::CRITICAL);
+   write_pending_updates(session, subs::subscription_priority::NORMAL);
+   write_pending_updates(session, subs::subscription_priority::BULK);
+   session->held_updates = 0;
+}
+
+void
+flight_vars_server::write_pending_updates(
+      const session_ptr& session,
+      subs::subscription_priority priority)
+{
+   auto& cls = session->updates_of(priority);
+   auto& updates = cls.pending;
+   if (updates.empty())
+      return;
+
+   try
+   {
+      if (session->supports_var_update_batch())
+      {
+         auto it = updates.begin();
+         while (it != updates.end())
+         {
+            auto count = std::min<std::size_t>(
+                  MAX_VAR_UPDATE_BATCH_SIZE, updates.end() - it);
+            auto buff = _output_buffers.acquire();
+            encoded_var_update_batch_writer writer(it, it + count);
+            if (session->supports_framing())
+               proto::serialize_frame_with<proto::binary_message_serializer>(
+                     writer, *buff);
+            else
+               writer(*buff);
+            enqueue_output(session, buff);
+            it += count;
+         }
+      }
+      else
+      {
+         // Legacy peers receive one message per update. As many of them
+         // as possible are packed into the same buffer.
+         output_buffer_ptr buff;
+         for (auto& update : updates)
+         {
+            if (!buff ||
+                buff->available_for_write() < MAX_ENCODED_VAR_UPDATE_MSG_SIZE)
+            {
+               if (buff)
+                  enqueue_output(session, buff);
+               buff = _output_buffers.acquire();
+            }
+            proto::serialize_encoded_var_update<
+                  proto::binary_message_serializer>(update, *buff);
+         }
+         if (buff)
+            enqueue_output(session, buff);
+      }
+   }
    catch (io_exception& e)
    {
       log_error(
             "Unexpected IO exception thrown while "
-            "sending a var update to the client:\n%s",
+            "sending var updates to the client:\n%s",
             e.report());
    }
+   updates.clear();
+
+   auto latency = boost::chrono::duration_cast<boost::chrono::microseconds>(
+         boost::chrono::steady_clock::now() - cls.pending_since).count();
+   cls.samples++;
+   cls.total_latency += latency;
+   if (std::uint64_t(latency) > cls.max_latency)
+      cls.max_latency = latency;
+}
+
+void
+flight_vars_server::send_message(
+      const session_ptr& session,
+      const proto::message& msg)
+{
+   // The buffer returns to the pool once the write completes and the
+   // session releases it. See on_output_written().
+   auto buff = _output_buffers.acquire();
+   if (session->supports_framing())
+      proto::serialize_frame<proto::binary_message_serializer>(msg, *buff);
+   else
+      proto::serialize<proto::binary_message_serializer>(msg, *buff);
+   enqueue_output(session, buff);
 }
 
 void
-flight_vars_server::write_message(
-      const network::async_tcp_connection_ptr& conn,
-      const proto::message& msg,
-      const after_write_handler& after_write)
-{
-   auto buff = std::make_shared<output_buffer_type>(1024);
-   proto::serialize<proto::binary_message_serializer>(msg, *buff);
-   conn->write(
-            *buff,
-            std::bind(
-               &flight_vars_server::on_write_message,
-               shared_from_this(),
-               buff,
-               after_write,
-               std::placeholders::_1));
+flight_vars_server::enqueue_output(
+      const session_ptr& session,
+      const output_buffer_ptr& buff)
+{
+   session->output_queue.push_back(buff);
+   session->queued_bytes += buff->available_for_read();
+   if (!session->writing)
+      flush_output(session);
 }
 
 void
-flight_vars_server::on_write_message(
-      const output_buffer_ptr& buffer,
-      const after_write_handler& after_write,
+flight_vars_server::flush_output(
+      const session_ptr& session)
+{
+   session->output_in_flight.swap(session->output_queue);
+   session->output_regions.clear();
+   session->in_flight_bytes = 0;
+   for (auto& buff : session->output_in_flight)
+   {
+      session->output_regions.push_back(buff->read_region());
+      session->in_flight_bytes += buff->available_for_read();
+   }
+
+   session->writing = true;
+   session->conn->write_all(
+            session->output_regions,
+            session->strand.wrap(
+               std::bind(
+                  &flight_vars_server::on_output_written,
+                  shared_from_this(),
+                  session,
+                  std::placeholders::_1)));
+}
+
+void
+flight_vars_server::on_output_written(
+      const session_ptr& session,
       const attempt<std::size_t>& bytes_transferred)
 {
+   session->writing = false;
+   session->output_in_flight.clear();
+   session->queued_bytes -= session->in_flight_bytes;
+   session->in_flight_bytes = 0;
    try
    {
       bytes_transferred.get_value();
-      after_write();
+
+      // Once the session catches up, the updates held back are sent
+      if (!is_lagging(session) && session->lagging_since)
+      {
+         session->lagging_since.reset();
+         write_pending_updates(session);
+      }
+      if (!session->writing && !session->output_queue.empty())
+         flush_output(session);
    }
    catch (const oac::exception& e)
    {
       log_error(
             "An error was returned while writing message:\n%s", e.report());
+      session->output_queue.clear();
    }
 }
 
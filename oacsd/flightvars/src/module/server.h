@@ -19,11 +19,16 @@
 #ifndef OAC_FV_SERVER_H
 #define OAC_FV_SERVER_H
 
-#include <list>
+#include <atomic>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
+#include <boost/chrono.hpp>
+#include <boost/optional.hpp>
+#include <boost/thread.hpp>
 #include <flightvars/api.h>
 #include <flightvars/protocol.h>
 #include <flightvars/subscription.h>
@@ -40,6 +45,8 @@ public:
 
    static const int DEFAULT_PORT;
    static const proto::peer_name PEER_NAME;
+   static const std::size_t MAX_VAR_UPDATE_BATCH_SIZE;
+   static const std::size_t DEFAULT_MAX_OUTPUT_QUEUE_SIZE;
 
    flight_vars_server(
          const std::shared_ptr<flight_vars>& delegate = nullptr,
@@ -55,8 +62,82 @@ public:
    boost::asio::io_service& io_service()
    { return _tcp_server.io_service(); }
 
+   /**
+    * Flush the variable updates accumulated since the last flush. Sessions
+    * that negotiated a protocol version supporting batches receive all the
+    * updates of the tick in a single variable update batch message, while
+    * the rest receive one variable update message per update. This is
+    * expected to be invoked at the end of each tick, once the group
+    * masters have checked for updates. It is safe to call it from any
+    * thread.
+    */
+   void flush_var_updates();
+
+   /**
+    * The latency statistics of a priority class.
+    */
+   struct latency_stats
+   {
+      /** The number of times updates of the class were queued. */
+      std::uint64_t samples;
+
+      boost::chrono::microseconds mean;
+      boost::chrono::microseconds max;
+   };
+
+   /**
+    * The statistics of a session output.
+    */
+   struct session_stats
+   {
+      /** The remote endpoint of the session. */
+      std::string remote;
+
+      /** The number of bytes queued or being written to the session. */
+      std::size_t queue_depth;
+
+      /** The number of var updates held back while the session lags. */
+      std::size_t held_updates;
+
+      /** The number of var updates superseded by a more recent value. */
+      std::uint64_t dropped_updates;
+
+      /**
+       * The time the var updates of each priority class wait in the server
+       * since notified by the delegate until queued for sending, indexed
+       * by subscription priority.
+       */
+      latency_stats latency[subs::SUBSCRIPTION_PRIORITY_COUNT];
+   };
+
+   /**
+    * Obtain the output statistics of the active sessions.
+    */
+   std::vector<session_stats> get_session_stats() const;
+
+   /**
+    * Set the maximum number of bytes queued for sending to a session. Once
+    * exceeded, var updates are held back and conflated, so only the most
+    * recent value of each variable is sent when the session catches up.
+    * It is expected to be set before the server accepts any session.
+    */
+   void set_max_output_queue_size(std::size_t nbytes)
+   { _max_output_queue_size = nbytes; }
+
+   /**
+    * Set the maximum time a session may remain over its output queue limit
+    * before being disconnected. Zero, the default, means slow sessions are
+    * never disconnected. It is expected to be set before the server
+    * accepts any session.
+    */
+   void set_max_session_lag(const boost::chrono::milliseconds& lag)
+   { _max_session_lag = lag; }
+
 private:
 
+   typedef buffer::linear_buffer output_buffer_type;
+   typedef output_buffer_type::ptr_type output_buffer_ptr;
+
    struct session : logger_component
    {
       typedef buffer::ring_buffer input_buffer_type;
@@ -67,17 +148,115 @@ private:
       input_buffer_ptr input_buffer;
       network::async_tcp_connection_ptr conn;
 
+      /**
+       * The strand that serializes all the handlers of this session. The
+       * IO service may be run by several threads, so different sessions
+       * are attended concurrently while the handlers of the same session
+       * are executed one at a time in the order they were posted.
+       */
+      boost::asio::io_service::strand strand;
+      proto::protocol_version proto_ver;
+      proto::frame_decoder frames;
+
+      /**
+       * The var updates of a priority class.
+       */
+      struct update_class
+      {
+         /**
+          * The var updates notified since the last flush, and the instant
+          * the first of them was notified. They are appended by the
+          * delegate notification thread, so they are protected by
+          * updates_mutex. On flush, they are moved into pending from the
+          * strand of the session. Both lists keep their capacity across
+          * ticks.
+          */
+         std::vector<proto::encoded_var_update> incoming;
+         boost::chrono::steady_clock::time_point incoming_since;
+         std::vector<proto::encoded_var_update> pending;
+         boost::chrono::steady_clock::time_point pending_since;
+
+         /**
+          * Latency statistics, in microseconds. They are updated from the
+          * strand of the session and may be read from any thread.
+          */
+         std::atomic<std::uint64_t> samples;
+         std::atomic<std::uint64_t> total_latency;
+         std::atomic<std::uint64_t> max_latency;
+
+         update_class() : samples(0), total_latency(0), max_latency(0) {}
+      };
+
+      /**
+       * The var updates indexed by subscription priority. Higher classes
+       * are sent first.
+       */
+      update_class updates[subs::SUBSCRIPTION_PRIORITY_COUNT];
+      boost::mutex updates_mutex;
+
+      /**
+       * The instant the output queue exceeded its limit, if it is still
+       * exceeded. Meanwhile, pending updates are held back and conflated.
+       */
+      boost::optional<boost::chrono::steady_clock::time_point> lagging_since;
+
+      /**
+       * The outbound queue. Messages sent while a write is in progress are
+       * appended to output_queue. Once the write completes, all of them
+       * are moved to output_in_flight and written to the connection with
+       * a single gathered write, so there is never more than one write
+       * in flight on the socket.
+       */
+      std::vector<output_buffer_ptr> output_queue;
+      std::vector<output_buffer_ptr> output_in_flight;
+      std::vector<boost::asio::const_buffer> output_regions;
+      std::size_t in_flight_bytes;
+      bool writing;
+
+      /**
+       * Output statistics. They are updated from the strand of the session
+       * and may be read from any thread.
+       */
+      std::atomic<std::size_t> queued_bytes;
+      std::atomic<std::size_t> held_updates;
+      std::atomic<std::uint64_t> dropped_updates;
+
       session(const std::shared_ptr<flight_vars_server>& srv,
               const network::async_tcp_connection_ptr& c)
          : logger_component("server-session"),
            server(srv),
            input_buffer(std::make_shared<input_buffer_type>(64*1024)),
-           conn(c)
+           conn(c),
+           strand(srv->io_service()),
+           proto_ver(0),
+           in_flight_bytes(0),
+           writing(false),
+           queued_bytes(0),
+           held_updates(0),
+           dropped_updates(0)
       {}
 
+      bool supports_var_update_batch() const
+      { return proto_ver >= proto::PROTOCOL_VERSION_VAR_UPDATE_BATCH; }
+
+      bool supports_framing() const
+      { return proto_ver >= proto::PROTOCOL_VERSION_FRAMED; }
+
       ~session();
 
       void unsubscribe_all();
+
+      /**
+       * Append a var update to the incoming updates of its priority class.
+       * It returns true if there were no incoming updates of any class
+       * before, so the session must be marked as dirty.
+       */
+      bool push_update(
+            const proto::encoded_var_update& update,
+            subs::subscription_priority priority);
+
+      update_class& updates_of(subs::subscription_priority priority)
+      { return updates[static_cast<std::size_t>(priority)]; }
    };     
 
    friend struct session;
@@ -85,13 +264,75 @@ private:
    typedef std::shared_ptr<session> session_ptr;
    typedef std::weak_ptr<session> session_wptr;
 
-   typedef buffer::linear_buffer output_buffer_type;
-   typedef output_buffer_type::ptr_type output_buffer_ptr;
+   /**
+    * A session subscribed to a variable. The QoS filter is only accessed
+    * while the subscribers mutex is locked.
+    */
+   struct subscriber
+   {
+      session* target;
+      session_wptr weak_target;
+      subs::qos_filter filter;
+   };
+
+   /**
+    * The sessions subscribed to a variable. The server subscribes to the
+    * delegate once per variable no matter how many sessions are subscribed
+    * to it, and all of them share the same subscription ID. Thus, each
+    * update is converted and encoded only once, and the same encoded
+    * update is copied to every subscribed session.
+    *
+    * Sessions remove themselves from this list on destruction before
+    * releasing any resource, so the target pointer is valid as long as
+    * the subscribers mutex is locked.
+    *
+    * The delegate is requested to subscribe with the subscribers mutex
+    * unlocked. Meanwhile, the entry of the variable is pending: it has no
+    * subscription ID yet, other sessions wait for it to be ready, and the
+    * last update notified by the delegate is kept to be delivered to the
+    * first session once it is registered.
+    *
+    * The maximum polling interval is the lowest one requested by the QoS
+    * of the sessions, or 0 if none requested it. It is only lowered while
+    * the subscription to the delegate lasts.
+    */
+   struct var_subscribers
+   {
+      subscription_id subs_id;
+      bool pending;
+      boost::optional<variable_value> pending_update;
+      std::vector<subscriber> sessions;
+      std::uint32_t max_interval;
+
+      var_subscribers() : subs_id(0), pending(false), max_interval(0) {}
+   };
 
-   typedef std::function<void(void)> after_write_handler;
+   typedef std::unordered_map<
+         variable_id, var_subscribers, variable_id_hash> var_subscribers_map;
 
    std::shared_ptr<flight_vars> _delegate;
    network::async_tcp_server _tcp_server;
+   buffer::buffer_pool<output_buffer_type> _output_buffers;
+   var_subscribers_map _subscribers;
+   boost::mutex _subscribers_mutex;
+   boost::condition_variable _subscribers_ready;
+   boost::mutex _polling_mutex;
+   std::vector<session_wptr> _dirty_sessions;
+   std::vector<session_wptr> _flushing_sessions;
+   boost::mutex _dirty_sessions_mutex;
+   boost::mutex _flush_mutex;
+   std::vector<session_wptr> _sessions;
+   mutable boost::mutex _sessions_mutex;
+   std::size_t _max_output_queue_size;
+   boost::chrono::milliseconds _max_session_lag;
+
+   /**
+    * The number of subscribers with an update deferred by the minimum
+    * interval of their QoS. It is modified while the subscribers mutex is
+    * locked, but read on flush without locking to skip looking for
+    * deferred updates when there are none.
+    */
+   std::atomic<std::size_t> _deferred_updates;
 
    void accept_connection(const network::async_tcp_connection_ptr& conn);
 
@@ -109,6 +350,14 @@ private:
          const session_ptr& session,
          const attempt<std::size_t>& bytes_transferred);
 
+   /**
+    * Process a request received from the client. It returns false if
+    * the session must not attend more requests.
+    */
+   bool process_request(
+         const session_ptr& session,
+         const proto::message& msg);
+
    proto::subscription_reply_message handle_subscription_request(
          const session_ptr& session,
          const proto::subscription_request_message& req);
@@ -117,24 +366,148 @@ private:
          const session_ptr& session,
          const proto::unsubscription_request_message& req);
 
+   /**
+    * Register the session as subscriber of given variable. The delegate
+    * is requested to subscribe to the variable if no other session was
+    * subscribed to it. It returns the subscription ID shared by all the
+    * subscribers of the variable. The updates of the variable are filtered
+    * for this session according to the given QoS, and its maximum polling
+    * interval, if any, is forwarded to the delegate. The delegate is never
+    * invoked with the subscribers mutex locked.
+    */
+   subscription_id register_subscriber(
+         const session_ptr& session,
+         const variable_id& var_id,
+         const subs::subscription_qos& qos)
+   throw (flight_vars::no_such_variable_error);
+
+   /**
+    * Unregister the session as subscriber of given variable. The delegate
+    * is requested to unsubscribe from the variable if no other session
+    * remains subscribed to it.
+    */
+   void unregister_subscriber(
+         const session* session,
+         const variable_id& var_id)
+   throw (flight_vars::no_such_subscription_error);
+
+   /**
+    * Unregister the session as subscriber of all the given variables. The
+    * delegate is requested to unsubscribe at once from the variables which
+    * no other session remains subscribed to.
+    */
+   void unregister_subscribers(
+         const session* session,
+         const std::vector<variable_id>& var_ids);
+
+   /**
+    * Remove the session from the subscribers of the given variable. The
+    * subscribers mutex must be held. If no other session remains subscribed
+    * to the variable, its delegate subscription ID is returned, and the
+    * caller must unsubscribe from the delegate once the mutex is unlocked.
+    */
+   boost::optional<subscription_id> remove_subscriber(
+         const session* session,
+         const variable_id& var_id);
+
+   /**
+    * Lower the maximum polling interval of the given variable to the one
+    * requested by a QoS, if any. The subscribers mutex must be held. It
+    * returns whether the delegate must be requested the new interval.
+    */
+   bool lower_max_interval(
+         var_subscribers& subscribers,
+         const subs::subscription_qos& qos);
+
+   /**
+    * Request the delegate the current maximum polling interval of the
+    * given variable. The subscribers mutex must not be held. The requests
+    * are serialized by their own mutex, and each one takes the interval
+    * when its turn comes, so the last one to reach the delegate carries
+    * the lowest interval.
+    */
+   void request_max_polling_interval(
+         const variable_id& var_id);
+
    void handle_var_update(
-         const session_wptr& session,
          const variable_id& var_id,
          const variable_value& var_value);
 
-   void send_var_update(
-         const session_ptr& session,
-         const variable_id& var_id,
+   /**
+    * Deliver the given update to the subscribers accepting it. The
+    * subscribers mutex must be held.
+    */
+   void dispatch_var_update(
+         var_subscribers& subscribers,
          const variable_value& var_value);
 
-   void write_message(
-         const network::async_tcp_connection_ptr& conn,
-         const proto::message& msg,
-         const after_write_handler& after_write);
+   /**
+    * Deliver the updates deferred by the minimum interval of the QoS of
+    * their subscribers whose interval already elapsed.
+    */
+   void deliver_deferred_updates();
+
+   /**
+    * Append the given update to the incoming updates of the subscriber,
+    * marking its session as dirty if needed. The subscribers mutex must be
+    * locked.
+    */
+   void deliver_update(
+         const subscriber& subs,
+         const proto::encoded_var_update& update);
+
+   void send_pending_var_updates(
+         const session_ptr& session);
+
+   /**
+    * Serialize the pending updates of the session and queue them for
+    * sending, higher priority classes first. It must be invoked from the
+    * strand of the session.
+    */
+   void write_pending_updates(
+         const session_ptr& session);
+
+   /**
+    * Serialize the pending updates of the given priority class of the
+    * session and queue them for sending. It must be invoked from the strand
+    * of the session.
+    */
+   void write_pending_updates(
+         const session_ptr& session,
+         subs::subscription_priority priority);
+
+   bool is_lagging(
+         const session_ptr& session) const
+   { return session->queued_bytes > _max_output_queue_size; }
+
+   /**
+    * Merge the incoming updates of the session into its pending updates.
+    * An incoming update supersedes the last pending update for the same
+    * subscription, if any, when the session lags or the update belongs to
+    * the bulk priority class.
+    */
+   void conflate_updates(
+         const session_ptr& session);
+
 
-   void on_write_message(
-         const output_buffer_ptr& buffer,
-         const after_write_handler& after_write,
+   void send_message(
+         const session_ptr& session,
+         const proto::message& msg);
+
+   /**
+    * Append the given buffer to the outbound queue of the session. If no
+    * write is in progress, the queue is flushed immediately. Otherwise it
+    * will be flushed as soon as the current write completes.
+    */
+   void enqueue_output(
+         const session_ptr& session,
+         const output_buffer_ptr& buff);
+
+   void flush_output(
+         const session_ptr& session);
+
+   void on_output_written(
+         const session_ptr& session,
          const attempt<std::size_t>& bytes_transferred);
 
    void handle_var_update_request(
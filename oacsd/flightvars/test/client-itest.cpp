@@ -38,7 +38,8 @@ struct let_test
 {
    let_test()
       : _io_srv(std::make_shared<boost::asio::io_service>()),
-        _srv_input_buff(1024)
+        _srv_input_buff(1024),
+        _srv_framed(false)
    {
       // Comment in/out this line to enable/disable logging to stderr
       set_main_logger(make_logger(log_level::INFO, file_output_stream::STDERR));
@@ -301,6 +302,7 @@ private:
    std::weak_ptr<network::async_tcp_connection> _server_conn;
    boost::thread _server_thread;
    buffer::ring_buffer _srv_input_buff;
+   bool _srv_framed;
    std::unique_ptr<buffer::linear_buffer> _srv_output_buff;
    server_action _current_srv_action;
    std::unordered_map<
@@ -346,6 +348,7 @@ private:
 
       auto rep = proto::begin_session_message("it-server");
       server_write_message(conn, rep);
+      _srv_framed = true;
    }
 
    void server_receive_close(const network::async_tcp_connection_ptr& conn)
@@ -434,6 +437,9 @@ private:
 
    proto::message server_receive_message()
    {
+      if (_srv_framed)
+         proto::binary_message_deserializer::read_uint16_value(
+               _srv_input_buff);
       return proto::deserialize<proto::binary_message_deserializer>(
             _srv_input_buff);
    }
@@ -454,9 +460,14 @@ private:
          bool request_read = true)
    {
       _srv_output_buff.reset(new buffer::linear_buffer(1024));
-      proto::serialize<proto::binary_message_serializer>(
-            msg,
-            *_srv_output_buff);
+      if (_srv_framed)
+         proto::serialize_frame<proto::binary_message_serializer>(
+               msg,
+               *_srv_output_buff);
+      else
+         proto::serialize<proto::binary_message_serializer>(
+               msg,
+               *_srv_output_buff);
       if (request_read)
          conn->write(
                *_srv_output_buff,
@@ -237,6 +237,27 @@ BOOST_AUTO_TEST_CASE(MustRemoveEntryOnLastvirtualSubscriptionRemoval)
          subscription_db::no_such_master_subscription_error);
 }
 
+BOOST_AUTO_TEST_CASE(MustNotReuseIdOfRemovedvirtualSubscription)
+{
+   subscription_db db;
+   variable_id var_id("foobar", "datum");
+   auto master_subs = make_subscription_id();
+
+   auto virtual_subs1 = db.create_entry(var_id, master_subs, null_handler);
+   auto virtual_subs2 = db.add_virtual_subscription(var_id, null_handler);
+   BOOST_CHECK(!db.remove_virtual_subscription(virtual_subs2));
+   auto virtual_subs3 = db.add_virtual_subscription(var_id, null_handler);
+
+   BOOST_CHECK(virtual_subs2 != virtual_subs3);
+   BOOST_CHECK_THROW(
+         db.remove_virtual_subscription(virtual_subs2),
+         subscription_db::no_such_virtual_subscription_error);
+   BOOST_CHECK_EQUAL(
+         master_subs, db.get_master_subscription_id(virtual_subs1));
+   BOOST_CHECK_EQUAL(
+         master_subs, db.get_master_subscription_id(virtual_subs3));
+}
+
 
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,234 @@
+/*
+ * This file is part of Open Airbus Cockpit
+ * Copyright (C) 2012, 2013 Alvaro Polo
+ *
+ * Open Airbus Cockpit is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Open Airbus Cockpit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Open Airbus Cockpit. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_AUTO_TEST_MAIN
+#include <boost/test/auto_unit_test.hpp>
+
+#include <atomic>
+#include <map>
+
+#include <boost/optional.hpp>
+#include <boost/thread.hpp>
+
+#include <flightvars/core.h>
+
+using namespace oac;
+using namespace oac::fv;
+
+namespace {
+
+/**
+ * A group master which notifies every update received back to the
+ * subscription handler, so the routing of the core is exercised in both
+ * directions.
+ */
+class echo_master : public flight_vars
+{
+public:
+
+   std::atomic<std::size_t> subscriptions;
+   std::atomic<std::size_t> unsubscriptions;
+   std::atomic<std::size_t> updates;
+   boost::optional<std::uint32_t> max_interval;
+
+   echo_master() : subscriptions(0), unsubscriptions(0), updates(0) {}
+
+   virtual subscription_id subscribe(
+         const variable_id& var,
+         const var_update_handler& handler)
+   throw (no_such_variable_error)
+   {
+      auto id = make_subscription_id();
+      boost::unique_lock<boost::mutex> lock(_mutex);
+      _handlers.insert(std::make_pair(id, std::make_pair(var, handler)));
+      subscriptions++;
+      return id;
+   }
+
+   virtual void unsubscribe(
+         const subscription_id& id)
+   throw (no_such_subscription_error)
+   {
+      boost::unique_lock<boost::mutex> lock(_mutex);
+      if (!_handlers.erase(id))
+         OAC_THROW_EXCEPTION(no_such_subscription_error(id));
+      unsubscriptions++;
+   }
+
+   virtual void update(
+         const subscription_id& subs_id,
+         const variable_value& var_value)
+   throw (no_such_subscription_error, illegal_value_error)
+   {
+      boost::unique_lock<boost::mutex> lock(_mutex);
+      auto it = _handlers.find(subs_id);
+      if (it == _handlers.end())
+         OAC_THROW_EXCEPTION(no_such_subscription_error(subs_id));
+      auto entry = it->second;
+      lock.unlock();
+
+      updates++;
+      entry.second(entry.first, var_value);
+   }
+
+   virtual void set_max_polling_interval(
+         const subscription_id& subs_id,
+         const boost::chrono::milliseconds& interval)
+   throw (no_such_subscription_error)
+   {
+      boost::unique_lock<boost::mutex> lock(_mutex);
+      max_interval = std::uint32_t(interval.count());
+   }
+
+private:
+
+   boost::mutex _mutex;
+   std::map<
+         subscription_id,
+         std::pair<variable_id, var_update_handler>> _handlers;
+};
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE(FlightVarsCoreTest)
+
+BOOST_AUTO_TEST_CASE(MustThrowOnRegisteringRepeatedGroupMaster)
+{
+   auto core = flight_vars_core::instance();
+   auto master = std::make_shared<echo_master>();
+   core->register_group_master("core-test/repeated", master);
+   BOOST_CHECK_THROW(
+         core->register_group_master("core-test/repeated", master),
+         flight_vars_core::master_already_registered);
+}
+
+BOOST_AUTO_TEST_CASE(MustThrowOnSubscribingToUnknownGroup)
+{
+   auto core = flight_vars_core::instance();
+   BOOST_CHECK_THROW(
+         core->subscribe(
+               variable_id("core-test/unknown", "foobar"),
+               [](const variable_id&, const variable_value&) {}),
+         flight_vars::no_such_variable_error);
+}
+
+BOOST_AUTO_TEST_CASE(MustThrowOnUnsubscribingUnknownSubscription)
+{
+   auto core = flight_vars_core::instance();
+   BOOST_CHECK_THROW(
+         core->unsubscribe(make_subscription_id()),
+         flight_vars::no_such_subscription_error);
+}
+
+BOOST_AUTO_TEST_CASE(MustUnsubscribeAllFromEachGroupMaster)
+{
+   auto core = flight_vars_core::instance();
+   auto master1 = std::make_shared<echo_master>();
+   auto master2 = std::make_shared<echo_master>();
+   core->register_group_master("core-test/bulk1", master1);
+   core->register_group_master("core-test/bulk2", master2);
+
+   std::size_t notifications = 0;
+   auto handler = [&notifications](const variable_id&, const variable_value&)
+   {
+      notifications++;
+   };
+   flight_vars::subscription_id_list ids;
+   for (int i = 0; i < 3; i++)
+   {
+      ids.push_back(core->subscribe(
+            variable_id("core-test/bulk1", "var"), handler));
+      ids.push_back(core->subscribe(
+            variable_id("core-test/bulk2", "var"), handler));
+   }
+   ids.push_back(make_subscription_id());
+   core->unsubscribe_all(ids);
+
+   BOOST_CHECK_EQUAL(3, master1->unsubscriptions);
+   BOOST_CHECK_EQUAL(3, master2->unsubscriptions);
+   BOOST_CHECK_THROW(
+         core->unsubscribe(ids.front()),
+         flight_vars::no_such_subscription_error);
+   core->update(ids.front(), variable_value::from_byte(1));
+   BOOST_CHECK_EQUAL(0, notifications);
+}
+
+BOOST_AUTO_TEST_CASE(MustRouteMaxPollingIntervalToGroupMaster)
+{
+   auto core = flight_vars_core::instance();
+   auto master = std::make_shared<echo_master>();
+   core->register_group_master("core-test/polling", master);
+   auto subs_id = core->subscribe(
+         variable_id("core-test/polling", "foobar"),
+         [](const variable_id&, const variable_value&) {});
+   core->set_max_polling_interval(subs_id, boost::chrono::milliseconds(250));
+
+   BOOST_REQUIRE(master->max_interval);
+   BOOST_CHECK_EQUAL(250, *master->max_interval);
+   core->unsubscribe(subs_id);
+}
+
+BOOST_AUTO_TEST_CASE(MustRouteUpdatesWhileSubscribingFromManyThreads)
+{
+   const std::size_t NTHREADS = 8;
+   const std::size_t NITERATIONS = 1000;
+
+   auto core = flight_vars_core::instance();
+   auto master = std::make_shared<echo_master>();
+   core->register_group_master("core-test/stress", master);
+
+   std::atomic<std::size_t> notifications(0);
+   std::atomic<std::size_t> errors(0);
+   boost::thread_group threads;
+   for (std::size_t t = 0; t < NTHREADS; t++)
+   {
+      threads.create_thread([&, t]()
+      {
+         variable_id var_id("core-test/stress", format("var-%d", t));
+         for (std::size_t i = 0; i < NITERATIONS; i++)
+         {
+            try
+            {
+               auto subs_id = core->subscribe(
+                     var_id,
+                     [&notifications](
+                           const variable_id&, const variable_value&)
+                     { notifications++; });
+               core->update(subs_id, variable_value::from_dword(i));
+               core->unsubscribe(subs_id);
+
+               // The subscription is not routed anymore
+               core->update(subs_id, variable_value::from_dword(i));
+            }
+            catch (...)
+            {
+               errors++;
+            }
+         }
+      });
+   }
+   threads.join_all();
+
+   BOOST_CHECK_EQUAL(0, errors);
+   BOOST_CHECK_EQUAL(NTHREADS * NITERATIONS, master->subscriptions);
+   BOOST_CHECK_EQUAL(NTHREADS * NITERATIONS, master->unsubscriptions);
+   BOOST_CHECK_EQUAL(NTHREADS * NITERATIONS, master->updates);
+   BOOST_CHECK_EQUAL(NTHREADS * NITERATIONS, notifications);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -19,6 +19,9 @@
 #define BOOST_AUTO_TEST_MAIN
 #include <boost/test/auto_unit_test.hpp>
 
+#include <atomic>
+#include <thread>
+
 #include <liboac/buffer.h>
 
 #include "fsuipc.h"
@@ -327,4 +330,187 @@ BOOST_AUTO_TEST_CASE(MustRemoveSubscriptionWhenOffsetHaveSeveral)
             example_offset_1);
 }
 
+BOOST_AUTO_TEST_CASE(MustCountRemainingSubscriptionsOnRemoval)
+{
+   fsuipc_offset_db db;
+   auto subs1 = db.create_subscription(example_var_1, update_handler);
+   auto subs2 = db.create_subscription(example_var_1, update_handler);
+
+   BOOST_CHECK_EQUAL(1, db.remove_subscription(subs1.get_subscription_id()));
+   BOOST_CHECK(db.is_known_offset(example_offset_1));
+   BOOST_CHECK_EQUAL(0, db.remove_subscription(subs2.get_subscription_id()));
+   BOOST_CHECK(!db.is_known_offset(example_offset_1));
+}
+
+BOOST_AUTO_TEST_CASE(MustThrowOnRemovingUnknownSubscription)
+{
+   fsuipc_offset_db db;
+   BOOST_CHECK_THROW(
+            db.remove_subscription(make_subscription_id()),
+            fsuipc_offset_db::no_such_subscription_error);
+}
+
+BOOST_AUTO_TEST_CASE(MustKeepKnownOffsetsInCreationOrder)
+{
+   fsuipc_offset_db db;
+   std::vector<subscription_id> subs;
+   for (int i = 0; i < 500; i++)
+      subs.push_back(db.create_subscription(
+            variable_id("fsuipc/offset", format("0x%x:1", 0x1000 + i)),
+            update_handler).get_subscription_id());
+   for (int i = 0; i < 500; i += 2)
+      db.remove_subscription(subs[i]);
+
+   BOOST_CHECK_EQUAL(250, db.get_all_offsets().size());
+   std::uint16_t expected = 0x1001;
+   for (auto& offset : db.get_all_offsets())
+   {
+      BOOST_CHECK_EQUAL(expected, offset.address);
+      expected += 2;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+
+BOOST_AUTO_TEST_SUITE(FsuipcFlightVars)
+
+BOOST_AUTO_TEST_CASE(MustStopObservingOffsetsOnUnsubscribeAll)
+{
+   dummy_fsuipc_flight_vars fv;
+   auto handler = [](const variable_id&, const variable_value&) {};
+   flight_vars::subscription_id_list subs;
+   for (int i = 0; i < 500; i++)
+      subs.push_back(fv.subscribe(
+            variable_id("fsuipc/offset", format("0x%x:1", 0x1000 + i)),
+            handler));
+
+   // A second subscription keeps its offset observed
+   auto kept = fv.subscribe(
+         variable_id("fsuipc/offset", "0x1000:1"), handler);
+   subs.push_back(make_subscription_id());
+   fv.unsubscribe_all(subs);
+
+   auto stats = fv.get_polling_stats();
+   BOOST_CHECK_EQUAL(1, stats.hot_offsets + stats.cold_offsets);
+   BOOST_CHECK_THROW(
+         fv.unsubscribe(subs.front()),
+         flight_vars::no_such_subscription_error);
+   fv.unsubscribe(kept);
+   stats = fv.get_polling_stats();
+   BOOST_CHECK_EQUAL(0, stats.hot_offsets + stats.cold_offsets);
+}
+
+BOOST_AUTO_TEST_CASE(MustDerivePollingChecksFromCheckPeriod)
+{
+   dummy_fsuipc_flight_vars fv;
+   auto handler = [](const variable_id&, const variable_value&) {};
+   auto pinned = fv.subscribe(
+         variable_id("fsuipc/offset", "0x1000:1"), handler);
+   fv.subscribe(variable_id("fsuipc/offset", "0x1001:1"), handler);
+   fv.set_max_polling_interval(pinned, boost::chrono::milliseconds(500));
+
+   // At 2 Hz, offsets get cold after 10 checks and they are read once
+   // every 2 checks, so the pinned one is always hot
+   fv.set_check_period(boost::chrono::milliseconds(500));
+   for (int i = 0; i < 12; i++)
+      fv.check_for_updates();
+   auto stats = fv.get_polling_stats();
+   BOOST_CHECK_EQUAL(1, stats.hot_offsets);
+   BOOST_CHECK_EQUAL(1, stats.cold_offsets);
+}
+
+BOOST_AUTO_TEST_CASE(MustNotifyEveryChangeOfSimulatedOffsets)
+{
+   const int NVARS = 500;
+   const int NCHECKS = 60;
+
+   simulated_fsuipc_flight_vars fv;
+   auto& sim = fv.user_adapter();
+   auto tick = boost::chrono::milliseconds(166);
+
+   // Each variable changes on every tick, so each check notifies all of them
+   int notifications = 0;
+   auto handler = [&notifications](const variable_id&, const variable_value&)
+   {
+      notifications++;
+   };
+   for (int i = 0; i < NVARS; i++)
+   {
+      oac::fsuipc::offset offset(
+            oac::fsuipc::offset_address(0x1000 + i * 2),
+            oac::fsuipc::OFFSET_LEN_WORD);
+      sim.add_ramp(offset, 0, 0xffff, 1, tick);
+      fv.subscribe(
+            variable_id("fsuipc/offset", format("0x%x:2", offset.address)),
+            handler);
+   }
+
+   // Simulated time only passes from now on, once per check
+   sim.set_time_step(tick);
+   auto start = boost::chrono::steady_clock::now();
+   for (int i = 0; i < NCHECKS; i++)
+      fv.check_for_updates();
+   auto elapsed = boost::chrono::steady_clock::now() - start;
+
+   BOOST_CHECK_EQUAL(NVARS * NCHECKS, notifications);
+   BOOST_CHECK_EQUAL(NCHECKS, sim.process_count() - NVARS);
+   BOOST_TEST_MESSAGE(
+         notifications << " notifications in " << NCHECKS << " checks took " <<
+         boost::chrono::duration_cast<boost::chrono::microseconds>(
+               elapsed).count() << " us");
+}
+
+BOOST_AUTO_TEST_CASE(MustSerializeSubscriptionsAndUpdatesWithChecks)
+{
+   const int NTHREADS = 4;
+   const int NITERATIONS = 200;
+
+   simulated_fsuipc_flight_vars fv;
+   auto& sim = fv.user_adapter();
+   sim.set_time_step(boost::chrono::milliseconds(166));
+
+   // The handlers are invoked out of the lock, so they may call back
+   std::atomic<int> notifications(0);
+   auto handler = [&fv, &notifications](
+         const variable_id&, const variable_value&)
+   {
+      fv.get_polling_stats();
+      notifications++;
+   };
+
+   std::atomic<bool> done(false);
+   std::vector<std::thread> threads;
+   for (int t = 0; t < NTHREADS; t++)
+   {
+      threads.push_back(std::thread([&fv, &handler, t]()
+      {
+         for (int i = 0; i < NITERATIONS; i++)
+         {
+            auto subs_id = fv.subscribe(
+                  variable_id(
+                        "fsuipc/offset",
+                        format("0x%x:2", 0x1000 + (t * 16 + i % 16) * 2)),
+                  handler);
+            fv.update(subs_id, variable_value::from_word(i));
+            fv.unsubscribe(subs_id);
+         }
+      }));
+   }
+   auto checker = std::thread([&fv, &done]()
+   {
+      while (!done)
+         fv.check_for_updates();
+   });
+   for (auto& thread : threads)
+      thread.join();
+   done = true;
+   checker.join();
+
+   auto stats = fv.get_polling_stats();
+   BOOST_CHECK_EQUAL(0, stats.hot_offsets + stats.cold_offsets);
+   BOOST_TEST_MESSAGE(notifications << " notifications while checking");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
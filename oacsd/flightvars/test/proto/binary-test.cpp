@@ -66,7 +66,7 @@ BOOST_AUTO_TEST_CASE(ShouldSerializeSessionBegin)
    BOOST_CHECK_EQUAL(
             "FlightVars Test", stream::read_as_string(test.buffer, 15));
    BOOST_CHECK_EQUAL(
-            0x0100, big_to_native(stream::read_as<std::uint16_t>(test.buffer)));
+            0x0103, big_to_native(stream::read_as<std::uint16_t>(test.buffer)));
    BOOST_CHECK_EQUAL(
             0x0d0a, big_to_native(stream::read_as<std::uint16_t>(test.buffer)));
    BOOST_CHECK(test.input_eof());
@@ -159,6 +159,100 @@ BOOST_AUTO_TEST_CASE(ShouldDeserializeSubscriptionRequest)
 
    BOOST_CHECK_EQUAL("fsuipc/offset", sr_msg.var_grp);
    BOOST_CHECK_EQUAL("0x4ca1", sr_msg.var_name);
+   BOOST_CHECK(!sr_msg.qos);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldSerializeSubscriptionRequestWithQoS)
+{
+   protocol_test<binary_message_serializer, binary_message_deserializer> test;
+
+   subscription_request_message msg(
+            variable_group("fsuipc/offset"),
+            variable_name("0x4ca1"),
+            subs::subscription_qos(
+                  250,
+                  subs::deadband_kind::RELATIVE_DELTA,
+                  0.5f,
+                  subs::subscription_priority::CRITICAL,
+                  1000));
+   test.serialize(msg);
+
+   BOOST_CHECK_EQUAL(
+            0x708, big_to_native(stream::read_as<std::uint16_t>(test.buffer)));
+   BOOST_CHECK_EQUAL(
+            13, big_to_native(stream::read_as<std::uint16_t>(test.buffer)));
+   BOOST_CHECK_EQUAL(
+            "fsuipc/offset", stream::read_as_string(test.buffer, 13));
+   BOOST_CHECK_EQUAL(
+            6, big_to_native(stream::read_as<std::uint16_t>(test.buffer)));
+   BOOST_CHECK_EQUAL(
+            "0x4ca1", stream::read_as_string(test.buffer, 6));
+   BOOST_CHECK_EQUAL(
+            250, big_to_native(stream::read_as<std::uint32_t>(test.buffer)));
+   BOOST_CHECK_EQUAL(
+            2, stream::read_as<std::uint8_t>(test.buffer));
+   BOOST_CHECK_EQUAL(
+            0, // the binary significant of 0.5
+            big_to_native(stream::read_as<std::uint32_t>(test.buffer)));
+   BOOST_CHECK_EQUAL(
+            0, // the integral exponent
+            big_to_native(stream::read_as<std::uint32_t>(test.buffer)));
+   BOOST_CHECK_EQUAL(
+            0, stream::read_as<std::uint8_t>(test.buffer));
+   BOOST_CHECK_EQUAL(
+            1000, big_to_native(stream::read_as<std::uint32_t>(test.buffer)));
+   BOOST_CHECK_EQUAL(
+            0x0d0a, big_to_native(stream::read_as<std::uint16_t>(test.buffer)));
+   BOOST_CHECK(test.input_eof());
+}
+
+BOOST_AUTO_TEST_CASE(ShouldDeserializeSubscriptionRequestWithQoS)
+{
+   protocol_test<binary_message_serializer, binary_message_deserializer> test;
+
+   stream::write_as(test.buffer, native_to_big<std::uint16_t>(0x708));
+   stream::write_as(test.buffer, native_to_big<std::uint16_t>(13));
+   stream::write_as_string(test.buffer,"fsuipc/offset");
+   stream::write_as(test.buffer, native_to_big<std::uint16_t>(6));
+   stream::write_as_string(test.buffer,"0x4ca1");
+   stream::write_as(test.buffer, native_to_big<std::uint32_t>(250));
+   stream::write_as(test.buffer, std::uint8_t(1));
+   stream::write_as(test.buffer, native_to_big<std::uint32_t>(0));
+   stream::write_as(test.buffer, native_to_big<std::uint32_t>(0));
+   stream::write_as(test.buffer, std::uint8_t(2));
+   stream::write_as(test.buffer, native_to_big<std::uint32_t>(1000));
+   stream::write_as(test.buffer, native_to_big<std::uint16_t>(0x0d0a));
+   message msg = test.deserialize();
+   subscription_request_message& sr_msg =
+         boost::get<subscription_request_message>(msg);
+
+   BOOST_CHECK_EQUAL("fsuipc/offset", sr_msg.var_grp);
+   BOOST_CHECK_EQUAL("0x4ca1", sr_msg.var_name);
+   BOOST_REQUIRE(sr_msg.qos);
+   BOOST_CHECK_EQUAL(250, sr_msg.qos->min_interval);
+   BOOST_CHECK(subs::deadband_kind::ABSOLUTE_DELTA == sr_msg.qos->deadband_type);
+   BOOST_CHECK_CLOSE(0.5f, sr_msg.qos->deadband, 0.001f);
+   BOOST_CHECK(subs::subscription_priority::BULK == sr_msg.qos->priority);
+   BOOST_CHECK_EQUAL(1000, sr_msg.qos->max_interval);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldThrowOnSubscriptionRequestWithInvalidPriority)
+{
+   protocol_test<binary_message_serializer, binary_message_deserializer> test;
+
+   stream::write_as(test.buffer, native_to_big<std::uint16_t>(0x708));
+   stream::write_as(test.buffer, native_to_big<std::uint16_t>(13));
+   stream::write_as_string(test.buffer,"fsuipc/offset");
+   stream::write_as(test.buffer, native_to_big<std::uint16_t>(6));
+   stream::write_as_string(test.buffer,"0x4ca1");
+   stream::write_as(test.buffer, native_to_big<std::uint32_t>(250));
+   stream::write_as(test.buffer, std::uint8_t(0));
+   stream::write_as(test.buffer, native_to_big<std::uint32_t>(0));
+   stream::write_as(test.buffer, native_to_big<std::uint32_t>(0));
+   stream::write_as(test.buffer, std::uint8_t(7));
+   stream::write_as(test.buffer, native_to_big<std::uint32_t>(0));
+   stream::write_as(test.buffer, native_to_big<std::uint16_t>(0x0d0a));
+   BOOST_CHECK_THROW(test.deserialize(), invalid_qos_code);
 }
 
 BOOST_AUTO_TEST_CASE(ShouldSerializeSubscriptionReply)
@@ -498,4 +592,64 @@ BOOST_AUTO_TEST_CASE(ShouldDeserializeFloatVarUpdate)
    BOOST_CHECK_CLOSE(3.1416f, vu_msg.var_value.as_float(), 0.001f);
 }
 
+BOOST_AUTO_TEST_CASE(ShouldSerializeVarUpdateBatch)
+{
+   protocol_test<binary_message_serializer, binary_message_deserializer> test;
+
+   var_update_batch_message msg;
+   msg.updates.push_back(
+         var_update_message(0x1234, variable_value::from_byte(0x45)));
+   msg.updates.push_back(
+         var_update_message(0x5678, variable_value::from_word(0x4567)));
+   test.serialize(msg);
+
+   BOOST_CHECK_EQUAL(
+            0x707, big_to_native(stream::read_as<std::uint16_t>(test.buffer)));
+   BOOST_CHECK_EQUAL(
+            2, big_to_native(stream::read_as<std::uint16_t>(test.buffer)));
+   BOOST_CHECK_EQUAL(
+            0x1234, big_to_native(stream::read_as<std::uint32_t>(test.buffer)));
+   BOOST_CHECK_EQUAL(
+            1, stream::read_as<std::uint8_t>(test.buffer));
+   BOOST_CHECK_EQUAL(
+            0x45, stream::read_as<std::uint8_t>(test.buffer));
+   BOOST_CHECK_EQUAL(
+            0x5678, big_to_native(stream::read_as<std::uint32_t>(test.buffer)));
+   BOOST_CHECK_EQUAL(
+            2, stream::read_as<std::uint8_t>(test.buffer));
+   BOOST_CHECK_EQUAL(
+            0x4567, big_to_native(stream::read_as<std::uint16_t>(test.buffer)));
+   BOOST_CHECK_EQUAL(
+            0x0d0a, big_to_native(stream::read_as<std::uint16_t>(test.buffer)));
+   BOOST_CHECK(test.input_eof());
+}
+
+BOOST_AUTO_TEST_CASE(ShouldDeserializeVarUpdateBatch)
+{
+   protocol_test<binary_message_serializer, binary_message_deserializer> test;
+
+   stream::write_as(test.buffer, native_to_big<std::uint16_t>(0x707));
+   stream::write_as(test.buffer, native_to_big<std::uint16_t>(2));
+   stream::write_as(test.buffer, native_to_big<std::uint32_t>(0x1234));
+   stream::write_as(test.buffer, std::uint8_t(0));
+   stream::write_as(test.buffer, std::uint8_t(1));
+   stream::write_as(test.buffer, native_to_big<std::uint32_t>(0x5678));
+   stream::write_as(test.buffer, std::uint8_t(3));
+   stream::write_as(test.buffer, native_to_big<std::uint32_t>(0x23456789));
+   stream::write_as(test.buffer, native_to_big<std::uint16_t>(0x0d0a));
+   message msg = test.deserialize();
+   var_update_batch_message& vub_msg =
+         boost::get<var_update_batch_message>(msg);
+
+   BOOST_CHECK_EQUAL(2, vub_msg.updates.size());
+   BOOST_CHECK_EQUAL(0x1234, vub_msg.updates[0].subs_id);
+   BOOST_CHECK_EQUAL(
+         variable_type::BOOLEAN, vub_msg.updates[0].var_value.get_type());
+   BOOST_CHECK(vub_msg.updates[0].var_value.as_bool());
+   BOOST_CHECK_EQUAL(0x5678, vub_msg.updates[1].subs_id);
+   BOOST_CHECK_EQUAL(
+         variable_type::DWORD, vub_msg.updates[1].var_value.get_type());
+   BOOST_CHECK_EQUAL(0x23456789, vub_msg.updates[1].var_value.as_dword());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,116 @@
+/*
+ * This file is part of Open Airbus Cockpit
+ * Copyright (C) 2012, 2013 Alvaro Polo
+ *
+ * Open Airbus Cockpit is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Open Airbus Cockpit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Open Airbus Cockpit. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_AUTO_TEST_MAIN
+#include <boost/test/auto_unit_test.hpp>
+
+#include <vector>
+
+#include <liboac/buffer.h>
+#include <liboac/stream.h>
+
+#include <flightvars/protocol.h>
+
+using namespace oac;
+using namespace oac::fv;
+using namespace oac::fv::proto;
+
+namespace {
+
+std::string
+contents_of(buffer::linear_buffer& buff)
+{
+   return stream::read_as_string(buff, buff.available_for_read());
+}
+
+struct encoded_var_update_writer
+{
+   const encoded_var_update& update;
+
+   encoded_var_update_writer(const encoded_var_update& u) : update(u) {}
+
+   template <typename OutputStream>
+   void operator()(OutputStream& output) const
+   {
+      serialize_encoded_var_update<binary_message_serializer>(update, output);
+   }
+};
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE(EncodedVarUpdateTest)
+
+BOOST_AUTO_TEST_CASE(ShouldSerializeAsVarUpdate)
+{
+   buffer::linear_buffer expected(1024), actual(1024);
+   auto value = variable_value::from_dword(0xabcd1234);
+
+   serialize<binary_message_serializer>(
+         var_update_message(0x1234, value), expected);
+   serialize_encoded_var_update<binary_message_serializer>(
+         encode_var_update<binary_message_serializer>(0x1234, value),
+         actual);
+
+   BOOST_CHECK_EQUAL(contents_of(expected), contents_of(actual));
+}
+
+BOOST_AUTO_TEST_CASE(ShouldKeepSubscriptionId)
+{
+   auto update = encode_var_update<binary_message_serializer>(
+         0x1234, variable_value::from_word(1200));
+   BOOST_CHECK_EQUAL(0x1234, update.subs_id());
+}
+
+BOOST_AUTO_TEST_CASE(ShouldSerializeAsVarUpdateBatch)
+{
+   buffer::linear_buffer expected(1024), actual(1024);
+   var_update_batch_message batch;
+   std::vector<encoded_var_update> updates;
+
+   batch.updates.push_back(
+         var_update_message(1, variable_value::from_bool(true)));
+   batch.updates.push_back(
+         var_update_message(2, variable_value::from_word(1200)));
+   batch.updates.push_back(
+         var_update_message(3, variable_value::from_float(3.1416f)));
+   for (auto& update : batch.updates)
+      updates.push_back(encode_var_update<binary_message_serializer>(
+            update.subs_id, update.var_value));
+
+   serialize<binary_message_serializer>(batch, expected);
+   serialize_encoded_var_update_batch<binary_message_serializer>(
+         updates.begin(), updates.end(), actual);
+
+   BOOST_CHECK_EQUAL(contents_of(expected), contents_of(actual));
+}
+
+BOOST_AUTO_TEST_CASE(ShouldSerializeAsVarUpdateFrame)
+{
+   buffer::linear_buffer expected(1024), actual(1024);
+   auto value = variable_value::from_byte(65);
+   auto update = encode_var_update<binary_message_serializer>(0x1234, value);
+
+   serialize_frame<binary_message_serializer>(
+         var_update_message(0x1234, value), expected);
+   serialize_frame_with<binary_message_serializer>(
+         encoded_var_update_writer(update), actual);
+
+   BOOST_CHECK_EQUAL(contents_of(expected), contents_of(actual));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,158 @@
+/*
+ * This file is part of Open Airbus Cockpit
+ * Copyright (C) 2012, 2013 Alvaro Polo
+ *
+ * Open Airbus Cockpit is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Open Airbus Cockpit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Open Airbus Cockpit. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_AUTO_TEST_MAIN
+#include <boost/test/auto_unit_test.hpp>
+
+#include <vector>
+
+#include <liboac/buffer.h>
+#include <liboac/endian.h>
+#include <liboac/stream.h>
+
+#include <flightvars/protocol.h>
+
+using namespace oac;
+using namespace oac::fv;
+using namespace oac::fv::proto;
+
+BOOST_AUTO_TEST_SUITE(FrameTest)
+
+BOOST_AUTO_TEST_CASE(ShouldSerializeFrame)
+{
+   buffer::linear_buffer buff(1024);
+
+   unsubscription_request_message msg(0x1234);
+   serialize_frame<binary_message_serializer>(msg, buff);
+
+   BOOST_CHECK_EQUAL(
+            8, big_to_native(stream::read_as<std::uint16_t>(buff)));
+   BOOST_CHECK_EQUAL(
+            0x704, big_to_native(stream::read_as<std::uint16_t>(buff)));
+   BOOST_CHECK_EQUAL(
+            0x1234, big_to_native(stream::read_as<std::uint32_t>(buff)));
+   BOOST_CHECK_EQUAL(
+            0x0d0a, big_to_native(stream::read_as<std::uint16_t>(buff)));
+   BOOST_CHECK(!buff.available_for_read());
+}
+
+BOOST_AUTO_TEST_CASE(ShouldDecodeFrameOnlyWhenComplete)
+{
+   buffer::ring_buffer buff(1024);
+   frame_decoder decoder;
+
+   BOOST_CHECK(!decoder.frame_ready<binary_message_deserializer>(buff));
+
+   stream::write_as(buff, std::uint8_t(0));
+   BOOST_CHECK(!decoder.frame_ready<binary_message_deserializer>(buff));
+
+   stream::write_as(buff, std::uint8_t(8));
+   stream::write_as(buff, native_to_big<std::uint16_t>(0x704));
+   BOOST_CHECK(!decoder.frame_ready<binary_message_deserializer>(buff));
+
+   stream::write_as(buff, native_to_big<std::uint32_t>(0x1234));
+   BOOST_CHECK(!decoder.frame_ready<binary_message_deserializer>(buff));
+
+   stream::write_as(buff, native_to_big<std::uint16_t>(0x0d0a));
+   BOOST_CHECK(decoder.frame_ready<binary_message_deserializer>(buff));
+
+   auto msg = decoder.decode<binary_message_deserializer>(buff);
+   auto& us_msg = boost::get<unsubscription_request_message>(msg);
+   BOOST_CHECK_EQUAL(0x1234, us_msg.subs_id);
+   BOOST_CHECK(!buff.available_for_read());
+}
+
+BOOST_AUTO_TEST_CASE(ShouldDecodeSeveralFramesAtOnce)
+{
+   buffer::ring_buffer buff(1024);
+   frame_decoder decoder;
+
+   serialize_frame<binary_message_serializer>(
+         unsubscription_request_message(0x1234), buff);
+   serialize_frame<binary_message_serializer>(
+         end_session_message("Bye!"), buff);
+
+   BOOST_CHECK(decoder.frame_ready<binary_message_deserializer>(buff));
+   auto msg1 = decoder.decode<binary_message_deserializer>(buff);
+   BOOST_CHECK_EQUAL(
+         0x1234,
+         boost::get<unsubscription_request_message>(msg1).subs_id);
+
+   BOOST_CHECK(decoder.frame_ready<binary_message_deserializer>(buff));
+   auto msg2 = decoder.decode<binary_message_deserializer>(buff);
+   BOOST_CHECK_EQUAL("Bye!", boost::get<end_session_message>(msg2).cause);
+
+   BOOST_CHECK(!decoder.frame_ready<binary_message_deserializer>(buff));
+}
+
+BOOST_AUTO_TEST_CASE(ShouldDecodeFrameInPlaceWhenNotContiguous)
+{
+   buffer::ring_buffer buff(16);
+   frame_decoder decoder;
+
+   // Move the read and write positions near the end of the buffer
+   stream::write_as<std::uint64_t>(buff, 0);
+   stream::write_as<std::uint32_t>(buff, 0);
+   stream::read_as<std::uint64_t>(buff);
+   stream::read_as<std::uint32_t>(buff);
+
+   serialize_frame<binary_message_serializer>(
+         var_update_message(0x1234, variable_value::from_word(0x4567)), buff);
+
+   std::vector<var_update_message> updates;
+   struct visitor
+   {
+      std::vector<var_update_message>& updates;
+
+      void operator()(const var_update_message& msg)
+      { updates.push_back(msg); }
+
+      void operator()(const subscription_reply_view&)
+      { BOOST_FAIL("unexpected subscription reply"); }
+
+      void operator()(const message&)
+      { BOOST_FAIL("unexpected message"); }
+   } v = { updates };
+
+   BOOST_CHECK(decoder.frame_ready<binary_message_deserializer>(buff));
+   decoder.decode_in_place(buff, v);
+
+   BOOST_CHECK_EQUAL(1, updates.size());
+   BOOST_CHECK_EQUAL(0x1234, updates[0].subs_id);
+   BOOST_CHECK_EQUAL(0x4567, updates[0].var_value.as_word());
+   BOOST_CHECK(!buff.available_for_read());
+}
+
+BOOST_AUTO_TEST_CASE(ShouldFailToDecodeFrameWithWrongLength)
+{
+   buffer::ring_buffer buff(1024);
+   frame_decoder decoder;
+
+   stream::write_as(buff, native_to_big<std::uint16_t>(10));
+   stream::write_as(buff, native_to_big<std::uint16_t>(0x704));
+   stream::write_as(buff, native_to_big<std::uint32_t>(0x1234));
+   stream::write_as(buff, native_to_big<std::uint16_t>(0x0d0a));
+   stream::write_as(buff, native_to_big<std::uint16_t>(0x0000));
+
+   BOOST_CHECK(decoder.frame_ready<binary_message_deserializer>(buff));
+   BOOST_CHECK_THROW(
+         decoder.decode<binary_message_deserializer>(buff),
+         frame_length_mismatch);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,149 @@
+/*
+ * This file is part of Open Airbus Cockpit
+ * Copyright (C) 2012, 2013 Alvaro Polo
+ *
+ * Open Airbus Cockpit is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Open Airbus Cockpit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Open Airbus Cockpit. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_AUTO_TEST_MAIN
+#include <boost/test/auto_unit_test.hpp>
+
+#include <vector>
+
+#include <liboac/buffer.h>
+
+#include <flightvars/protocol.h>
+
+using namespace oac;
+using namespace oac::fv;
+using namespace oac::fv::proto;
+
+struct view_test
+{
+   buffer::linear_buffer buffer;
+   std::vector<var_update_message> var_updates;
+   std::vector<subscription_reply_message> subscription_replies;
+   std::vector<message> messages;
+
+   view_test() : buffer(1024) {}
+
+   void serialize(const message& msg)
+   { proto::serialize<binary_message_serializer>(msg, buffer); }
+
+   void deserialize_in_place()
+   {
+      region_input_stream input(buffer.read_region());
+      proto::deserialize_in_place(input, *this);
+      BOOST_CHECK(!input.available_for_read());
+   }
+
+   void operator()(const var_update_message& msg)
+   { var_updates.push_back(msg); }
+
+   void operator()(const subscription_reply_view& view)
+   { subscription_replies.push_back(view.to_message()); }
+
+   void operator()(const message& msg)
+   { messages.push_back(msg); }
+};
+
+BOOST_AUTO_TEST_SUITE(ViewDeserializerTest)
+
+BOOST_AUTO_TEST_CASE(ShouldReadFieldsInPlace)
+{
+   buffer::linear_buffer buff(1024);
+   binary_message_serializer::write_uint8_value(buff, 0x12);
+   binary_message_serializer::write_uint16_value(buff, 0x3456);
+   binary_message_serializer::write_uint32_value(buff, 0x789abcde);
+   binary_message_serializer::write_string_value(buff, "Hello");
+   binary_message_serializer::write_float_value(buff, 3.1416f);
+
+   region_input_stream input(buff.read_region());
+   BOOST_CHECK_EQUAL(0x12, binary_view_deserializer::read_uint8_value(input));
+   BOOST_CHECK_EQUAL(
+         0x3456, binary_view_deserializer::read_uint16_value(input));
+   BOOST_CHECK_EQUAL(
+         0x789abcde, binary_view_deserializer::read_uint32_value(input));
+   BOOST_CHECK_EQUAL(
+         "Hello", binary_view_deserializer::read_string_view(input));
+   BOOST_CHECK_CLOSE(
+         3.1416f, binary_view_deserializer::read_float_value(input), 0.001f);
+   BOOST_CHECK(!input.available_for_read());
+}
+
+BOOST_AUTO_TEST_CASE(ShouldFailToReadBeyondRegion)
+{
+   buffer::linear_buffer buff(1024);
+   binary_message_serializer::write_uint16_value(buff, 0x3456);
+
+   region_input_stream input(buff.read_region());
+   BOOST_CHECK_THROW(
+         binary_view_deserializer::read_uint32_value(input),
+         io::eof_error);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldDeserializeVarUpdateBatchInPlace)
+{
+   view_test test;
+   var_update_batch_message msg;
+   msg.updates.push_back(
+         var_update_message(0x1234, variable_value::from_byte(0x45)));
+   msg.updates.push_back(
+         var_update_message(0x5678, variable_value::from_dword(0x23456789)));
+   test.serialize(msg);
+   test.deserialize_in_place();
+
+   BOOST_CHECK_EQUAL(2, test.var_updates.size());
+   BOOST_CHECK_EQUAL(0x1234, test.var_updates[0].subs_id);
+   BOOST_CHECK_EQUAL(0x45, test.var_updates[0].var_value.as_byte());
+   BOOST_CHECK_EQUAL(0x5678, test.var_updates[1].subs_id);
+   BOOST_CHECK_EQUAL(0x23456789, test.var_updates[1].var_value.as_dword());
+   BOOST_CHECK(test.messages.empty());
+}
+
+BOOST_AUTO_TEST_CASE(ShouldDeserializeSubscriptionReplyInPlace)
+{
+   view_test test;
+   test.serialize(
+         subscription_reply_message(
+               subscription_status::SUBSCRIBED,
+               "fsuipc/offset",
+               "0x700:4",
+               0x1234,
+               "Subscribed"));
+   test.deserialize_in_place();
+
+   BOOST_CHECK_EQUAL(1, test.subscription_replies.size());
+   auto& rep = test.subscription_replies[0];
+   BOOST_CHECK_EQUAL(subscription_status::SUBSCRIBED, rep.st);
+   BOOST_CHECK_EQUAL("fsuipc/offset", rep.var_grp);
+   BOOST_CHECK_EQUAL("0x700:4", rep.var_name);
+   BOOST_CHECK_EQUAL(0x1234, rep.subs_id);
+   BOOST_CHECK_EQUAL("Subscribed", rep.cause);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldDeserializeOtherMessagesAsMessageObjects)
+{
+   view_test test;
+   test.serialize(unsubscription_request_message(0x1234));
+   test.deserialize_in_place();
+
+   BOOST_CHECK_EQUAL(1, test.messages.size());
+   BOOST_CHECK_EQUAL(
+         0x1234,
+         boost::get<unsubscription_request_message>(
+               test.messages[0]).subs_id);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
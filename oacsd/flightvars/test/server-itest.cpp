@@ -20,6 +20,7 @@
 #include <boost/test/auto_unit_test.hpp>
 
 #include <cstdlib>
+#include <deque>
 
 #include <liboac/network.h>
 
@@ -45,6 +46,7 @@ struct let_test
       set_main_logger(make_logger(log_level::INFO, file_output_stream::STDERR));
 
       _io_service = std::make_shared<boost::asio::io_service>();
+      _proto_ver = 0;
 
       // A random port between 1025 and 7025 ensures socket is not occupied
       // by a previous test
@@ -80,15 +82,18 @@ struct let_test
       return *this;
    }
 
-   let_test& handshake()
+   let_test& handshake(
+         proto::protocol_version proto_ver = FLIGHTVARS_PROTOCOL_VERSION)
    {
-      proto::message open_req = proto::begin_session_message("Test Client");
+      proto::message open_req = proto::begin_session_message(
+            "Test Client", proto_ver);
       send_message_as(open_req);
 
       auto open_rep = receive_message_as<proto::begin_session_message>();
 
       BOOST_CHECK_EQUAL(flight_vars_server::PEER_NAME, open_rep.pname);
-      BOOST_CHECK_EQUAL(FLIGHTVARS_PROTOCOL_VERSION, open_rep.proto_ver);
+      BOOST_CHECK_EQUAL(proto_ver, open_rep.proto_ver);
+      _proto_ver = open_rep.proto_ver;
 
       return *this;
    }
@@ -121,13 +126,14 @@ struct let_test
          const variable_group& var_group_tag,
          const variable_name& var_name_tag,
          proto::subscription_status expected_subs_status =
-               proto::subscription_status::SUBSCRIBED)
+               proto::subscription_status::SUBSCRIBED,
+         const boost::optional<subs::subscription_qos>& qos = boost::none)
    {
       auto var_group = variable_group(var_group_tag);
       auto var_name = variable_name(var_name_tag);
       variable_id var_id(var_group, var_name);
 
-      auto req = proto::subscription_request_message(var_group, var_name);
+      auto req = proto::subscription_request_message(var_group, var_name, qos);
       send_message_as(req);
 
       auto rep = receive_message_as<proto::subscription_reply_message>();
@@ -141,6 +147,35 @@ struct let_test
       return *this;
    }
 
+   let_test& subscribe_with_priority(
+         const variable_group& var_group_tag,
+         const variable_name& var_name_tag,
+         subs::subscription_priority priority)
+   {
+      return subscribe(
+            var_group_tag,
+            var_name_tag,
+            proto::subscription_status::SUBSCRIBED,
+            subs::subscription_qos(0, subs::deadband_kind::NONE, 0.0f, priority));
+   }
+
+   let_test& subscribe_with_max_interval(
+         const variable_group& var_group_tag,
+         const variable_name& var_name_tag,
+         std::uint32_t max_interval)
+   {
+      return subscribe(
+            var_group_tag,
+            var_name_tag,
+            proto::subscription_status::SUBSCRIBED,
+            subs::subscription_qos(
+                  0,
+                  subs::deadband_kind::NONE,
+                  0.0f,
+                  subs::subscription_priority::NORMAL,
+                  max_interval));
+   }
+
    let_test& unsubscribe(
          subscription_id subs_id,
          bool expect_success = true)
@@ -182,7 +217,7 @@ struct let_test
          const variable_value& value)
    {
       variable_id var_id(var_group_tag, var_name_tag);
-      auto rep = receive_message_as<proto::var_update_message>();
+      auto rep = receive_next_var_update();
       auto expected_subs_id = _subscriptions[var_id];
 
       BOOST_CHECK_EQUAL(expected_subs_id, rep.subs_id);
@@ -229,10 +264,52 @@ struct let_test
       return *this;
    }
 
-   let_test& fsuipc_polls_for_changes()
+   let_test& check_session_stats(std::size_t nsessions)
+   {
+      // Have to wait a little while to let the server write its replies
+      sleep(50);
+
+      auto stats = _server->get_session_stats();
+      BOOST_CHECK_EQUAL(nsessions, stats.size());
+      for (auto& session : stats)
+      {
+         BOOST_CHECK_EQUAL(0, session.queue_depth);
+         BOOST_CHECK_EQUAL(0, session.held_updates);
+         BOOST_CHECK_EQUAL(0, session.dropped_updates);
+      }
+      return *this;
+   }
+
+   let_test& fsuipc_polls_for_changes(int times = 1)
+   {
+      // The flush must follow the check for updates, as the tick observer
+      // does, so it is posted to the single thread of the IO service
+      for (int i = 0; i < times; i++)
+      {
+         _io_service->dispatch(std::bind(
+               &dummy_fsuipc_flight_vars::check_for_updates, _fsuipc));
+         _io_service->post(
+               std::bind(&flight_vars_server::flush_var_updates, _server));
+      }
+      return *this;
+   }
+
+   let_test& fsuipc_checks_every(unsigned int millis)
    {
-      _io_service->dispatch(
-            std::bind(&dummy_fsuipc_flight_vars::check_for_updates, _fsuipc));
+      _fsuipc->set_check_period(boost::chrono::milliseconds(millis));
+      return *this;
+   }
+
+   let_test& assert_polling_stats(
+         std::size_t hot_offsets,
+         std::size_t cold_offsets)
+   {
+      // Have to wait a little while to let the server poll for changes
+      sleep(50);
+
+      auto stats = _fsuipc->get_polling_stats();
+      BOOST_CHECK_EQUAL(hot_offsets, stats.hot_offsets);
+      BOOST_CHECK_EQUAL(cold_offsets, stats.cold_offsets);
       return *this;
    }
 
@@ -267,13 +344,21 @@ private:
    flight_vars_server_ptr _server;
    boost::thread _server_thread;
    std::shared_ptr<network::tcp_client> _client;
+   proto::protocol_version _proto_ver;
    std::unordered_map<
          variable_id,
          subscription_id,
          variable_id_hash> _subscriptions;
+   std::deque<proto::var_update_message> _pending_var_updates;
+
+   bool is_framed() const
+   { return _proto_ver >= proto::PROTOCOL_VERSION_FRAMED; }
 
    proto::message receive_message()
    {
+      if (is_framed())
+         proto::binary_message_deserializer::read_uint16_value(
+               *_client->input());
       return proto::deserialize<proto::binary_message_deserializer>(
             *_client->input());
    }
@@ -287,11 +372,40 @@ private:
       return *casted_msg;
    }
 
+   proto::var_update_message receive_next_var_update()
+   {
+      if (_pending_var_updates.empty())
+      {
+         auto msg = receive_message();
+         if (auto vub_msg = boost::get<proto::var_update_batch_message>(&msg))
+         {
+            BOOST_CHECK(!vub_msg->updates.empty());
+            _pending_var_updates.insert(
+                  _pending_var_updates.end(),
+                  vub_msg->updates.begin(),
+                  vub_msg->updates.end());
+         }
+         else
+         {
+            auto vu_msg = boost::get<proto::var_update_message>(&msg);
+            BOOST_CHECK(vu_msg != nullptr);
+            _pending_var_updates.push_back(*vu_msg);
+         }
+      }
+      auto result = _pending_var_updates.front();
+      _pending_var_updates.pop_front();
+      return result;
+   }
+
    template <typename MessageType>
    void send_message_as(const MessageType& msg)
    {
-      proto::serialize<proto::binary_message_serializer>(
-            msg, *_client->output());
+      if (is_framed())
+         proto::serialize_frame<proto::binary_message_serializer>(
+               msg, *_client->output());
+      else
+         proto::serialize<proto::binary_message_serializer>(
+               msg, *_client->output());
    }
 
    void assert_connection_is_closed()
@@ -341,6 +455,16 @@ BOOST_AUTO_TEST_CASE(MustHandshake)
          .disconnect();
 }
 
+BOOST_AUTO_TEST_CASE(MustExposeSessionStats)
+{
+   let_test()
+         .connect()
+         .handshake()
+         .subscribe("fsuipc/offset", "0x700:4")
+         .check_session_stats(1)
+         .disconnect();
+}
+
 BOOST_AUTO_TEST_CASE(MustDisconnectOnInvalidMessageReceivedBeforeHandshake)
 {
    let_test()
@@ -471,6 +595,66 @@ BOOST_AUTO_TEST_CASE(MustNotifyVarUpdates)
          .disconnect();
 }
 
+BOOST_AUTO_TEST_CASE(MustNotifyCriticalVarUpdatesFirst)
+{
+   let_test()
+         .connect()
+         .handshake()
+         .subscribe_with_priority(
+               "fsuipc/offset", "0x700:4", subs::subscription_priority::BULK)
+         .subscribe_with_priority(
+               "fsuipc/offset", "0x800:1", subs::subscription_priority::CRITICAL)
+         .on_offset_change(0x700, oac::fsuipc::OFFSET_LEN_DWORD, 0x0a0b0c0d)
+         .on_offset_change(0x800, oac::fsuipc::OFFSET_LEN_BYTE, 0xab)
+         .fsuipc_polls_for_changes()
+         .receive_var_update(
+               "fsuipc/offset",
+               "0x800:1",
+               variable_value::from_byte(0xab))
+         .receive_var_update(
+               "fsuipc/offset",
+               "0x700:4",
+               variable_value::from_dword(0x0a0b0c0d))
+         .disconnect();
+}
+
+BOOST_AUTO_TEST_CASE(MustPinPollingIntervalRequestedByQoS)
+{
+   // At 2 Hz, offsets get cold after 10 checks and they are read once
+   // every 2 checks, so the pinned one is always hot
+   let_test()
+         .connect()
+         .handshake()
+         .fsuipc_checks_every(500)
+         .subscribe_with_max_interval("fsuipc/offset", "0x700:4", 500)
+         .subscribe("fsuipc/offset", "0x800:1")
+         .fsuipc_polls_for_changes(12)
+         .assert_polling_stats(1, 1)
+         .disconnect();
+}
+
+BOOST_AUTO_TEST_CASE(MustNotifyVarUpdatesToLegacyClients)
+{
+   let_test()
+         .connect()
+         .handshake(0x0100)
+         .subscribe("fsuipc/offset", "0x700:4")
+         .subscribe("fsuipc/offset", "0x800:1")
+         .on_offset_change(0x700, oac::fsuipc::OFFSET_LEN_DWORD, 0x0a0b0c0d)
+         .fsuipc_polls_for_changes()
+         .on_offset_change(0x800, oac::fsuipc::OFFSET_LEN_BYTE, 0xab)
+         .fsuipc_polls_for_changes()
+         .receive_var_update(
+               "fsuipc/offset",
+               "0x700:4",
+               variable_value::from_dword(0x0a0b0c0d))
+         .receive_var_update(
+               "fsuipc/offset",
+               "0x800:1",
+               variable_value::from_byte(0xab))
+         .disconnect();
+}
+
 BOOST_AUTO_TEST_CASE(MustAcceptVarUpdatesFromClient)
 {
    let_test()
@@ -482,12 +666,12 @@ BOOST_AUTO_TEST_CASE(MustAcceptVarUpdatesFromClient)
                "fsuipc/offset",
                "0x700:4",
                variable_value::from_dword(0x01020304))
-         .assert_offset_value(0x700, oac::fsuipc::OFFSET_LEN_DWORD, 0x01020304)
-         .fsuipc_polls_for_changes()
+         .fsuipc_polls_for_changes() // the update is written on next poll
          .receive_var_update(
                "fsuipc/offset",
                "0x700:4",
                variable_value::from_dword(0x01020304))
+         .assert_offset_value(0x700, oac::fsuipc::OFFSET_LEN_DWORD, 0x01020304)
           // check server still responds
          .subscribe("fsuipc/offset", "0x800:1")
          .on_offset_change(0x800, oac::fsuipc::OFFSET_LEN_BYTE, 0x4a)
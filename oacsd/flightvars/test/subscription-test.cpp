@@ -17,16 +17,47 @@
  */
 
 #include <set>
+#include <vector>
 
 #define BOOST_AUTO_TEST_MAIN
 #include <boost/test/auto_unit_test.hpp>
 
+#include <boost/thread.hpp>
+
 #include <flightvars/subscription.h>
 
 using namespace oac;
 using namespace oac::fv;
 using namespace oac::fv::subs;
 
+BOOST_AUTO_TEST_SUITE(SubscriptionIdTest)
+
+BOOST_AUTO_TEST_CASE(ShouldMakeUniqueIdsFromManyThreads)
+{
+   const std::size_t NTHREADS = 8;
+   const std::size_t NIDS = 10000;
+
+   std::vector<std::vector<subscription_id>> ids(NTHREADS);
+   boost::thread_group threads;
+   for (std::size_t t = 0; t < NTHREADS; t++)
+   {
+      auto& thread_ids = ids[t];
+      threads.create_thread([&thread_ids, NIDS]()
+      {
+         for (std::size_t i = 0; i < NIDS; i++)
+            thread_ids.push_back(make_subscription_id());
+      });
+   }
+   threads.join_all();
+
+   std::set<subscription_id> unique_ids;
+   for (auto& thread_ids : ids)
+      unique_ids.insert(thread_ids.begin(), thread_ids.end());
+   BOOST_CHECK_EQUAL(NTHREADS * NIDS, unique_ids.size());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
 BOOST_AUTO_TEST_SUITE(SubscriptionMapTest)
 
 BOOST_AUTO_TEST_CASE(ShouldRegisterSubscription)
@@ -131,3 +162,77 @@ BOOST_AUTO_TEST_CASE(ShouldExecuteActionForEachSubscription)
 }
 
 BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(QoSFilterTest)
+
+qos_filter::clock::time_point at(int millis)
+{
+   return qos_filter::clock::time_point(boost::chrono::milliseconds(millis));
+}
+
+BOOST_AUTO_TEST_CASE(ShouldAcceptAllUpdatesWithDefaultQoS)
+{
+   qos_filter filter;
+   BOOST_CHECK(filter.accept(variable_value::from_word(10), at(0)));
+   BOOST_CHECK(filter.accept(variable_value::from_word(10), at(0)));
+   BOOST_CHECK(filter.accept(variable_value::from_word(11), at(1)));
+   BOOST_CHECK(!filter.has_deferred());
+}
+
+BOOST_AUTO_TEST_CASE(ShouldDropUpdatesWithinAbsoluteDeadband)
+{
+   qos_filter filter(subscription_qos(0, deadband_kind::ABSOLUTE_DELTA, 5.0f));
+   BOOST_CHECK(filter.accept(variable_value::from_word(100), at(0)));
+   BOOST_CHECK(!filter.accept(variable_value::from_word(104), at(1)));
+   BOOST_CHECK(!filter.accept(variable_value::from_word(95), at(2)));
+   BOOST_CHECK(filter.accept(variable_value::from_word(106), at(3)));
+   BOOST_CHECK(!filter.accept(variable_value::from_word(110), at(4)));
+   BOOST_CHECK(!filter.has_deferred());
+}
+
+BOOST_AUTO_TEST_CASE(ShouldDropUpdatesWithinRelativeDeadband)
+{
+   qos_filter filter(subscription_qos(0, deadband_kind::RELATIVE_DELTA, 0.1f));
+   BOOST_CHECK(filter.accept(variable_value::from_float(200.0f), at(0)));
+   BOOST_CHECK(!filter.accept(variable_value::from_float(190.0f), at(1)));
+   BOOST_CHECK(filter.accept(variable_value::from_float(230.0f), at(2)));
+}
+
+BOOST_AUTO_TEST_CASE(ShouldNotApplyDeadbandToBooleans)
+{
+   qos_filter filter(subscription_qos(0, deadband_kind::ABSOLUTE_DELTA, 5.0f));
+   BOOST_CHECK(filter.accept(variable_value::from_bool(false), at(0)));
+   BOOST_CHECK(filter.accept(variable_value::from_bool(true), at(1)));
+}
+
+BOOST_AUTO_TEST_CASE(ShouldDeferUpdatesWithinMinInterval)
+{
+   qos_filter filter(subscription_qos(100));
+   BOOST_CHECK(filter.accept(variable_value::from_dword(1), at(0)));
+   BOOST_CHECK(!filter.accept(variable_value::from_dword(2), at(30)));
+   BOOST_CHECK(!filter.accept(variable_value::from_dword(3), at(60)));
+   BOOST_CHECK(filter.has_deferred());
+
+   BOOST_CHECK(!filter.take_deferred(at(90)));
+   auto deferred = filter.take_deferred(at(100));
+   BOOST_REQUIRE(deferred);
+   BOOST_CHECK_EQUAL(3, deferred->as_dword());
+   BOOST_CHECK(!filter.has_deferred());
+
+   BOOST_CHECK(!filter.accept(variable_value::from_dword(4), at(150)));
+   BOOST_CHECK(filter.accept(variable_value::from_dword(5), at(200)));
+   BOOST_CHECK(!filter.has_deferred());
+}
+
+BOOST_AUTO_TEST_CASE(ShouldDiscardDeferredUpdateWhenBackWithinDeadband)
+{
+   qos_filter filter(
+         subscription_qos(100, deadband_kind::ABSOLUTE_DELTA, 1.0f));
+   BOOST_CHECK(filter.accept(variable_value::from_word(10), at(0)));
+   BOOST_CHECK(!filter.accept(variable_value::from_word(20), at(30)));
+   BOOST_CHECK(filter.has_deferred());
+   BOOST_CHECK(!filter.accept(variable_value::from_word(10), at(60)));
+   BOOST_CHECK(!filter.has_deferred());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -19,11 +19,35 @@
 #define BOOST_AUTO_TEST_MAIN
 #include <boost/test/auto_unit_test.hpp>
 
+#include <cstdlib>
+#include <new>
+
 #include <flightvars/var.h>
 
 using namespace oac;
 using namespace oac::fv;
 
+namespace {
+
+std::size_t allocation_count = 0;
+
+} // anonymous namespace
+
+// Count the allocations to check variable values do not need dynamic memory
+void* operator new(std::size_t size) throw (std::bad_alloc)
+{
+   allocation_count++;
+   auto p = std::malloc(size ? size : 1);
+   if (!p)
+      throw std::bad_alloc();
+   return p;
+}
+
+void operator delete(void* p) throw()
+{
+   std::free(p);
+}
+
 BOOST_AUTO_TEST_SUITE(VariableId)
 
 BOOST_AUTO_TEST_CASE(MustCaptureLowerCaseGroup)
@@ -47,6 +71,69 @@ BOOST_AUTO_TEST_CASE(MustBeEqualWhenGroupAndNameMatches)
    BOOST_CHECK_EQUAL(id1, id2);
 }
 
+BOOST_AUTO_TEST_CASE(MustShareHandleWhenGroupAndNameMatchesIgnoringCase)
+{
+   variable_id id1("my_group/foobar", "my_var/millibars");
+   variable_id id2("MY_GROUP/foobar", "my_var/MILLIBARS");
+   variable_id id3("my_group/foobar", "my_var/inches");
+   BOOST_CHECK_EQUAL(id1.handle(), id2.handle());
+   BOOST_CHECK_NE(id1.handle(), id3.handle());
+}
+
+BOOST_AUTO_TEST_CASE(MustObtainVariableIdFromHandle)
+{
+   variable_id id1("my_group/foobar", "my_var/millibars");
+   auto id2 = variable_id::from_handle(id1.handle());
+   BOOST_CHECK_EQUAL(id1, id2);
+   BOOST_CHECK_EQUAL("my_group/foobar", id2.group);
+   BOOST_CHECK_EQUAL("my_var/millibars", id2.name);
+}
+
+BOOST_AUTO_TEST_CASE(MustThrowOnObtainingVariableIdFromUnknownHandle)
+{
+   BOOST_CHECK_THROW(
+         variable_id::from_handle(0xffffffff),
+         variable_id::no_such_handle_error);
+}
+
+BOOST_AUTO_TEST_CASE(MustReleaseEntryWhenLastIdIsDestroyed)
+{
+   auto count = variable_id::interned_count();
+   variable_handle handle;
+   {
+      variable_id id1("my_group/foobar", "my_var/released");
+      variable_id id2(id1);
+      handle = id1.handle();
+      BOOST_CHECK_EQUAL(count + 1, variable_id::interned_count());
+   }
+   BOOST_CHECK_EQUAL(count, variable_id::interned_count());
+   BOOST_CHECK_THROW(
+         variable_id::from_handle(handle),
+         variable_id::no_such_handle_error);
+}
+
+BOOST_AUTO_TEST_CASE(MustReuseHandleOfReleasedEntry)
+{
+   variable_handle handle;
+   {
+      variable_id id("my_group/foobar", "my_var/first");
+      handle = id.handle();
+   }
+   variable_id id("my_group/foobar", "my_var/second");
+   BOOST_CHECK_EQUAL(handle, id.handle());
+   BOOST_CHECK_EQUAL("my_var/second", id.name);
+}
+
+BOOST_AUTO_TEST_CASE(MustNotGrowTableOnRepeatedUnknownNames)
+{
+   auto count = variable_id::interned_count();
+   for (int i = 0; i < 1000; i++)
+   {
+      variable_id id("my_group/foobar", format("my_var/%d", i));
+   }
+   BOOST_CHECK_EQUAL(count, variable_id::interned_count());
+}
+
 BOOST_AUTO_TEST_CASE(MustBeDistinctWhenGroupNotMatches)
 {
    variable_id id1("my_group/foo", "my_var/millibars");
@@ -189,4 +276,29 @@ BOOST_AUTO_TEST_CASE(MustConvertToStringForFloat)
    BOOST_CHECK_EQUAL("3.141500(float)", val.to_string());
 }
 
+BOOST_AUTO_TEST_CASE(MustCompareByTypeAndValue)
+{
+   BOOST_CHECK(variable_value::from_word(12) == variable_value::from_word(12));
+   BOOST_CHECK(!(variable_value::from_word(12) == variable_value::from_word(13)));
+   BOOST_CHECK(!(variable_value::from_word(12) == variable_value::from_dword(12)));
+   BOOST_CHECK(variable_value::from_bool(true) == variable_value::from_bool(true));
+}
+
+BOOST_AUTO_TEST_CASE(MustNotAllocateMemoryOnCreationCopyAndComparison)
+{
+   std::uint32_t sum = 0;
+   auto before = allocation_count;
+   for (std::uint32_t i = 0; i < 10000; i++)
+   {
+      auto val = variable_value::from_dword(i);
+      auto copy = val;
+      if (copy == val)
+         sum += copy.as_dword();
+   }
+   auto allocations = allocation_count - before;
+
+   BOOST_CHECK_EQUAL(0, allocations);
+   BOOST_CHECK_EQUAL(49995000, sum);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
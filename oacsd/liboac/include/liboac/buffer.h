@@ -23,8 +23,10 @@
 #include <liboac/buffer/errors.h>
 #include <liboac/buffer/functions.h>
 #include <liboac/buffer/linear.h>
+#include <liboac/buffer/pool.h>
 #include <liboac/buffer/ring.h>
 #include <liboac/buffer/shifted.h>
+#include <liboac/buffer/spsc_ring.h>
 
 namespace oac {
 
@@ -51,6 +51,25 @@ public:
 
    void reset();
 
+   /**
+    * Discard all the bytes stored in the buffer and unset the mark, so it
+    * can be reused as if it were just created.
+    */
+   void clear();
+
+   /**
+    * Obtain the region of contiguous memory holding the bytes available
+    * for read, starting at the read position. It comprises less bytes than
+    * available_for_read() when the readable bytes are not contiguous.
+    */
+   boost::asio::const_buffer read_region() const;
+
+   /**
+    * Consume up to count bytes available for read without copying them.
+    * It returns the number of bytes actually consumed.
+    */
+   std::size_t skip(std::size_t count);
+
    template <typename AsyncReadStream,
              typename ReadHandler>
    void async_write_some_from(AsyncReadStream& stream, ReadHandler handler);
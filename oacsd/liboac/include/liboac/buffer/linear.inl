@@ -96,6 +96,32 @@ linear_stream_buffer_base<Buffer>::reset()
    }
 }
 
+template <typename Buffer>
+void
+linear_stream_buffer_base<Buffer>::clear()
+{
+   _read_index = 0;
+   _write_index = 0;
+   _mark.reset();
+}
+
+template <typename Buffer>
+boost::asio::const_buffer
+linear_stream_buffer_base<Buffer>::read_region() const
+{
+   auto data = ((const std::uint8_t*) _self->data()) + _read_index;
+   return boost::asio::const_buffer(data, available_for_read());
+}
+
+template <typename Buffer>
+std::size_t
+linear_stream_buffer_base<Buffer>::skip(std::size_t count)
+{
+   count = std::min(count, available_for_read());
+   _read_index += count;
+   return count;
+}
+
 template <typename Buffer>
 template <typename AsyncReadStream,
           typename AsyncReadHandler>
@@ -0,0 +1,255 @@
+/*
+ * This file is part of Open Airbus Cockpit
+ * Copyright (C) 2012, 2013 Alvaro Polo
+ *
+ * Open Airbus Cockpit is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Open Airbus Cockpit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Open Airbus Cockpit. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OAC_BUFFER_POOL_H
+#define OAC_BUFFER_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <new>
+
+#include <boost/lockfree/stack.hpp>
+
+namespace oac { namespace buffer {
+
+/**
+ * A pool of buffers created by a BufferFactory. A buffer obtained from the
+ * pool returns to it as soon as the last reference to it is released, so
+ * the caller may keep it alive for as long as needed (e.g., until the
+ * asynchronous write that sends its contents completes) without having to
+ * give it back explicitly.
+ *
+ * Available buffers are kept in a lock-free stack. Acquiring a buffer pops
+ * it from the stack, and the deleter of the returned pointer pushes it
+ * back, so both operations take constant time and sessions served by
+ * different threads never wait for each other. The reference count block
+ * of the returned pointer is allocated from a second lock-free stack of
+ * the pool, so once the pool has warmed up, acquiring and releasing a
+ * buffer does no heap allocation at all. Released buffers and blocks
+ * beyond the maximum available count are destroyed rather than pushed
+ * back, so the pool shrinks after a peak of use.
+ *
+ * Buffer type must provide a clear() member function that discards its
+ * contents, as linear_buffer does. Acquiring and releasing buffers is
+ * thread-safe, and buffers may outlive the pool they were obtained from.
+ */
+template <typename Buffer>
+class buffer_pool
+{
+public:
+
+   typedef Buffer value_type;
+   typedef typename Buffer::ptr_type ptr_type;
+   typedef typename Buffer::factory_ptr factory_ptr;
+
+   static const std::size_t DEFAULT_MAX_AVAILABLE = 64;
+
+   /**
+    * Create a new buffer pool which creates its buffers using the given
+    * factory. The initial size indicates how many buffers are created
+    * in advance. The max available indicates how many buffers not in
+    * use are kept by the pool; it is raised to the initial size if lower.
+    */
+   buffer_pool(
+         const factory_ptr& factory,
+         std::size_t initial_size = 0,
+         std::size_t max_available = DEFAULT_MAX_AVAILABLE)
+      : _state(std::make_shared<state>(
+            factory, std::max(initial_size, max_available)))
+   {
+      for (std::size_t i = 0; i < initial_size; i++)
+         _state->push_free(_state->factory->create_buffer());
+      _state->size = initial_size;
+   }
+
+   ~buffer_pool()
+   {
+      _state->closed = true;
+      _state->delete_free();
+   }
+
+   /**
+    * Obtain an empty buffer from the pool. If all the buffers of the pool
+    * are in use, a new one is created by the factory.
+    */
+   ptr_type acquire()
+   {
+      value_type* buff = nullptr;
+      if (_state->pop_free(buff))
+         buff->clear();
+      else
+      {
+         buff = _state->factory->create_buffer();
+         _state->size++;
+      }
+      return ptr_type(
+            buff, recycler(_state), block_allocator<value_type>(_state));
+   }
+
+   /**
+    * The number of buffers owned by the pool, either in use or available.
+    */
+   std::size_t size() const
+   { return _state->size; }
+
+   /**
+    * The number of buffers which are not in use.
+    */
+   std::size_t available() const
+   { return _state->available; }
+
+private:
+
+   /*
+    * The state shared by the pool, the deleters of the buffers in use and
+    * the allocators of their reference count blocks, so released buffers
+    * and blocks find their stacks even if the pool has gone.
+    */
+   struct state
+   {
+      factory_ptr factory;
+      std::atomic<std::size_t> size;
+      std::atomic<std::size_t> available;
+      std::atomic<bool> closed;
+      boost::lockfree::stack<value_type*> free;
+      boost::lockfree::stack<void*> blocks;
+
+      /** The size of the reference count blocks, known once one is freed. */
+      std::atomic<std::size_t> block_size;
+
+      state(const factory_ptr& f, std::size_t max_avail)
+         : factory(f),
+           size(0),
+           available(0),
+           closed(false),
+           free(max_avail),
+           blocks(max_avail),
+           block_size(0)
+      {}
+
+      ~state()
+      {
+         delete_free();
+         void* block;
+         while (blocks.pop(block))
+            ::operator delete(block);
+      }
+
+      bool push_free(value_type* buff)
+      {
+         // Counted in advance so the count never goes below zero
+         available++;
+         if (free.bounded_push(buff))
+            return true;
+         available--;
+         return false;
+      }
+
+      bool pop_free(value_type*& buff)
+      {
+         if (!free.pop(buff))
+            return false;
+         available--;
+         return true;
+      }
+
+      void delete_free()
+      {
+         value_type* buff;
+         while (pop_free(buff))
+         {
+            size--;
+            delete buff;
+         }
+      }
+
+      void* allocate_block(std::size_t n)
+      {
+         void* block;
+         if (n == block_size && blocks.pop(block))
+            return block;
+         return ::operator new(n);
+      }
+
+      void deallocate_block(void* block, std::size_t n)
+      {
+         std::size_t unknown = 0;
+         block_size.compare_exchange_strong(unknown, n);
+         if (n != block_size || !blocks.bounded_push(block))
+            ::operator delete(block);
+      }
+   };
+
+   struct recycler
+   {
+      std::shared_ptr<state> st;
+
+      recycler(const std::shared_ptr<state>& s) : st(s) {}
+
+      void operator()(value_type* buff) const
+      {
+         if (!st->closed && st->push_free(buff))
+            return;
+         st->size--;
+         delete buff;
+      }
+   };
+
+   /*
+    * The allocator of the reference count blocks of the buffers in use.
+    */
+   template <typename T>
+   struct block_allocator
+   {
+      typedef T value_type;
+
+      template <typename U>
+      struct rebind { typedef block_allocator<U> other; };
+
+      std::shared_ptr<state> st;
+
+      block_allocator(const std::shared_ptr<state>& s) : st(s) {}
+
+      template <typename U>
+      block_allocator(const block_allocator<U>& other) : st(other.st) {}
+
+      T* allocate(std::size_t n)
+      { return static_cast<T*>(st->allocate_block(n * sizeof(T))); }
+
+      void deallocate(T* p, std::size_t n)
+      { st->deallocate_block(p, n * sizeof(T)); }
+
+      template <typename U>
+      bool operator == (const block_allocator<U>& other) const
+      { return st == other.st; }
+
+      template <typename U>
+      bool operator != (const block_allocator<U>& other) const
+      { return st != other.st; }
+   };
+
+   std::shared_ptr<state> _state;
+
+   buffer_pool(const buffer_pool&);
+   buffer_pool& operator = (const buffer_pool&);
+};
+
+}} // namespace oac::buffer
+
+#endif
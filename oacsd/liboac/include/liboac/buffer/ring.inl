@@ -145,6 +145,26 @@ ring_stream_buffer_base<Buffer>::reset()
    }
 }
 
+template <typename Buffer>
+boost::asio::const_buffer
+ring_stream_buffer_base<Buffer>::read_region() const
+{
+   auto len = std::min(_bytes_written, _self->capacity() - _read_index);
+   auto data = ((const std::uint8_t*) _self->data()) + _read_index;
+   return boost::asio::const_buffer(data, len);
+}
+
+template <typename Buffer>
+std::size_t
+ring_stream_buffer_base<Buffer>::skip(std::size_t count)
+{
+   count = std::min(count, available_for_read());
+   _read_index = (_read_index + count) % _self->capacity();
+   _bytes_written -= count;
+   inc_dist_from_mark(count);
+   return count;
+}
+
 template <typename Buffer>
 template <typename AsyncReadStream,
           typename AsyncReadHandler>
@@ -0,0 +1,161 @@
+/*
+ * This file is part of Open Airbus Cockpit
+ * Copyright (C) 2012, 2013 Alvaro Polo
+ *
+ * Open Airbus Cockpit is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Open Airbus Cockpit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Open Airbus Cockpit. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OAC_BUFFER_SPSC_RING_H
+#define OAC_BUFFER_SPSC_RING_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include <boost/asio/buffer.hpp>
+
+namespace oac { namespace buffer {
+
+/**
+ * A ring buffer to hand data over from one thread to another without locks
+ * nor allocations. Only one thread may write to it (the producer) and only
+ * one thread may read from it (the consumer) at the same time. It provides
+ * the InputStream and OutputStream interfaces, the former to be used by the
+ * consumer and the latter by the producer.
+ *
+ * The capacity is rounded up to a power of two. The read and write indices
+ * are on distinct cache lines, so the producer and the consumer do not
+ * invalidate each other's cache while they are not waiting for each other.
+ * Each side keeps a copy of the other's index and only loads it again when
+ * that copy says there is not enough room or data.
+ *
+ * Besides copying, the bytes may be accessed in place. The producer writes
+ * in write_region() and publishes them with commit(). The consumer reads
+ * from read_region() and releases them with skip().
+ */
+class spsc_ring_buffer
+{
+public:
+
+   /** The assumed size of a cache line. */
+   static const std::size_t CACHE_LINE_SIZE = 64;
+
+   typedef std::shared_ptr<spsc_ring_buffer> ptr_type;
+
+   /**
+    * Create a new ring buffer with at least the given capacity.
+    */
+   spsc_ring_buffer(std::size_t capacity);
+
+   std::size_t capacity() const;
+
+   /**
+    * Write up to count bytes, as many as room is available. It may only be
+    * invoked by the producer. It returns the number of bytes written.
+    */
+   std::size_t write(const void* src, std::size_t count);
+
+   /**
+    * Read up to count bytes, as many as available. It may only be invoked
+    * by the consumer. It returns the number of bytes read.
+    */
+   std::size_t read(void* dst, std::size_t count);
+
+   void flush();
+
+   /**
+    * The number of bytes available for read. When invoked by the consumer,
+    * this number may only grow until the consumer reads.
+    */
+   std::size_t available_for_read() const;
+
+   /**
+    * The number of bytes available for write. When invoked by the producer,
+    * this number may only grow until the producer writes.
+    */
+   std::size_t available_for_write() const;
+
+   /**
+    * Obtain the region of contiguous memory available for write, starting
+    * at the write position. It comprises less bytes than
+    * available_for_write() when the writable bytes are not contiguous.
+    * It may only be invoked by the producer.
+    */
+   boost::asio::mutable_buffer write_region();
+
+   /**
+    * Publish up to count bytes written in the write region to the
+    * consumer. It returns the number of bytes actually published.
+    */
+   std::size_t commit(std::size_t count);
+
+   /**
+    * Obtain the region of contiguous memory holding the bytes available
+    * for read, starting at the read position. It comprises less bytes than
+    * available_for_read() when the readable bytes are not contiguous.
+    * It may only be invoked by the consumer.
+    */
+   boost::asio::const_buffer read_region();
+
+   /**
+    * Consume up to count bytes available for read without copying them.
+    * It returns the number of bytes actually consumed.
+    */
+   std::size_t skip(std::size_t count);
+
+private:
+
+   typedef std::atomic<std::size_t> index_type;
+
+   // The indices grow without bound, wrapping around the size_t range,
+   // so the ring is full when they differ in the capacity
+   std::unique_ptr<std::uint8_t[]> _data;
+   std::size_t _mask;
+   std::uint8_t _pad0[CACHE_LINE_SIZE];
+
+   index_type _write_index;
+   std::size_t _cached_read_index;
+   std::uint8_t _pad1[CACHE_LINE_SIZE - sizeof(index_type) -
+                      sizeof(std::size_t)];
+
+   index_type _read_index;
+   std::size_t _cached_write_index;
+   std::uint8_t _pad2[CACHE_LINE_SIZE - sizeof(index_type) -
+                      sizeof(std::size_t)];
+
+   spsc_ring_buffer(const spsc_ring_buffer&);
+   spsc_ring_buffer& operator = (const spsc_ring_buffer&);
+
+   static std::size_t round_up_capacity(std::size_t capacity);
+
+   /**
+    * The bytes available for write, loading the read index again only if
+    * the cached one leaves less than wanted.
+    */
+   std::size_t writable(std::size_t wanted);
+
+   /**
+    * The bytes available for read, loading the write index again only if
+    * the cached one leaves less than wanted.
+    */
+   std::size_t readable(std::size_t wanted);
+};
+
+typedef std::shared_ptr<spsc_ring_buffer> spsc_ring_buffer_ptr;
+
+}} // namespace oac::buffer
+
+#include <liboac/buffer/spsc_ring.inl>
+
+#endif
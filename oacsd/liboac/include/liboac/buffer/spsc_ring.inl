@@ -0,0 +1,159 @@
+/*
+ * This file is part of Open Airbus Cockpit
+ * Copyright (C) 2012, 2013 Alvaro Polo
+ *
+ * Open Airbus Cockpit is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Open Airbus Cockpit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Open Airbus Cockpit. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OAC_BUFFER_SPSC_RING_INL
+#define OAC_BUFFER_SPSC_RING_INL
+
+#include <algorithm>
+#include <cstring>
+
+#include <liboac/buffer/spsc_ring.h>
+
+namespace oac { namespace buffer {
+
+inline
+spsc_ring_buffer::spsc_ring_buffer(std::size_t capacity)
+   : _data(new std::uint8_t[round_up_capacity(capacity)]),
+     _mask(round_up_capacity(capacity) - 1),
+     _write_index(0),
+     _cached_read_index(0),
+     _read_index(0),
+     _cached_write_index(0)
+{}
+
+inline std::size_t
+spsc_ring_buffer::capacity() const
+{ return _mask + 1; }
+
+inline std::size_t
+spsc_ring_buffer::write(const void* src, std::size_t count)
+{
+   count = std::min(count, writable(count));
+   auto index = _write_index.load(std::memory_order_relaxed);
+   auto offset = index & _mask;
+   auto first = std::min(count, capacity() - offset);
+   std::memcpy(&_data[offset], src, first);
+   std::memcpy(
+         &_data[0], static_cast<const std::uint8_t*>(src) + first,
+         count - first);
+   _write_index.store(index + count, std::memory_order_release);
+   return count;
+}
+
+inline std::size_t
+spsc_ring_buffer::read(void* dst, std::size_t count)
+{
+   count = std::min(count, readable(count));
+   auto index = _read_index.load(std::memory_order_relaxed);
+   auto offset = index & _mask;
+   auto first = std::min(count, capacity() - offset);
+   std::memcpy(dst, &_data[offset], first);
+   std::memcpy(
+         static_cast<std::uint8_t*>(dst) + first, &_data[0], count - first);
+   _read_index.store(index + count, std::memory_order_release);
+   return count;
+}
+
+inline void
+spsc_ring_buffer::flush()
+{
+   // As in-memory buffer, nothing to do
+}
+
+inline std::size_t
+spsc_ring_buffer::available_for_read() const
+{
+   return _write_index.load(std::memory_order_acquire) -
+          _read_index.load(std::memory_order_acquire);
+}
+
+inline std::size_t
+spsc_ring_buffer::available_for_write() const
+{
+   return capacity() - (_write_index.load(std::memory_order_acquire) -
+                        _read_index.load(std::memory_order_acquire));
+}
+
+inline boost::asio::mutable_buffer
+spsc_ring_buffer::write_region()
+{
+   auto len = writable(capacity());
+   auto offset = _write_index.load(std::memory_order_relaxed) & _mask;
+   return boost::asio::mutable_buffer(
+         &_data[offset], std::min(len, capacity() - offset));
+}
+
+inline std::size_t
+spsc_ring_buffer::commit(std::size_t count)
+{
+   count = std::min(count, writable(count));
+   _write_index.store(
+         _write_index.load(std::memory_order_relaxed) + count,
+         std::memory_order_release);
+   return count;
+}
+
+inline boost::asio::const_buffer
+spsc_ring_buffer::read_region()
+{
+   auto len = readable(capacity());
+   auto offset = _read_index.load(std::memory_order_relaxed) & _mask;
+   return boost::asio::const_buffer(
+         &_data[offset], std::min(len, capacity() - offset));
+}
+
+inline std::size_t
+spsc_ring_buffer::skip(std::size_t count)
+{
+   count = std::min(count, readable(count));
+   _read_index.store(
+         _read_index.load(std::memory_order_relaxed) + count,
+         std::memory_order_release);
+   return count;
+}
+
+inline std::size_t
+spsc_ring_buffer::round_up_capacity(std::size_t capacity)
+{
+   std::size_t result = 1;
+   while (result < capacity)
+      result <<= 1;
+   return result;
+}
+
+inline std::size_t
+spsc_ring_buffer::writable(std::size_t wanted)
+{
+   auto index = _write_index.load(std::memory_order_relaxed);
+   if (capacity() - (index - _cached_read_index) < wanted)
+      _cached_read_index = _read_index.load(std::memory_order_acquire);
+   return capacity() - (index - _cached_read_index);
+}
+
+inline std::size_t
+spsc_ring_buffer::readable(std::size_t wanted)
+{
+   auto index = _read_index.load(std::memory_order_relaxed);
+   if (_cached_write_index - index < wanted)
+      _cached_write_index = _write_index.load(std::memory_order_acquire);
+   return _cached_write_index - index;
+}
+
+}} // namespace oac::buffer
+
+#endif
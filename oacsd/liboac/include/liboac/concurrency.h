@@ -19,14 +19,28 @@
 #ifndef OAC_CONCURRENCY_H
 #define OAC_CONCURRENCY_H
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <functional>
 #include <future>
+#include <memory>
+#include <mutex>
 #include <queue>
+#include <type_traits>
+#include <vector>
 
 #include <boost/thread.hpp>
 
+#include <liboac/exception.h>
+
 namespace oac {
 
+/**
+ * An executor of jobs on a single background thread. The jobs are executed
+ * while holding the lock of the queue, so producers are blocked while a job
+ * runs. Prefer a thread_pool for new code.
+ */
 class async_executor
 {
 public:
@@ -111,6 +125,24 @@ private:
    template <typename>
    class job;
 
+   /**
+    * Invoke the function and set its result as the value of the promise.
+    * A function returning void has no result to pass, so it is overloaded.
+    */
+   template <typename RetType>
+   static void fulfill(
+         std::promise<RetType>& promise,
+         const std::function<RetType(void)>& func)
+   { promise.set_value(func()); }
+
+   static void fulfill(
+         std::promise<void>& promise,
+         const std::function<void(void)>& func)
+   {
+      func();
+      promise.set_value();
+   }
+
    template <typename RetType>
    class job<RetType(void)> : public job_base
    {
@@ -123,8 +155,8 @@ private:
 
       void execute() override final
       {
-         auto result = _func();
-         _promise.set_value(result);
+         try { fulfill(_promise, _func); }
+         catch (...) { _promise.set_exception(std::current_exception()); }
       }
 
       std::future<result_type> get_future()
@@ -155,6 +187,273 @@ private:
    }
 };
 
+/**
+ * A job to be executed by a thread pool. It wraps any callable object with
+ * no arguments, including those that can be moved but not copied.
+ */
+class pool_job
+{
+public:
+
+   virtual ~pool_job() {}
+
+   virtual void run() = 0;
+
+   template <typename Function>
+   static std::unique_ptr<pool_job> make(Function&& func);
+
+private:
+
+   template <typename Function>
+   class function_job;
+};
+
+template <typename Function>
+class pool_job::function_job : public pool_job
+{
+public:
+
+   function_job(Function&& func) : _func(std::move(func)) {}
+
+   function_job(const Function& func) : _func(func) {}
+
+   void run() override final
+   { _func(); }
+
+private:
+
+   Function _func;
+};
+
+template <typename Function>
+std::unique_ptr<pool_job>
+pool_job::make(Function&& func)
+{
+   typedef typename std::decay<Function>::type function_type;
+   return std::unique_ptr<pool_job>(
+         new function_job<function_type>(std::forward<Function>(func)));
+}
+
+/**
+ * A function that fulfills a promise with the result of a function, or
+ * with the exception it throws.
+ */
+template <typename Result, typename Function>
+class promised_function
+{
+public:
+
+   promised_function(Function&& func) : _func(std::move(func)) {}
+
+   promised_function(promised_function&& other)
+      : _func(std::move(other._func)),
+        _promise(std::move(other._promise))
+   {}
+
+   std::future<Result> get_future()
+   { return _promise.get_future(); }
+
+   void operator()()
+   {
+      try
+      {
+         fulfill(std::is_void<Result>());
+      }
+      catch (...)
+      {
+         _promise.set_exception(std::current_exception());
+      }
+   }
+
+private:
+
+   Function _func;
+   std::promise<Result> _promise;
+
+   promised_function(const promised_function&);
+   promised_function& operator = (const promised_function&);
+
+   void fulfill(std::false_type)
+   { _promise.set_value(_func()); }
+
+   void fulfill(std::true_type)
+   {
+      _func();
+      _promise.set_value();
+   }
+};
+
+/**
+ * A pool of threads that execute jobs. Each worker thread has its own
+ * deque of jobs. The jobs submitted from a worker are pushed into its own
+ * deque, and the jobs submitted from elsewhere are spread across the
+ * workers. Each worker executes the most recent job of its deque, and
+ * when it runs out of jobs, it steals the oldest job of the other workers.
+ * The jobs are executed without holding any lock.
+ *
+ * The jobs may be any callable object with no arguments, either copyable
+ * or only movable. Their result, void included, is delivered as a future.
+ * The jobs are not executed in any particular order; use a strand for
+ * ordered execution.
+ */
+class thread_pool
+{
+public:
+
+   /**
+    * An exception caused by a job submitted to a stopped pool.
+    */
+   OAC_DECL_EXCEPTION(
+         pool_stopped_error,
+         oac::exception,
+         "cannot submit a job to a stopped thread pool");
+
+   /**
+    * Create a new pool and start its threads.
+    *
+    * @param nthreads The number of worker threads, or zero for as many
+    *                 as hardware threads are available
+    */
+   explicit thread_pool(std::size_t nthreads = 0);
+
+   /**
+    * Stop the pool, waiting for the pending jobs to complete.
+    */
+   ~thread_pool();
+
+   /**
+    * Submit a function to be executed by the pool, and obtain a future
+    * for its result. If the function throws, the future delivers its
+    * exception.
+    */
+   template <typename Function>
+   auto submit(Function&& func)
+   throw (pool_stopped_error) -> std::future<decltype(func())>
+   {
+      typedef decltype(func()) result_type;
+      typedef typename std::decay<Function>::type function_type;
+
+      promised_function<result_type, function_type> job(
+            function_type(std::forward<Function>(func)));
+      auto result = job.get_future();
+      push(pool_job::make(std::move(job)));
+      return result;
+   }
+
+   /**
+    * Post a function to be executed by the pool. Any exception thrown by
+    * the function is ignored.
+    */
+   template <typename Function>
+   void post(Function&& func) throw (pool_stopped_error)
+   { push(pool_job::make(std::forward<Function>(func))); }
+
+   /**
+    * Stop the pool. The pending jobs, and those they submit, are executed
+    * before the worker threads terminate. It must not be invoked from a
+    * worker.
+    */
+   void stop();
+
+   /** The number of worker threads. */
+   std::size_t size() const
+   { return _workers.size(); }
+
+   /** The number of jobs stolen by a worker from another one. */
+   std::size_t stolen_jobs() const
+   { return _stolen_jobs; }
+
+private:
+
+   typedef std::unique_ptr<pool_job> job_ptr;
+
+   struct worker
+   {
+      std::mutex mutex;
+      std::deque<job_ptr> jobs;
+   };
+
+   std::vector<std::unique_ptr<worker>> _workers;
+   boost::thread_group _threads;
+   boost::thread_specific_ptr<std::size_t> _current_worker;
+   std::atomic<std::size_t> _next_worker;
+   std::atomic<std::size_t> _pending_jobs;
+   std::atomic<std::size_t> _idle_workers;
+   std::atomic<std::size_t> _stolen_jobs;
+   std::atomic<bool> _stopping;
+   std::mutex _idle_mutex;
+   std::condition_variable _job_pushed;
+
+   thread_pool(const thread_pool&);
+   thread_pool& operator = (const thread_pool&);
+
+   void push(job_ptr&& job) throw (pool_stopped_error);
+
+   job_ptr pop(std::size_t index);
+
+   job_ptr steal(std::size_t index);
+
+   void run_worker(std::size_t index);
+};
+
+/**
+ * An executor that runs its jobs on a thread pool one after another, in
+ * the order they were submitted. Different strands on the same pool run
+ * concurrently. Copies of a strand share the same order.
+ */
+class strand
+{
+public:
+
+   strand(thread_pool& pool);
+
+   /**
+    * Submit a function to be executed after the previous ones, and obtain
+    * a future for its result.
+    */
+   template <typename Function>
+   auto submit(Function&& func) -> std::future<decltype(func())>
+   {
+      typedef decltype(func()) result_type;
+      typedef typename std::decay<Function>::type function_type;
+
+      promised_function<result_type, function_type> job(
+            function_type(std::forward<Function>(func)));
+      auto result = job.get_future();
+      _state->push(pool_job::make(std::move(job)));
+      return result;
+   }
+
+   /**
+    * Post a function to be executed after the previous ones. Any exception
+    * thrown by the function is ignored.
+    */
+   template <typename Function>
+   void post(Function&& func)
+   { _state->push(pool_job::make(std::forward<Function>(func))); }
+
+private:
+
+   struct state : std::enable_shared_from_this<state>
+   {
+      /** The jobs run before yielding the worker to other jobs. */
+      static const std::size_t BATCH_SIZE = 16;
+
+      thread_pool& pool;
+      std::mutex mutex;
+      std::queue<std::unique_ptr<pool_job>> jobs;
+      bool scheduled;
+
+      state(thread_pool& p) : pool(p), scheduled(false) {}
+
+      void push(std::unique_ptr<pool_job>&& job);
+
+      void run();
+   };
+
+   std::shared_ptr<state> _state;
+};
+
 } // namespace oac
 
 #endif
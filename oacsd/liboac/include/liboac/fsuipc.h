@@ -19,10 +19,14 @@
 #ifndef OAC_FSUIPC_H
 #define OAC_FSUIPC_H
 
+#include <liboac/fsuipc/capture.h>
 #include <liboac/fsuipc/client.h>
 #include <liboac/fsuipc/errors.h>
 #include <liboac/fsuipc/local.h>
 #include <liboac/fsuipc/offset.h>
+#include <liboac/fsuipc/read_plan.h>
+#include <liboac/fsuipc/shadow_memory.h>
+#include <liboac/fsuipc/simulator.h>
 #include <liboac/fsuipc/update_observer.h>
 
 #endif
@@ -0,0 +1,306 @@
+/*
+ * This file is part of Open Airbus Cockpit
+ * Copyright (C) 2012, 2013 Alvaro Polo
+ *
+ * Open Airbus Cockpit is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Open Airbus Cockpit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Open Airbus Cockpit. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OAC_FSUIPC_CAPTURE_H
+#define OAC_FSUIPC_CAPTURE_H
+
+#include <cstdint>
+#include <memory>
+
+#include <boost/chrono.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <liboac/io.h>
+#include <liboac/fsuipc/shadow_memory.h>
+#include <liboac/fsuipc/simulator.h>
+
+namespace oac { namespace fsuipc {
+
+/**
+ * A capture file cannot be open, created or mapped into memory.
+ */
+OAC_DECL_EXCEPTION_WITH_PARAMS(capture_open_error, io_exception,
+   ("cannot open capture file %s: %s", path.string(), reason),
+   (path, boost::filesystem::path),
+   (reason, std::string));
+
+/**
+ * A capture file does not conform the capture format.
+ */
+OAC_DECL_EXCEPTION_WITH_PARAMS(capture_format_error, io_exception,
+   ("invalid capture file %s: %s", path.string(), reason),
+   (path, boost::filesystem::path),
+   (reason, std::string));
+
+/**
+ * The capture format. A capture records the FSUIPC memory as seen by an
+ * update observer, one record per check for updates. The memory is split
+ * into chunks, and each record only contains the chunks which changed.
+ * The first record is a keyframe which also contains every chunk holding
+ * a non-zero byte, so a capture started in the middle of a session is
+ * replayed from zeroed memory with the values the observer had already
+ * read. Each capture begins with the following header.
+ *
+ *   - magic: 8 bytes, "OACFSCAP"
+ *   - version: 32-bits unsigned integer
+ *   - chunk size: 32-bits unsigned integer
+ *
+ * It is followed by the records, each one comprised by:
+ *
+ *   - length: 32-bits unsigned integer, the size of the record in bytes
+ *   - chunk count: 32-bits unsigned integer
+ *   - timestamp: 64-bits unsigned integer, the microseconds since the
+ *     capture began
+ *   - bitmap: a bit for each chunk of memory, set if it is contained
+ *   - data: the content of each contained chunk, in address order
+ *
+ * All integers are little endian. A record length of zero marks the end
+ * of the capture, so a capture which was not properly closed may still be
+ * read.
+ */
+namespace capture_format {
+
+const char MAGIC[] = "OACFSCAP";
+const std::size_t MAGIC_SIZE = 8;
+const std::uint32_t VERSION = 1;
+const std::size_t HEADER_SIZE = 16;
+const std::size_t CHUNK_SIZE = 64;
+const std::size_t CHUNK_COUNT = 0x10000 / CHUNK_SIZE;
+const std::size_t BITMAP_SIZE = CHUNK_COUNT / 8;
+const std::size_t RECORD_HEADER_SIZE = 16;
+
+} // namespace capture_format
+
+/**
+ * A writer of capture files. The file is mapped into memory and records
+ * are appended to it, growing the file as needed. The file is truncated to
+ * the size of its records when the writer is closed or destroyed.
+ */
+class capture_writer
+{
+public:
+
+   typedef boost::chrono::microseconds duration;
+
+   /** The number of bytes the file grows when it is full. */
+   static const std::size_t GROWTH_SIZE;
+
+   /**
+    * Create a new capture file on the given path, replacing any existing
+    * file.
+    */
+   capture_writer(const boost::filesystem::path& path)
+   throw (capture_open_error);
+
+   ~capture_writer();
+
+   /**
+    * Append a record with the changes of the given shadow memory, stamped
+    * with the time passed since the writer was created. The first record
+    * is a keyframe.
+    */
+   void record(shadow_memory& shadow)
+   throw (capture_open_error);
+
+   /**
+    * Append a record with the changes of the given shadow memory, stamped
+    * with the given time.
+    */
+   void record(shadow_memory& shadow, const duration& timestamp)
+   throw (capture_open_error);
+
+   /**
+    * Truncate the file to the size of its records and unmap it. No more
+    * records may be appended after closing.
+    */
+   void close();
+
+   std::size_t record_count() const
+   { return _record_count; }
+
+   /** The number of bytes of the capture written so far. */
+   std::size_t size() const
+   { return _size; }
+
+private:
+
+   boost::filesystem::path _path;
+   boost::interprocess::file_mapping _mapping;
+   boost::interprocess::mapped_region _region;
+   std::size_t _size;
+   std::size_t _capacity;
+   std::size_t _record_count;
+   boost::chrono::steady_clock::time_point _start;
+
+   capture_writer(const capture_writer&);
+   capture_writer& operator = (const capture_writer&);
+
+   void reserve(std::size_t size) throw (capture_open_error);
+
+   void map(std::size_t capacity) throw (capture_open_error);
+
+   std::uint8_t* data()
+   { return static_cast<std::uint8_t*>(_region.get_address()); }
+};
+
+/**
+ * A reader of capture files. The file is mapped into memory, so the
+ * records are read without copying them.
+ */
+class capture_reader
+{
+public:
+
+   typedef boost::chrono::microseconds duration;
+
+   /**
+    * A record of the capture.
+    */
+   struct record
+   {
+      duration timestamp;
+      std::size_t chunk_count;
+      const std::uint8_t* bitmap;
+      const std::uint8_t* data;
+   };
+
+   capture_reader(const boost::filesystem::path& path)
+   throw (capture_open_error, capture_format_error);
+
+   /**
+    * Read the next record of the capture. The record is validated, so its
+    * chunks may be walked without exceeding the capture.
+    *
+    * @return false if the end of the capture was reached
+    */
+   bool next(record& rec) throw (capture_format_error);
+
+   /**
+    * Go back to the first record of the capture.
+    */
+   void rewind()
+   { _position = capture_format::HEADER_SIZE; }
+
+   /**
+    * Execute the given handler for each chunk of the given record, passing
+    * its address and a pointer to its data.
+    */
+   template <typename ChunkHandler>
+   static void for_each_chunk(const record& rec, const ChunkHandler& handler)
+   {
+      auto chunk_data = rec.data;
+      for (std::size_t chunk = 0; chunk < capture_format::CHUNK_COUNT; chunk++)
+      {
+         if (rec.bitmap[chunk / 8] & (1 << (chunk % 8)))
+         {
+            handler(
+                  offset_address(chunk * capture_format::CHUNK_SIZE),
+                  chunk_data);
+            chunk_data += capture_format::CHUNK_SIZE;
+         }
+      }
+   }
+
+private:
+
+   boost::filesystem::path _path;
+   boost::interprocess::file_mapping _mapping;
+   boost::interprocess::mapped_region _region;
+   std::size_t _size;
+   std::size_t _position;
+
+   capture_reader(const capture_reader&);
+   capture_reader& operator = (const capture_reader&);
+
+   const std::uint8_t* data() const
+   { return static_cast<const std::uint8_t*>(_region.get_address()); }
+};
+
+/**
+ * The speed a capture is replayed at.
+ */
+enum class replay_speed
+{
+   /** The records are replayed as time passes, as they were captured. */
+   RECORDED,
+
+   /** A record is replayed on each process() invocation. */
+   UNTHROTTLED
+};
+
+/**
+ * A FsuipcUserAdapter which replays a capture. It behaves as a simulator
+ * whose memory is updated with the records of the capture as process() is
+ * invoked. With no capture open, the memory is left untouched.
+ */
+class replay_user_adapter : public simulator_user_adapter
+{
+public:
+
+   replay_user_adapter();
+
+   /**
+    * Open the given capture to be replayed from its beginning. The memory
+    * is zeroed, as it was when the capture began.
+    */
+   void open(
+         const boost::filesystem::path& path,
+         replay_speed speed = replay_speed::UNTHROTTLED)
+   throw (capture_open_error, capture_format_error);
+
+   /**
+    * Check whether all the records of the capture were replayed.
+    */
+   bool finished() const
+   { return _finished; }
+
+   /**
+    * The number of records replayed so far.
+    */
+   std::size_t replayed_records() const
+   { return _replayed_records; }
+
+   void process();
+
+private:
+
+   std::shared_ptr<capture_reader> _reader;
+   replay_speed _speed;
+   boost::chrono::steady_clock::time_point _start;
+   bool _started;
+   bool _finished;
+   std::size_t _replayed_records;
+
+   /** The record read ahead, not replayed yet. */
+   capture_reader::record _next;
+
+   void read_next();
+
+   void replay_next();
+};
+
+/**
+ * A client for a replayed FSUIPC capture.
+ */
+typedef fsuipc_client<replay_user_adapter> replayed_fsuipc_client;
+
+}} // namespace oac::fsuipc
+
+#endif
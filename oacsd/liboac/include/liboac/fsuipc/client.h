@@ -19,8 +19,11 @@
 #ifndef OAC_FSUIPC_CLIENT_H
 #define OAC_FSUIPC_CLIENT_H
 
+#include <vector>
+
 #include <liboac/fsuipc/local.h>
 #include <liboac/fsuipc/offset.h>
+#include <liboac/fsuipc/read_plan.h>
 
 namespace oac { namespace fsuipc {
 
@@ -36,6 +39,8 @@ namespace oac { namespace fsuipc {
  *
  *   void read(valued_offset&);
  *
+ *   void read_block(offset_address, std::size_t, void*);
+ *
  *   void write(const valued_offset&)
  *
  *   void process()
@@ -45,6 +50,10 @@ namespace oac { namespace fsuipc {
  * valued_offset struct. When process() is invoked, the value is updated
  * using such pointer.
  *
+ * read_block() function schedules a read operation for the given number of
+ * bytes starting at the given address. As read(), it stores the pointer to
+ * the destination, which is filled in when process() is invoked.
+ *
  * write() function schedules a write operation for the given valued offset.
  * It shall not maintain any pointer to the value but copy it, so any subsequent
  * change or destruction in the valued offset passed as argument must be
@@ -136,16 +145,88 @@ public:
       if (offsets.empty())
          return;
 
-      std::list<valued_offset> values;
-      for (auto& offset : offsets)
+      read_plan plan;
+      plan.reset(offsets);
+      query(plan, evaluate);
+   }
+
+   /**
+    * Execute a query on the offsets of the given read plan. The blocks of
+    * the plan are read with a single process() invocation, and then the
+    * evaluate function is executed for each planned offset in address
+    * order. Consider keeping the plan across queries for the same offsets,
+    * since planning requires sorting them.
+    *
+    * @param plan     The plan for the offsets whose value is to be queried
+    * @param evaluate A evaluation function that will be executed with the
+    *                 value of each offset of the plan
+    */
+   template <typename FsuipcValuedOffsetEvaluator>
+   void query(
+         const read_plan& plan,
+         const FsuipcValuedOffsetEvaluator& evaluate)
+   {
+      if (plan.empty())
+         return;
+
+      read_blocks(plan);
+      for (auto& po : plan.offsets())
+         evaluate(valued_offset(
+               po.offset, read_plan::slice(po, _read_buffer.data())));
+   }
+
+   /**
+    * Read the blocks of the given read plan and execute the evaluate
+    * function for each of them in address order, passing the block and a
+    * pointer to its data. This is useful to process the raw bytes read
+    * rather than the value of each planned offset. The data is only valid
+    * during the evaluation.
+    *
+    * @param plan     The plan for the blocks to be read
+    * @param evaluate A evaluation function that will be executed with each
+    *                 block of the plan and its data
+    */
+   template <typename FsuipcBlockEvaluator>
+   void query_blocks(
+         const read_plan& plan,
+         const FsuipcBlockEvaluator& evaluate)
+   {
+      if (plan.empty())
+         return;
+
+      read_blocks(plan);
+      for (auto& block : plan.blocks())
+         evaluate(block, &_read_buffer[block.position]);
+   }
+
+   /**
+    * Update the value for the given offsets and read the blocks of the
+    * given read plan with a single process() invocation. The updates are
+    * scheduled before the reads, so the data passed to the evaluate
+    * function already reflects them.
+    *
+    * @param valued_offsets The valued offsets that are to be updated
+    * @param plan           The plan for the blocks to be read
+    * @param evaluate       A evaluation function that will be executed with
+    *                       each block of the plan and its data
+    */
+   template <typename FsuipcValuedOffsetCollection,
+             typename FsuipcBlockEvaluator>
+   void update_and_query_blocks(
+         const FsuipcValuedOffsetCollection& valued_offsets,
+         const read_plan& plan,
+         const FsuipcBlockEvaluator& evaluate)
+   {
+      if (valued_offsets.empty() && plan.empty())
+         return;
+
+      for (auto& val : valued_offsets)
       {
-         values.push_back(valued_offset(offset, 0));
-         auto& valued_offset = values.back();
-         _user_adapter.read(valued_offset);
+         _user_adapter.write(val);
       }
-      _user_adapter.process();
-      for (auto& val : values)
-         evaluate(val);
+      read_blocks(plan);
+      for (auto& block : plan.blocks())
+         evaluate(block, &_read_buffer[block.position]);
    }
 
    /**
@@ -174,6 +255,20 @@ public:
 private:
 
    FsuipcUserAdapter _user_adapter;
+   std::vector<std::uint8_t> _read_buffer;
+
+   void read_blocks(const read_plan& plan)
+   {
+      // The buffer is resized before scheduling any read, since the user
+      // adapter keeps pointers to it until process() is invoked
+      _read_buffer.resize(plan.buffer_size());
+      for (auto& block : plan.blocks())
+         _user_adapter.read_block(
+               offset_address(block.address),
+               block.length,
+               &_read_buffer[block.position]);
+      _user_adapter.process();
+   }
 };
 
 /**
@@ -184,12 +279,27 @@ class dummy_user_adapter
 {
 public:
 
+   dummy_user_adapter()
+      : _read_count(0),
+        _write_count(0),
+        _process_count(0)
+   {}
+
    void read(valued_offset& valued_offset)
    {
       read_request req = { valued_offset, &valued_offset.value };
       _read_requests.push_back(req);
    }
 
+   void read_block(
+         offset_address address,
+         std::size_t length,
+         void* dst)
+   {
+      block_read_request req = { address, length, dst };
+      _block_read_requests.push_back(req);
+   }
+
    void write(const valued_offset& valued_offset)
    {
       write_request req = { valued_offset };
@@ -198,6 +308,7 @@ public:
 
    void process()
    {
+      _process_count++;
       process_write_requests();
       process_read_requests();
    }
@@ -211,6 +322,24 @@ public:
          offset_length len,
          offset_value val);
 
+   /**
+    * The number of read and block read requests processed so far.
+    */
+   std::size_t read_count() const
+   { return _read_count; }
+
+   /**
+    * The number of write requests processed so far.
+    */
+   std::size_t write_count() const
+   { return _write_count; }
+
+   /**
+    * The number of times process() was invoked so far.
+    */
+   std::size_t process_count() const
+   { return _process_count; }
+
 private:
 
    struct read_request
@@ -219,6 +348,13 @@ private:
       offset_value* value;
    };
 
+   struct block_read_request
+   {
+      offset_address address;
+      std::size_t length;
+      void* dst;
+   };
+
    struct write_request
    {
       valued_offset offset;
@@ -226,7 +362,11 @@ private:
 
    std::uint8_t _buffer[0xffff];
    std::list<read_request> _read_requests;
+   std::list<block_read_request> _block_read_requests;
    std::list<write_request> _write_requests;
+   std::size_t _read_count;
+   std::size_t _write_count;
+   std::size_t _process_count;
 
    void process_read_requests();
 
@@ -49,6 +49,12 @@ public:
    void read(valued_offset& valued_offset)
    throw (fsuipc_error);
 
+   void read_block(
+         offset_address address,
+         std::size_t length,
+         void* dst)
+   throw (fsuipc_error);
+
    void write(const valued_offset& valued_offset)
    throw (fsuipc_error);
 
@@ -0,0 +1,155 @@
+/*
+ * This file is part of Open Airbus Cockpit
+ * Copyright (C) 2012, 2013 Alvaro Polo
+ *
+ * Open Airbus Cockpit is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Open Airbus Cockpit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Open Airbus Cockpit. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OAC_FSUIPC_READ_PLAN_H
+#define OAC_FSUIPC_READ_PLAN_H
+
+#include <cstdint>
+#include <vector>
+
+#include <liboac/fsuipc/offset.h>
+
+namespace oac { namespace fsuipc {
+
+/**
+ * A plan to read a collection of offsets with as few FSUIPC read requests
+ * as possible. Adjacent and overlapping offsets are merged into contiguous
+ * blocks of memory, and so are the offsets separated by a gap not greater
+ * than the gap tolerance. Reading a few useless bytes is cheaper than
+ * issuing a new request, since each one carries its own header in the
+ * FSUIPC IPC buffer.
+ *
+ * The blocks are read into a single buffer, one after the other, and then
+ * the value of each offset is sliced out from it.
+ */
+class read_plan
+{
+public:
+
+   static const std::size_t DEFAULT_GAP_TOLERANCE;
+
+   /**
+    * A contiguous block of FSUIPC memory to be read at once.
+    */
+   struct block
+   {
+      /** The address of the first byte of the block. */
+      std::uint32_t address;
+
+      /** The number of bytes of the block. */
+      std::size_t length;
+
+      /** The position of the block in the read buffer. */
+      std::size_t position;
+   };
+
+   /**
+    * An offset of the plan and the position of its value in the read buffer.
+    */
+   struct planned_offset
+   {
+      fsuipc::offset offset;
+      std::size_t position;
+   };
+
+   read_plan(std::size_t gap_tolerance = DEFAULT_GAP_TOLERANCE)
+      : _gap_tolerance(gap_tolerance),
+        _buffer_size(0)
+   {}
+
+   std::size_t gap_tolerance() const
+   { return _gap_tolerance; }
+
+   /**
+    * Set the gap tolerance. It takes effect on the next reset.
+    */
+   void set_gap_tolerance(std::size_t gap_tolerance)
+   { _gap_tolerance = gap_tolerance; }
+
+   /**
+    * Plan the reading of the given offsets, discarding the previous plan.
+    */
+   template <typename FsuipcOffsetCollection>
+   void reset(const FsuipcOffsetCollection& offsets)
+   {
+      _offsets.clear();
+      for (auto& o : offsets)
+      {
+         planned_offset po = { o, 0 };
+         _offsets.push_back(po);
+      }
+      build();
+   }
+
+   bool empty() const
+   { return _offsets.empty(); }
+
+   /**
+    * The blocks to be read, sorted by address.
+    */
+   const std::vector<block>& blocks() const
+   { return _blocks; }
+
+   /**
+    * The planned offsets, sorted by address. Repeated offsets are removed.
+    */
+   const std::vector<planned_offset>& offsets() const
+   { return _offsets; }
+
+   /**
+    * The number of bytes needed to hold all the blocks.
+    */
+   std::size_t buffer_size() const
+   { return _buffer_size; }
+
+   /**
+    * Obtain the value of the given planned offset from the read buffer.
+    * FSUIPC memory is little endian, as the offset values read from it.
+    */
+   static offset_value slice(
+         const planned_offset& po,
+         const std::uint8_t* buffer)
+   {
+      auto data = buffer + po.position;
+      offset_value value = 0;
+      switch (po.offset.length)
+      {
+         case OFFSET_LEN_DWORD:
+            value |= offset_value(data[3]) << 24;
+            value |= offset_value(data[2]) << 16;
+         case OFFSET_LEN_WORD:
+            value |= offset_value(data[1]) << 8;
+         case OFFSET_LEN_BYTE:
+            value |= offset_value(data[0]);
+      }
+      return value;
+   }
+
+private:
+
+   std::size_t _gap_tolerance;
+   std::vector<planned_offset> _offsets;
+   std::vector<block> _blocks;
+   std::size_t _buffer_size;
+
+   void build();
+};
+
+}} // namespace oac::fsuipc
+
+#endif
@@ -0,0 +1,104 @@
+/*
+ * This file is part of Open Airbus Cockpit
+ * Copyright (C) 2012, 2013 Alvaro Polo
+ *
+ * Open Airbus Cockpit is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Open Airbus Cockpit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Open Airbus Cockpit. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OAC_FSUIPC_SHADOW_MEMORY_H
+#define OAC_FSUIPC_SHADOW_MEMORY_H
+
+#include <cstdint>
+#include <vector>
+
+#include <liboac/fsuipc/offset.h>
+
+namespace oac { namespace fsuipc {
+
+/**
+ * A flat image of the FSUIPC address space used to detect changes. Fresh
+ * data read from FSUIPC is compared against the image a machine word at a
+ * time, and the bytes that differ are marked as dirty and recorded as
+ * changed ranges. Thus, detecting changes is linear in the number of bytes
+ * read and requires no hashing at all.
+ *
+ * Changes accumulate until clear_changes() is invoked.
+ */
+class shadow_memory
+{
+public:
+
+   /** The size of the FSUIPC address space. */
+   static const std::size_t SIZE;
+
+   /**
+    * A range of changed bytes, from begin (inclusive) to end (exclusive).
+    */
+   struct range
+   {
+      std::uint32_t begin;
+      std::uint32_t end;
+   };
+
+   shadow_memory();
+
+   /**
+    * Compare the given data with the image at the given address, marking
+    * the bytes that differ as changed, and store it in the image.
+    */
+   void update(
+         std::uint32_t address,
+         const std::uint8_t* data,
+         std::size_t length);
+
+   /**
+    * Obtain the raw bytes of the image.
+    */
+   const std::uint8_t* data() const
+   { return _image.data(); }
+
+   /**
+    * Obtain the value of the given offset from the image.
+    */
+   offset_value read(const offset& o) const;
+
+   /**
+    * Check whether any byte of the given offset changed.
+    */
+   bool is_dirty(const offset& o) const;
+
+   /**
+    * The ranges of changed bytes, sorted by address. Adjacent ranges are
+    * merged.
+    */
+   const std::vector<range>& changes();
+
+   /**
+    * Forget the changes detected so far.
+    */
+   void clear_changes();
+
+private:
+
+   std::vector<std::uint8_t> _image;
+   std::vector<std::uint64_t> _dirty;
+   std::vector<range> _changes;
+   bool _changes_sorted;
+
+   void mark_changed(std::uint32_t address);
+};
+
+}} // namespace oac::fsuipc
+
+#endif
@@ -0,0 +1,243 @@
+/*
+ * This file is part of Open Airbus Cockpit
+ * Copyright (C) 2012, 2013 Alvaro Polo
+ *
+ * Open Airbus Cockpit is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Open Airbus Cockpit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Open Airbus Cockpit. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OAC_FSUIPC_SIMULATOR_H
+#define OAC_FSUIPC_SIMULATOR_H
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <boost/chrono.hpp>
+
+#include <liboac/fsuipc/client.h>
+#include <liboac/fsuipc/offset.h>
+
+namespace oac { namespace fsuipc {
+
+/**
+ * A FsuipcUserAdapter which simulates FSUIPC in memory. It may be used to
+ * benchmark the code that relies on FSUIPC without a running simulator.
+ *
+ * The value of each offset may follow a dynamic: a ramp, some noise around
+ * a center value or a sequence of steps. Each dynamic changes the value of
+ * its offset once every period of simulated time. The simulated time only
+ * advances when advance() is invoked or, if a time step is set, on each
+ * process() invocation. Since the noise is produced by a seeded generator,
+ * a simulation is fully deterministic.
+ *
+ * Requests are processed in the order they were scheduled, as FSUIPC does.
+ * Each process() invocation may take an IPC latency to model the cost of a
+ * round trip to FSUIPC.
+ */
+class simulator_user_adapter
+{
+public:
+
+   /**
+    * The duration type used for simulated time and latencies.
+    */
+   typedef boost::chrono::microseconds duration;
+
+   static const std::uint32_t DEFAULT_SEED;
+
+   simulator_user_adapter(std::uint32_t seed = DEFAULT_SEED);
+
+   /**
+    * Set the current value of the given offset.
+    */
+   void set_value(const offset& o, offset_value value);
+
+   /**
+    * Set the content of the memory at the given address. The bytes beyond
+    * the FSUIPC address space are ignored.
+    */
+   void set_block(
+         offset_address address,
+         const void* data,
+         std::size_t length);
+
+   /**
+    * Obtain the current value of the given offset.
+    */
+   offset_value get_value(const offset& o) const;
+
+   /**
+    * Make the given offset move from one value to another by the given
+    * step once every period. When the target value is exceeded, the ramp
+    * starts over from the initial value.
+    */
+   void add_ramp(
+         const offset& o,
+         offset_value from,
+         offset_value to,
+         offset_value step,
+         const duration& period);
+
+   /**
+    * Make the given offset take a random value within the given amplitude
+    * around a center value once every period.
+    */
+   void add_noise(
+         const offset& o,
+         offset_value center,
+         offset_value amplitude,
+         const duration& period);
+
+   /**
+    * Make the given offset take the given values in turn, one every period.
+    */
+   void add_steps(
+         const offset& o,
+         const std::vector<offset_value>& values,
+         const duration& period);
+
+   /**
+    * Remove all the dynamics of the given offset, so it keeps its value.
+    */
+   void remove_dynamics(const offset& o);
+
+   /**
+    * Set the time each process() invocation takes to complete.
+    */
+   void set_ipc_latency(const duration& latency)
+   { _ipc_latency = latency; }
+
+   /**
+    * Set the simulated time that passes on each process() invocation.
+    */
+   void set_time_step(const duration& step)
+   { _time_step = step; }
+
+   /**
+    * Advance the simulated time, applying the dynamics of the offsets.
+    */
+   void advance(const duration& elapsed);
+
+   /**
+    * The simulated time passed since the adapter was created.
+    */
+   const duration& now() const
+   { return _now; }
+
+   void read(valued_offset& valued_offset);
+
+   void read_block(
+         offset_address address,
+         std::size_t length,
+         void* dst);
+
+   void write(const valued_offset& valued_offset);
+
+   void process();
+
+   /**
+    * The number of process() invocations so far.
+    */
+   std::size_t process_count() const
+   { return _process_count; }
+
+   /**
+    * The number of read and block read requests processed so far.
+    */
+   std::size_t read_count() const
+   { return _read_count; }
+
+   /**
+    * The number of write requests processed so far.
+    */
+   std::size_t write_count() const
+   { return _write_count; }
+
+private:
+
+   enum class dynamic_kind
+   {
+      RAMP,
+      NOISE,
+      STEPS
+   };
+
+   struct dynamic
+   {
+      offset target;
+      dynamic_kind kind;
+      duration period;
+      duration next_change;
+      std::int64_t from;
+      std::int64_t to;
+      std::int64_t step;
+      std::vector<offset_value> values;
+      std::size_t next_value;
+
+      dynamic(
+            const offset& o,
+            dynamic_kind k,
+            const duration& p,
+            const duration& now)
+         : target(o),
+           kind(k),
+           period(p),
+           next_change(now + p),
+           from(0),
+           to(0),
+           step(0),
+           next_value(0)
+      {}
+   };
+
+   enum class request_kind
+   {
+      READ,
+      READ_BLOCK,
+      WRITE
+   };
+
+   struct request
+   {
+      request_kind kind;
+      offset_address address;
+      std::size_t length;
+      void* dst;
+      offset_value value;
+   };
+
+   std::vector<std::uint8_t> _memory;
+   std::vector<dynamic> _dynamics;
+   std::vector<request> _requests;
+   std::mt19937 _random;
+   duration _now;
+   duration _time_step;
+   duration _ipc_latency;
+   std::size_t _process_count;
+   std::size_t _read_count;
+   std::size_t _write_count;
+
+   void add_dynamic(const dynamic& d);
+
+   void apply(dynamic& d);
+};
+
+/**
+ * A client for a simulated FSUIPC.
+ */
+typedef fsuipc_client<simulator_user_adapter> simulated_fsuipc_client;
+
+}} // namespace oac::fsuipc
+
+#endif
@@ -19,11 +19,15 @@
 #ifndef OAC_FSUIPC_UPDATE_OBSERVER_H
 #define OAC_FSUIPC_UPDATE_OBSERVER_H
 
+#include <algorithm>
 #include <functional>
-#include <unordered_map>
-#include <unordered_set>
+#include <limits>
+#include <mutex>
+#include <vector>
 
 #include <liboac/fsuipc/offset.h>
+#include <liboac/fsuipc/read_plan.h>
+#include <liboac/fsuipc/shadow_memory.h>
 
 namespace oac { namespace fsuipc {
 
@@ -34,6 +38,28 @@ namespace oac { namespace fsuipc {
  * invoked, a evaluation function will be called for each offset which value
  * has changed. The check_for_updates() function may be bound to a
  * ticks_observer to have a regular observation of FSUIPC offsets.
+ *
+ * The observed offsets are read using a read plan, so they are coalesced
+ * into a few block reads. The plan is only rebuilt when the set of observed
+ * offsets changes.
+ *
+ * The blocks read are compared against a shadow memory holding the bytes
+ * read in the previous check. Only the observed offsets overlapping the
+ * changed bytes are evaluated, so detecting updates is linear in the number
+ * of bytes read rather than in the number of observed offsets.
+ *
+ * Writes are queued and sent to FSUIPC on the next check for updates, in
+ * the same round trip as its reads. The write queue has its own lock, so
+ * write() and get_write_stats() may be invoked from any thread while
+ * another one checks for updates. The rest of the members must be
+ * serialized by the caller.
+ *
+ * The observer may poll offsets at different rates according to a polling
+ * policy. Offsets that change often are hot, and they are read on each
+ * check. Offsets that do not change for a while become cold, and they are
+ * only read once every several checks. A cold offset becomes hot as soon as
+ * a change is detected on it. By default, all offsets are read on each
+ * check.
  */
 template <typename FsuipcUserAdapter,
           typename FsuipcValuedOffsetEvaluator =
@@ -45,6 +71,65 @@ public:
    typedef fsuipc_client<FsuipcUserAdapter> client_type;
    typedef FsuipcValuedOffsetEvaluator update_evaluator_type;
 
+   /**
+    * A function invoked after each check for updates with the shadow
+    * memory, whose changes are those detected in that check.
+    */
+   typedef std::function<void(shadow_memory&)> check_handler_type;
+
+   /**
+    * Statistics on the writes requested to the observer.
+    */
+   struct write_stats
+   {
+      /** The writes sent to FSUIPC along with the reads of a check. */
+      std::size_t batched;
+
+      /** The writes replaced by a later one on the same offset. */
+      std::size_t overwritten;
+
+      /** The writes dropped since they matched the current offset value. */
+      std::size_t suppressed;
+
+      write_stats() : batched(0), overwritten(0), suppressed(0) {}
+   };
+
+   /**
+    * The policy used to decide how often the observed offsets are read.
+    */
+   struct polling_policy
+   {
+      /** The number of checks between two reads of cold offsets. */
+      std::size_t cold_period;
+
+      /** The number of checks without changes for an offset to get cold. */
+      std::size_t cooldown;
+
+      polling_policy(std::size_t cold = 1, std::size_t cool = 0)
+         : cold_period(std::max<std::size_t>(cold, 1)), cooldown(cool)
+      {}
+
+      bool is_adaptive() const
+      { return cold_period > 1; }
+   };
+
+   /**
+    * Statistics on the polling of observed offsets.
+    */
+   struct polling_stats
+   {
+      /** The observed offsets which are read on each check. */
+      std::size_t hot_offsets;
+
+      /** The observed offsets which are read once every cold period. */
+      std::size_t cold_offsets;
+
+      /** The checks which only read hot offsets. */
+      std::size_t hot_checks;
+
+      polling_stats() : hot_offsets(0), cold_offsets(0), hot_checks(0) {}
+   };
+
    /**
     * Create a new observer for given evaluation function and FSUIPC client.
     *
@@ -55,11 +140,101 @@ public:
     */
    update_observer(
             const update_evaluator_type& update_eval = update_evaluator_type(),
-            const client_type& client = client_type())
+            const client_type& client = client_type(),
+            std::size_t gap_tolerance = read_plan::DEFAULT_GAP_TOLERANCE)
       : _client(client),
+        _plan(gap_tolerance),
+        _plan_outdated(false),
+        _hot_plan(gap_tolerance),
+        _hot_plan_outdated(false),
+        _checks(0),
+        _hot_checks(0),
         _update_eval(update_eval)
    {}
 
+   /**
+    * Set the maximum number of unobserved bytes between two observed
+    * offsets for them to be read in the same block.
+    */
+   void set_gap_tolerance(std::size_t gap_tolerance)
+   {
+      _plan.set_gap_tolerance(gap_tolerance);
+      _hot_plan.set_gap_tolerance(gap_tolerance);
+      _plan_outdated = true;
+      _hot_plan_outdated = true;
+   }
+
+   /**
+    * Set the policy used to decide how often the offsets are read.
+    */
+   void set_polling_policy(const polling_policy& policy)
+   {
+      _policy = policy;
+      reclassify();
+   }
+
+   const polling_policy& get_polling_policy() const
+   { return _policy; }
+
+   /**
+    * Set the maximum number of checks between two reads of the given
+    * offset. If it is lower than the cold period of the polling policy, the
+    * offset is always hot. If the offset is not observed, nothing is done.
+    *
+    * @param o      The observed offset
+    * @param checks The maximum number of checks between two reads, or the
+    *               maximum size_t value to remove the limit
+    */
+   void set_max_polling_period(const offset& o, std::size_t checks)
+   {
+      auto entry = find_observed(o);
+      if (entry == _observed.end())
+         return;
+      entry->max_period = checks;
+      if (!entry->hot && is_pinned(*entry))
+      {
+         entry->hot = true;
+         _hot_plan_outdated = true;
+      }
+   }
+
+   /**
+    * Set the handler invoked after each check for updates, e.g. to record
+    * the changes. An empty handler removes the current one.
+    */
+   void set_check_handler(const check_handler_type& handler)
+   { _check_handler = handler; }
+
+   /**
+    * Obtain the statistics on the polling of observed offsets.
+    */
+   polling_stats get_polling_stats() const
+   {
+      polling_stats stats;
+      for (auto& entry : _observed)
+         (entry.hot ? stats.hot_offsets : stats.cold_offsets)++;
+      stats.hot_checks = _hot_checks;
+      return stats;
+   }
+
+   /**
+    * Obtain the read plan used to check for updates.
+    */
+   const read_plan& get_read_plan()
+   {
+      update_plan();
+      return _plan;
+   }
+
+   /**
+    * Obtain the statistics on the writes requested so far.
+    */
+   write_stats get_write_stats() const
+   {
+      std::lock_guard<std::mutex> lock(_writes_mutex);
+      return _write_stats;
+   }
+
    const client_type& get_client() const
    { return _client; }
 
@@ -88,14 +263,30 @@ public:
    template <typename FsuipcOffsetCollection>
    void start_observing(const FsuipcOffsetCollection& offsets)
    {
+      if (offsets.empty())
+         return;
+
       for (auto& offset : offsets) {
-         _offsets.insert(offset);      
-         _pending_welcomes.insert(offset);
+         // New offsets are hot until they prove to be quiet
+         auto entry = lower_bound_observed(offset);
+         if (entry == _observed.end() || !(*entry == offset))
+            _observed.insert(entry, observed_offset(offset, _checks));
+         else
+            entry->last_change = _checks;
+         if (std::find(
+               _pending_welcomes.begin(),
+               _pending_welcomes.end(),
+               offset) == _pending_welcomes.end())
+            _pending_welcomes.push_back(offset);
       }
-      _client.query(offsets, [this](const valued_offset& val)
-      {
-         _values[val] = val.value;
-      });
+      _plan_outdated = true;
+      _hot_plan_outdated = true;
+
+      // The bytes that changed since the last check are recorded by the
+      // shadow memory, so they are still notified on the next check
+      read_plan plan(_plan.gap_tolerance());
+      plan.reset(offsets);
+      update_shadow(plan);
    }
 
    /**
@@ -106,7 +297,68 @@ public:
     */
    void stop_observing(const offset& offset)
    {
-      _offsets.erase(offset);
+      auto entry = find_observed(offset);
+      if (entry != _observed.end())
+      {
+         _observed.erase(entry);
+         _plan_outdated = true;
+         _hot_plan_outdated = true;
+      }
+   }
+
+   /**
+    * Stop observing the given offsets. The offsets which were not observed
+    * are ignored.
+    *
+    * @param offsets The offsets that must not be observed anymore
+    */
+   template <typename FsuipcOffsetCollection>
+   void stop_observing(const FsuipcOffsetCollection& offsets)
+   {
+      std::vector<offset> sorted(offsets.begin(), offsets.end());
+      std::sort(sorted.begin(), sorted.end(), &update_observer::offset_less);
+      auto end = std::remove_if(
+            _observed.begin(),
+            _observed.end(),
+            [&sorted](const observed_offset& o)
+            {
+               return std::binary_search(
+                     sorted.begin(),
+                     sorted.end(),
+                     o,
+                     &update_observer::offset_less);
+            });
+      if (end != _observed.end())
+      {
+         _observed.erase(end, _observed.end());
+         _plan_outdated = true;
+         _hot_plan_outdated = true;
+      }
+   }
+
+   /**
+    * Write the given value on its offset. The write is queued until the
+    * next call to check_for_updates(). If the offset is written again
+    * before that, only the last value is written. If the offset is hot and
+    * the value matches its current one by the time of the check, the write
+    * is dropped. Cold offsets are not read on each check, so their current
+    * value is not known. This function may be invoked from any thread.
+    *
+    * @param val The offset to be written and its new value
+    */
+   void write(const valued_offset& val)
+   {
+      std::lock_guard<std::mutex> lock(_writes_mutex);
+      auto pending = std::find_if(
+            _pending_writes.begin(),
+            _pending_writes.end(),
+            [&val](const valued_offset& w) { return w == val; });
+      if (pending != _pending_writes.end())
+      {
+         _pending_writes.erase(pending);
+         _write_stats.overwritten++;
+      }
+      _pending_writes.push_back(val);
    }
 
    /**
@@ -122,35 +374,256 @@ public:
     *
     * If the offset is considered updated, the evaluation function passed to
     * the constructor is invoked with the new offset value as argument.
+    *
+    * The writes queued since the last check are sent before the offsets
+    * are read. Cold offsets are only read once every cold period.
     */
    void check_for_updates()
    {
-      _client.query(_offsets, [this](const valued_offset& val)
+      // The write queue is taken at once, so writes requested from now on
+      // are left for the next check
       {
-         auto cached_val = _values.find(val);
-         auto pending_welcome = _pending_welcomes.find(val);
+         std::lock_guard<std::mutex> lock(_writes_mutex);
+         _batched_writes.swap(_pending_writes);
+      }
+      auto suppressed = suppress_current_values(_batched_writes);
 
-         if ((pending_welcome != _pending_welcomes.end()) ||
-             (cached_val->second != val.value))
+      // The pending writes are sent in the same round trip as the reads
+      _checks++;
+      auto cold_check = (_checks % _policy.cold_period) == 0;
+      update_plan();
+      if (!cold_check)
+      {
+         update_hot_plan();
+         _hot_checks++;
+      }
+      _client.update_and_query_blocks(
+            _batched_writes, cold_check ? _plan : _hot_plan, [this](
+            const read_plan::block& block, const std::uint8_t* data)
+      {
+         _shadow.update(block.address, data, block.length);
+      });
+      {
+         std::lock_guard<std::mutex> lock(_writes_mutex);
+         _write_stats.batched += _batched_writes.size();
+         _write_stats.suppressed += suppressed;
+      }
+      _batched_writes.clear();
+
+      // Both the changed ranges and the planned offsets are sorted by
+      // address, so they are walked together. An offset overlapping a range
+      // starts at most a double word before it. All the observed offsets are
+      // walked, since a cold one may be read as part of a hot block.
+      auto& planned = _plan.offsets();
+      auto next = planned.begin();
+      for (auto& range : _shadow.changes())
+      {
+         std::uint32_t first = range.begin < OFFSET_LEN_DWORD
+               ? 0 : range.begin - OFFSET_LEN_DWORD + 1;
+         next = std::lower_bound(
+               next,
+               planned.end(),
+               first,
+               [](const read_plan::planned_offset& po, std::uint32_t addr)
+               { return po.offset.address < addr; });
+         for (; next != planned.end() && next->offset.address < range.end;
+              ++next)
          {
-            _values[val] = val.value;
-            _update_eval(val);
+            if (_shadow.is_dirty(next->offset))
+            {
+               touch(next->offset);
+               evaluate(next->offset);
+            }
          }
-      });
+      }
+
+      // Welcomed offsets that changed were already evaluated above
+      for (auto& offset : _pending_welcomes)
+      {
+         if (find_observed(offset) != _observed.end() &&
+             !_shadow.is_dirty(offset))
+            evaluate(offset);
+      }
+
+      // A failing handler must not leave these changes for the next check
+      if (_check_handler)
+      {
+         try { _check_handler(_shadow); }
+         catch (...)
+         {
+            _shadow.clear_changes();
+            _pending_welcomes.clear();
+            throw;
+         }
+      }
+
+      _shadow.clear_changes();
       _pending_welcomes.clear();
+
+      if (cold_check && _policy.is_adaptive())
+         reclassify();
    }
 
 private:
 
-   typedef std::unordered_set<offset, offset::hash> offset_set;
-   typedef std::unordered_map<
-         offset, offset_value, offset::hash> offset_value_map;
+   /**
+    * An observed offset and its polling state.
+    */
+   struct observed_offset : offset
+   {
+      std::size_t last_change;
+      std::size_t max_period;
+      bool hot;
+
+      observed_offset(const offset& o, std::size_t check)
+         : offset(o),
+           last_change(check),
+           max_period(std::numeric_limits<std::size_t>::max()),
+           hot(true)
+      {}
+   };
+
+   /**
+    * The observed offsets, sorted by address and length.
+    */
+   typedef std::vector<observed_offset> observed_offset_list;
 
    client_type _client;
-   offset_set _offsets;
-   offset_set _pending_welcomes;
-   offset_value_map _values;
+   read_plan _plan;
+   bool _plan_outdated;
+   read_plan _hot_plan;
+   bool _hot_plan_outdated;
+   polling_policy _policy;
+   std::size_t _checks;
+   std::size_t _hot_checks;
+   observed_offset_list _observed;
+   std::vector<offset> _pending_welcomes;
+   std::vector<valued_offset> _pending_writes;
+   std::vector<valued_offset> _batched_writes;
+   write_stats _write_stats;
+   mutable std::mutex _writes_mutex;
+   shadow_memory _shadow;
    update_evaluator_type _update_eval;
+   check_handler_type _check_handler;
+
+   /**
+    * Remove the writes on hot offsets whose value matches the current one
+    * from the given list, and obtain how many were removed.
+    */
+   std::size_t suppress_current_values(std::vector<valued_offset>& writes)
+   {
+      auto end = std::remove_if(
+            writes.begin(),
+            writes.end(),
+            [this](const valued_offset& val) -> bool
+            {
+               auto mask = val.length == OFFSET_LEN_DWORD
+                     ? offset_value(0xffffffff)
+                     : (offset_value(1) << (8 * val.length)) - 1;
+               auto entry = find_observed(val);
+               return entry != _observed.end() && entry->hot &&
+                     _shadow.read(val) == (val.value & mask);
+            });
+      auto suppressed = std::size_t(writes.end() - end);
+      writes.erase(end, writes.end());
+      return suppressed;
+   }
+
+   void update_plan()
+   {
+      if (_plan_outdated)
+      {
+         _plan.reset(_observed);
+         _plan_outdated = false;
+      }
+   }
+
+   void update_hot_plan()
+   {
+      if (_hot_plan_outdated)
+      {
+         std::vector<offset> hot;
+         for (auto& entry : _observed)
+            if (entry.hot)
+               hot.push_back(entry);
+         _hot_plan.reset(hot);
+         _hot_plan_outdated = false;
+      }
+   }
+
+   static bool offset_less(const offset& lhs, const offset& rhs)
+   {
+      return lhs.address < rhs.address ||
+             (lhs.address == rhs.address && lhs.length < rhs.length);
+   }
+
+   typename observed_offset_list::iterator lower_bound_observed(
+         const offset& o)
+   {
+      return std::lower_bound(
+            _observed.begin(),
+            _observed.end(),
+            o,
+            &update_observer::offset_less);
+   }
+
+   typename observed_offset_list::iterator find_observed(const offset& o)
+   {
+      auto entry = lower_bound_observed(o);
+      return (entry != _observed.end() && *entry == o)
+            ? entry : _observed.end();
+   }
+
+   bool is_pinned(const observed_offset& entry) const
+   { return entry.max_period < _policy.cold_period; }
+
+   /**
+    * Record a change on the given offset, which makes it hot.
+    */
+   void touch(const offset& o)
+   {
+      auto entry = find_observed(o);
+      if (entry == _observed.end())
+         return;
+      entry->last_change = _checks;
+      if (!entry->hot)
+      {
+         entry->hot = true;
+         _hot_plan_outdated = true;
+      }
+   }
+
+   /**
+    * Classify the observed offsets as hot or cold according to the checks
+    * passed since their last change.
+    */
+   void reclassify()
+   {
+      for (auto& entry : _observed)
+      {
+         auto hot = !_policy.is_adaptive() || is_pinned(entry) ||
+               _checks - entry.last_change < _policy.cooldown;
+         if (hot != entry.hot)
+         {
+            entry.hot = hot;
+            _hot_plan_outdated = true;
+         }
+      }
+   }
+
+   void update_shadow(const read_plan& plan)
+   {
+      _client.query_blocks(plan, [this](
+            const read_plan::block& block, const std::uint8_t* data)
+      {
+         _shadow.update(block.address, data, block.length);
+      });
+   }
+
+   void evaluate(const offset& o)
+   {
+      _update_eval(valued_offset(o, _shadow.read(o)));
+   }
 };
 
 }} // namespace oac::fsuipc
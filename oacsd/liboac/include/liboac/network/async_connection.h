@@ -115,6 +115,24 @@ public:
    template <typename StreamBuffer>
    std::future<std::size_t> write(StreamBuffer& buff);
 
+   /**
+    * Write all the bytes of the given buffer sequence to this connection.
+    * The buffers are gathered, so the data of several of them may be sent
+    * in a single system call. The given WriteHandler will be invoked once
+    * every byte is transferred or an error occurs. This function is not
+    * blocking, so the control will be immediately returned to the caller.
+    * The caller must keep the memory referenced by the buffer sequence
+    * valid and must not initiate another write until the handler is
+    * invoked.
+    *
+    * @param buffers The sequence of const buffers to be written, which
+    *                conforms the Boost ConstBufferSequence concept
+    * @param handler The handler that will be invoked once all data is
+    *                written. It conforms the AsyncWriteHandler concept.
+    */
+   template <typename ConstBufferSequence, typename AsyncWriteHandler>
+   void write_all(const ConstBufferSequence& buffers, AsyncWriteHandler handler);
+
 private:
 
    socket_ptr _socket;
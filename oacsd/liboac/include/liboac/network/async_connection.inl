@@ -19,6 +19,9 @@
 #ifndef OAC_NETWORK_ASYNC_CONNECTION_INL
 #define OAC_NETWORK_ASYNC_CONNECTION_INL
 
+#include <boost/asio/write.hpp>
+
+#include <liboac/buffer/asio_handler.h>
 #include <liboac/buffer/functions.h>
 #include <liboac/network/async_connection.h>
 
@@ -111,6 +114,18 @@ async_tcp_connection::write(StreamBuffer& buff)
    return fut;
 }
 
+template <typename ConstBufferSequence, typename AsyncWriteHandler>
+void
+async_tcp_connection::write_all(
+      const ConstBufferSequence& buffers,
+      AsyncWriteHandler handler)
+{
+   boost::asio::async_write(
+         *_socket,
+         buffers,
+         buffer::make_io_handler(handler, [](std::size_t) {}));
+}
+
 inline
 void
 async_tcp_connection::on_io_completed_with_promise(
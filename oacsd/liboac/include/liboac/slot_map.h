@@ -0,0 +1,219 @@
+/*
+ * This file is part of Open Airbus Cockpit
+ * Copyright (C) 2012, 2013 Alvaro Polo
+ *
+ * Open Airbus Cockpit is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Open Airbus Cockpit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Open Airbus Cockpit. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OAC_SLOT_MAP_H
+#define OAC_SLOT_MAP_H
+
+#include <cstdint>
+#include <vector>
+
+#include <boost/optional.hpp>
+
+#include "liboac/exception.h"
+
+namespace oac {
+
+/**
+ * An exception indicating that a slot map has no free slot left.
+ */
+OAC_DECL_EXCEPTION_WITH_PARAMS(slot_map_full_error, oac::exception,
+   ("slot map is full (%d slots in use)", capacity),
+   (capacity, std::size_t));
+
+/**
+ * A container which issues its own keys for the values inserted on it.
+ *
+ * The values are stored in a vector of slots, and the key of a value
+ * comprises the index of its slot and the generation of that slot. Thus,
+ * looking up a value is just an array access followed by a comparison, with
+ * no hashing nor node allocation involved. When a value is erased, the
+ * generation of its slot is increased, so the old key is detected as stale
+ * even after the slot is reused by a new value. Free slots are reused in
+ * the same order they were released, so the generation of a given slot
+ * wraps around only after it was reused 65535 times.
+ *
+ * Key zero is never issued, so it may be used as a null key.
+ */
+template <typename T>
+class slot_map
+{
+public:
+
+   typedef std::uint32_t key_type;
+   typedef T value_type;
+
+   /** The number of bits of the key used to index the slot. */
+   static const unsigned INDEX_BITS = 16;
+
+   /** The maximum number of values stored at the same time. */
+   static const std::size_t MAX_SIZE = std::size_t(1) << INDEX_BITS;
+
+   slot_map()
+      : _size(0),
+        _free_head(NO_SLOT),
+        _free_tail(NO_SLOT)
+   {}
+
+   /**
+    * Insert a new value, returning the key issued for it.
+    */
+   key_type insert(const T& value)
+   throw (slot_map_full_error)
+   {
+      std::uint32_t index;
+      if (_free_head != NO_SLOT)
+      {
+         index = _free_head;
+         _free_head = _slots[index].next_free;
+         if (_free_head == NO_SLOT)
+            _free_tail = NO_SLOT;
+      }
+      else
+      {
+         if (_slots.size() >= MAX_SIZE)
+            OAC_THROW_EXCEPTION(slot_map_full_error(_slots.size()));
+         index = std::uint32_t(_slots.size());
+         _slots.push_back(slot(make_key(1, index)));
+      }
+      auto& s = _slots[index];
+      s.value = value;
+      _size++;
+      return s.key;
+   }
+
+   /**
+    * Obtain the value for given key, or null if the key is unknown or stale.
+    */
+   T* find(key_type key)
+   {
+      auto s = find_slot(key);
+      return s ? s->value.get_ptr() : nullptr;
+   }
+
+   const T* find(key_type key) const
+   {
+      auto s = const_cast<slot_map*>(this)->find_slot(key);
+      return s ? s->value.get_ptr() : nullptr;
+   }
+
+   bool contains(key_type key) const
+   { return find(key) != nullptr; }
+
+   /**
+    * Erase the value for given key. It returns false if the key is unknown
+    * or stale.
+    */
+   bool erase(key_type key)
+   {
+      auto s = find_slot(key);
+      if (!s)
+         return false;
+      release(*s);
+      return true;
+   }
+
+   /**
+    * Erase all the values. Their keys become stale.
+    */
+   void clear()
+   {
+      for (auto& s : _slots)
+         if (s.value)
+            release(s);
+   }
+
+   /**
+    * Execute the given action for each key and value stored in the map.
+    */
+   template <typename Action>
+   void for_each(Action action)
+   {
+      for (auto& s : _slots)
+         if (s.value)
+            action(s.key, *s.value);
+   }
+
+   template <typename Action>
+   void for_each(Action action) const
+   {
+      for (auto& s : _slots)
+         if (s.value)
+            action(s.key, *s.value);
+   }
+
+   std::size_t size() const
+   { return _size; }
+
+   bool empty() const
+   { return !_size; }
+
+private:
+
+   static const std::uint32_t NO_SLOT = 0xffffffff;
+   static const key_type INDEX_MASK = (key_type(1) << INDEX_BITS) - 1;
+   static const key_type GENERATION_MASK = 0xffff;
+
+   struct slot
+   {
+      /** The key of the current value, or the next one if slot is free. */
+      key_type key;
+      std::uint32_t next_free;
+      boost::optional<T> value;
+
+      slot(key_type k) : key(k), next_free(NO_SLOT) {}
+   };
+
+   std::vector<slot> _slots;
+   std::size_t _size;
+   std::uint32_t _free_head;
+   std::uint32_t _free_tail;
+
+   static key_type make_key(key_type generation, std::uint32_t index)
+   { return (generation << INDEX_BITS) | index; }
+
+   slot* find_slot(key_type key)
+   {
+      auto index = key & INDEX_MASK;
+      if (index >= _slots.size())
+         return nullptr;
+      auto& s = _slots[index];
+      return (s.key == key && s.value) ? &s : nullptr;
+   }
+
+   void release(slot& s)
+   {
+      s.value.reset();
+      _size--;
+
+      // Generation zero is skipped, so key zero is never issued
+      auto index = s.key & INDEX_MASK;
+      auto generation = ((s.key >> INDEX_BITS) + 1) & GENERATION_MASK;
+      s.key = make_key(generation ? generation : 1, index);
+
+      s.next_free = NO_SLOT;
+      if (_free_tail != NO_SLOT)
+         _slots[_free_tail].next_free = index;
+      else
+         _free_head = index;
+      _free_tail = index;
+   }
+};
+
+} // namespace oac
+
+#endif
@@ -76,10 +76,9 @@ template <typename InputStream>
 inline std::string read_as_string(InputStream& s, unsigned int len)
 throw (io_exception)
 {
-   char* buff = new char[len];
-   read_all(s, buff, len);
-   std::string r(buff, len);
-   delete buff;
+   std::string r(len, '\0');
+   if (len)
+      read_all(s, &r[0], len);
    return r;
 }
 
@@ -19,10 +19,17 @@
 #ifndef OAC_TIME_H
 #define OAC_TIME_H
 
+#include <algorithm>
+#include <cstdint>
 #include <list>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <string>
+#include <vector>
 
 #include <boost/asio.hpp>
+#include <boost/chrono.hpp>
 
 #include <liboac/simconn.h>
 
@@ -157,6 +164,251 @@ private:
          const SIMCONNECT_RECV_EVENT& msg);
 };
 
+/**
+ * A scheduler of ticks at different rates, driven by a steady timer of an
+ * ASIO IO service. The ticks are arranged in named groups, each one with its
+ * own period, so each handler is notified at the rate it needs (e.g., 30 Hz
+ * for the variables that move fast, 1 Hz for those that barely change).
+ * Each group satisfies the TickObserver concept.
+ *
+ * The pending ticks are kept in a timer wheel of WHEEL_SIZE slots, each one
+ * spanning the resolution of the scheduler, so the timer only wakes up for
+ * the slots that have groups to notify. The handlers are notified from the
+ * IO service one group after another, never concurrently, and the timer is
+ * not armed again until all of them return. A tick that cannot be notified
+ * in time is not notified late; the group waits for its next tick instead.
+ *
+ * The scheduler must be stopped before it is destroyed while its IO service
+ * is still running.
+ */
+class tick_scheduler
+{
+public:
+
+   typedef boost::chrono::steady_clock clock_type;
+   typedef boost::chrono::milliseconds duration;
+   typedef boost::asio::basic_waitable_timer<clock_type> timer_type;
+
+   /**
+    * An exception caused by an attempt to add an already existing group.
+    */
+   OAC_DECL_EXCEPTION_WITH_PARAMS(group_already_exists_error, oac::exception,
+      ("tick group %s already exists", group_name),
+      (group_name, std::string));
+
+   /**
+    * An exception caused by a reference to a group which does not exist.
+    */
+   OAC_DECL_EXCEPTION_WITH_PARAMS(no_such_group_error, oac::exception,
+      ("no such tick group %s", group_name),
+      (group_name, std::string));
+
+   /**
+    * An exception caused by an invalid tick period.
+    */
+   OAC_DECL_EXCEPTION_WITH_PARAMS(invalid_period_error, oac::exception,
+      ("invalid period of %d ms for tick group %s",
+            period.count(), group_name),
+      (group_name, std::string),
+      (period, duration));
+
+   /**
+    * A group of handlers notified at the same rate.
+    */
+   class tick_group : public concurrent_tick_observer_base
+   {
+   public:
+
+      const std::string& name() const
+      { return _name; }
+
+      const duration& period() const
+      { return _period; }
+
+      /** The number of ticks notified so far. */
+      std::size_t tick_count() const
+      { return _tick_count; }
+
+   private:
+
+      friend class tick_scheduler;
+
+      std::string _name;
+      duration _period;
+      std::uint64_t _period_slots;
+      std::uint64_t _due_slot;
+      std::size_t _tick_count;
+
+      tick_group(
+            const std::string& name,
+            const duration& period,
+            std::uint64_t period_slots)
+         : _name(name),
+           _period(period),
+           _period_slots(period_slots),
+           _due_slot(0),
+           _tick_count(0)
+      {}
+
+      void tick()
+      {
+         _tick_count++;
+         notify_all();
+      }
+   };
+
+   /** The number of slots of the timer wheel. */
+   static const std::size_t WHEEL_SIZE = 256;
+
+   /** The default time spanned by each slot of the timer wheel. */
+   static const duration DEFAULT_RESOLUTION;
+
+   /**
+    * Create a new scheduler with no groups. It is started right away.
+    *
+    * @param io_srv     The IO service which runs the timer of the scheduler
+    * @param resolution The time spanned by each slot of the timer wheel. The
+    *                   group periods are rounded to a multiple of it.
+    */
+   tick_scheduler(
+         const std::shared_ptr<boost::asio::io_service>& io_srv,
+         const duration& resolution = DEFAULT_RESOLUTION);
+
+   ~tick_scheduler();
+
+   /**
+    * Add a new group of ticks with the given period. Its first tick is
+    * notified a period after it is added.
+    */
+   tick_group& add_group(const std::string& name, const duration& period)
+   throw (group_already_exists_error, invalid_period_error);
+
+   /**
+    * Obtain the group with the given name.
+    */
+   tick_group& group(const std::string& name)
+   throw (no_such_group_error);
+
+   /**
+    * Register a handler to be notified on each tick of the given group.
+    */
+   template <typename OnTickHandler>
+   void register_handler(
+         const std::string& group_name,
+         const OnTickHandler& handler)
+   throw (no_such_group_error)
+   {
+      group(group_name).register_handler(handler);
+   }
+
+   /**
+    * Stop notifying ticks. The handlers being notified, if any, are not
+    * interrupted.
+    */
+   void stop();
+
+private:
+
+   typedef std::vector<tick_group*> wheel_slot;
+
+   std::shared_ptr<boost::asio::io_service> _io_service;
+   timer_type _timer;
+   duration _resolution;
+   clock_type::time_point _start;
+   std::mutex _mutex;
+   std::map<std::string, std::shared_ptr<tick_group>> _groups;
+   std::vector<wheel_slot> _wheel;
+   std::uint64_t _current_slot;
+   std::uint64_t _armed_slot;
+   bool _stopped;
+
+   tick_scheduler(const tick_scheduler&);
+   tick_scheduler& operator = (const tick_scheduler&);
+
+   std::uint64_t elapsed_slots() const;
+
+   void schedule(tick_group& grp, std::uint64_t due_slot);
+
+   void advance(std::uint64_t slot, std::vector<tick_group*>& due_groups);
+
+   void arm();
+
+   void on_timer(const boost::system::error_code& ec);
+};
+
+/**
+ * A histogram of tick timings. Each bucket counts the samples lower than
+ * twice the upper bound of the previous bucket, beginning with a bucket for
+ * samples under a microsecond. The last bucket counts the samples beyond.
+ */
+class tick_histogram
+{
+public:
+
+   typedef boost::chrono::microseconds duration;
+
+   static const std::size_t BUCKET_COUNT = 24;
+
+   tick_histogram() : _total(0), _max(0)
+   { std::fill(_buckets, _buckets + BUCKET_COUNT, 0); }
+
+   void add(const duration& sample)
+   {
+      auto usecs = std::max<duration::rep>(sample.count(), 0);
+      std::size_t bucket = 0;
+      while (bucket < BUCKET_COUNT - 1 && usecs >= upper_bound(bucket).count())
+         bucket++;
+      _buckets[bucket]++;
+      _total++;
+      _max = std::max(_max, duration(usecs));
+   }
+
+   /** The number of samples of the given bucket. */
+   std::size_t count(std::size_t bucket) const
+   { return _buckets[bucket]; }
+
+   /** The exclusive upper bound of the given bucket. */
+   static duration upper_bound(std::size_t bucket)
+   { return duration(duration::rep(1) << bucket); }
+
+   /** The number of samples of all buckets. */
+   std::size_t total() const
+   { return _total; }
+
+   /** The greatest sample so far. */
+   const duration& max() const
+   { return _max; }
+
+private:
+
+   std::size_t _buckets[BUCKET_COUNT];
+   std::size_t _total;
+   duration _max;
+};
+
+/**
+ * The statistics on the ticks of a handler registered in an adapter.
+ */
+struct tick_stats
+{
+   /** The ticks whose handler was run. */
+   std::size_t handled_ticks;
+
+   /**
+    * The ticks dropped because the handler of a previous one was still
+    * pending or running.
+    */
+   std::size_t overruns;
+
+   /** The time from each tick to the start of its handler. */
+   tick_histogram jitter;
+
+   /** The time each handler took to run. */
+   tick_histogram duration;
+
+   tick_stats() : handled_ticks(0), overruns(0) {}
+};
+
 /**
  * An adapter which allows a tick observer to dispatch the notifications via
  * an ASIO IO service object. This class provides a TickObserver compliant
@@ -164,6 +416,12 @@ private:
  * a shared Boost IO service. Any handler registered into the adapter will
  * be registered in the delegate in a way that the tick handler is dispatched
  * using the Boost IO service provided in the constructor.
+ *
+ * The ticks are coalesced: a tick observed while the previous one of the
+ * same handler is still pending or running is dropped and counted as an
+ * overrun. Therefore, a handler never runs concurrently with itself, and a
+ * handler slower than the tick period does not make the IO service queue
+ * grow. The jitter and duration of each handler are gathered in histograms.
  */
 template <typename TickObserver>
 class asio_tick_observer_adapter
@@ -171,6 +429,7 @@ class asio_tick_observer_adapter
 public:
 
    typedef std::function<void(void)> on_tick_handler;
+   typedef std::size_t handler_id;
 
    asio_tick_observer_adapter(
          const std::shared_ptr<boost::asio::io_service>& io_srv,
@@ -178,12 +437,32 @@ public:
       : _io_service(io_srv)
    {}
 
+   /**
+    * Register the given handler.
+    *
+    * @return the identifier of the handler, to obtain its statistics
+    */
    template <typename OnTickHandler>
-   void register_handler(const OnTickHandler& handler)
+   handler_id register_handler(const OnTickHandler& handler)
    {
-      _delegate.register_handler([this, handler]() {
-         _io_service->post(handler);
+      auto state = std::make_shared<handler_state>(handler);
+      auto io_srv = _io_service;
+      _delegate.register_handler([io_srv, state]() {
+         if (state->begin_tick())
+            io_srv->post([state]() { state->run(); });
       });
+      _handlers.push_back(state);
+      return _handlers.size() - 1;
+   }
+
+   /**
+    * Obtain the statistics on the ticks of the given handler.
+    */
+   tick_stats get_stats(handler_id id) const
+   {
+      auto& state = *_handlers.at(id);
+      std::lock_guard<std::mutex> lock(state.mutex);
+      return state.stats;
    }
 
    const TickObserver& delegate() const { return _delegate; }
@@ -192,8 +471,64 @@ public:
 
 private:
 
+   typedef boost::chrono::steady_clock clock_type;
+
+   struct handler_state
+   {
+      on_tick_handler handler;
+      std::mutex mutex;
+      bool pending;
+      clock_type::time_point tick_time;
+      tick_stats stats;
+
+      handler_state(const on_tick_handler& h) : handler(h), pending(false) {}
+
+      bool begin_tick()
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         if (pending)
+         {
+            stats.overruns++;
+            return false;
+         }
+         pending = true;
+         tick_time = clock_type::now();
+         return true;
+      }
+
+      void run()
+      {
+         auto start = clock_type::now();
+         try
+         {
+            handler();
+         }
+         catch (...)
+         {
+            end_tick(start);
+            throw;
+         }
+         end_tick(start);
+      }
+
+      void end_tick(const clock_type::time_point& start)
+      {
+         using boost::chrono::duration_cast;
+
+         auto end = clock_type::now();
+         std::lock_guard<std::mutex> lock(mutex);
+         stats.handled_ticks++;
+         stats.jitter.add(
+               duration_cast<tick_histogram::duration>(start - tick_time));
+         stats.duration.add(
+               duration_cast<tick_histogram::duration>(end - start));
+         pending = false;
+      }
+   };
+
    std::shared_ptr<boost::asio::io_service> _io_service;
    TickObserver _delegate;
+   std::vector<std::shared_ptr<handler_state>> _handlers;
 };
 
 } // namespace oac
@@ -0,0 +1,203 @@
+/*
+ * This file is part of Open Airbus Cockpit
+ * Copyright (C) 2012, 2013 Alvaro Polo
+ *
+ * Open Airbus Cockpit is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Open Airbus Cockpit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Open Airbus Cockpit. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <liboac/concurrency.h>
+
+namespace oac {
+
+thread_pool::thread_pool(std::size_t nthreads)
+   : _next_worker(0),
+     _pending_jobs(0),
+     _idle_workers(0),
+     _stolen_jobs(0),
+     _stopping(false)
+{
+   if (!nthreads)
+      nthreads = boost::thread::hardware_concurrency();
+   if (!nthreads)
+      nthreads = 1;
+
+   for (std::size_t i = 0; i < nthreads; i++)
+      _workers.push_back(std::unique_ptr<worker>(new worker()));
+   for (std::size_t i = 0; i < nthreads; i++)
+      _threads.create_thread(std::bind(&thread_pool::run_worker, this, i));
+}
+
+thread_pool::~thread_pool()
+{
+   stop();
+}
+
+void
+thread_pool::stop()
+{
+   {
+      std::lock_guard<std::mutex> lock(_idle_mutex);
+      _stopping = true;
+   }
+   _job_pushed.notify_all();
+   _threads.join_all();
+}
+
+void
+thread_pool::push(job_ptr&& job)
+throw (pool_stopped_error)
+{
+   // Jobs submitted by a worker stay on it, so the jobs of a stopping pool
+   // may still submit the jobs they depend on
+   auto current = _current_worker.get();
+   if (_stopping && !current)
+      OAC_THROW_EXCEPTION(pool_stopped_error());
+   auto index = current ? *current : _next_worker++ % _workers.size();
+
+   // Either this thread sees the idle worker, or the worker sees the job
+   _pending_jobs++;
+   {
+      auto& w = *_workers[index];
+      std::lock_guard<std::mutex> lock(w.mutex);
+      w.jobs.push_back(std::move(job));
+   }
+   if (_idle_workers > 0)
+   {
+      std::lock_guard<std::mutex> lock(_idle_mutex);
+      _job_pushed.notify_one();
+   }
+}
+
+thread_pool::job_ptr
+thread_pool::pop(std::size_t index)
+{
+   auto& w = *_workers[index];
+   std::lock_guard<std::mutex> lock(w.mutex);
+   if (w.jobs.empty())
+      return job_ptr();
+   auto job = std::move(w.jobs.back());
+   w.jobs.pop_back();
+   return job;
+}
+
+thread_pool::job_ptr
+thread_pool::steal(std::size_t index)
+{
+   for (std::size_t i = 1; i < _workers.size(); i++)
+   {
+      auto& w = *_workers[(index + i) % _workers.size()];
+      std::lock_guard<std::mutex> lock(w.mutex);
+      if (!w.jobs.empty())
+      {
+         auto job = std::move(w.jobs.front());
+         w.jobs.pop_front();
+         _stolen_jobs++;
+         return job;
+      }
+   }
+   return job_ptr();
+}
+
+void
+thread_pool::run_worker(std::size_t index)
+{
+   _current_worker.reset(new std::size_t(index));
+   for (;;)
+   {
+      auto job = pop(index);
+      if (!job)
+         job = steal(index);
+      if (job)
+      {
+         _pending_jobs--;
+         try
+         {
+            job->run();
+         }
+         catch (...)
+         {
+            // Posted jobs have nobody to report errors to
+         }
+         continue;
+      }
+
+      std::unique_lock<std::mutex> lock(_idle_mutex);
+      _idle_workers++;
+      _job_pushed.wait(lock, [this]()
+      {
+         return _pending_jobs > 0 || _stopping;
+      });
+      _idle_workers--;
+      if (_stopping && !_pending_jobs)
+         return;
+   }
+}
+
+
+
+strand::strand(thread_pool& pool)
+   : _state(std::make_shared<state>(pool))
+{}
+
+void
+strand::state::push(std::unique_ptr<pool_job>&& job)
+{
+   std::lock_guard<std::mutex> lock(mutex);
+   jobs.push(std::move(job));
+   if (!scheduled)
+   {
+      auto self = shared_from_this();
+      pool.post([self]() { self->run(); });
+      scheduled = true;
+   }
+}
+
+void
+strand::state::run()
+{
+   for (std::size_t i = 0; i < BATCH_SIZE; i++)
+   {
+      std::unique_ptr<pool_job> job;
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         if (jobs.empty())
+         {
+            scheduled = false;
+            return;
+         }
+         job = std::move(jobs.front());
+         jobs.pop();
+      }
+      try
+      {
+         job->run();
+      }
+      catch (...)
+      {
+         // Posted jobs have nobody to report errors to
+      }
+   }
+
+   // Yield the worker so the strand does not starve other jobs
+   std::lock_guard<std::mutex> lock(mutex);
+   if (jobs.empty())
+      scheduled = false;
+   else
+   {
+      auto self = shared_from_this();
+      pool.post([self]() { self->run(); });
+   }
+}
+
+} // namespace oac
@@ -0,0 +1,342 @@
+/*
+ * This file is part of Open Airbus Cockpit
+ * Copyright (C) 2012, 2013 Alvaro Polo
+ *
+ * Open Airbus Cockpit is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Open Airbus Cockpit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Open Airbus Cockpit. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include <liboac/fsuipc/capture.h>
+
+namespace oac { namespace fsuipc {
+
+namespace {
+
+namespace ipc = boost::interprocess;
+
+template <typename Integer>
+void
+put_le(std::uint8_t* dst, Integer value)
+{
+   for (std::size_t i = 0; i < sizeof(Integer); i++)
+      dst[i] = std::uint8_t(value >> (8 * i));
+}
+
+template <typename Integer>
+Integer
+get_le(const std::uint8_t* src)
+{
+   Integer value = 0;
+   for (std::size_t i = 0; i < sizeof(Integer); i++)
+      value |= Integer(src[i]) << (8 * i);
+   return value;
+}
+
+std::size_t
+count_chunks(const std::uint8_t* bitmap)
+{
+   std::size_t count = 0;
+   for (std::size_t i = 0; i < capture_format::BITMAP_SIZE; i++)
+   {
+      for (auto bits = bitmap[i]; bits; bits &= bits - 1)
+         count++;
+   }
+   return count;
+}
+
+} // anonymous namespace
+
+const std::size_t capture_writer::GROWTH_SIZE(4 * 1024 * 1024);
+
+capture_writer::capture_writer(const boost::filesystem::path& path)
+throw (capture_open_error)
+   : _path(path),
+     _size(capture_format::HEADER_SIZE),
+     _capacity(0),
+     _record_count(0),
+     _start(boost::chrono::steady_clock::now())
+{
+   std::ofstream file(path.string(), std::ios::binary | std::ios::trunc);
+   if (!file)
+      OAC_THROW_EXCEPTION(capture_open_error(path, "cannot create file"));
+   file.close();
+
+   map(GROWTH_SIZE);
+   std::memcpy(data(), capture_format::MAGIC, capture_format::MAGIC_SIZE);
+   put_le(data() + 8, capture_format::VERSION);
+   put_le(data() + 12, std::uint32_t(capture_format::CHUNK_SIZE));
+}
+
+capture_writer::~capture_writer()
+{
+   try
+   {
+      close();
+   }
+   catch (...)
+   {
+      // Destructors must not throw; the capture is still readable since
+      // its unused tail is zeroed
+   }
+}
+
+void
+capture_writer::record(shadow_memory& shadow)
+throw (capture_open_error)
+{
+   record(
+         shadow,
+         boost::chrono::duration_cast<duration>(
+               boost::chrono::steady_clock::now() - _start));
+}
+
+void
+capture_writer::record(shadow_memory& shadow, const duration& timestamp)
+throw (capture_open_error)
+{
+   using namespace capture_format;
+
+   // Ranges are sorted by address, so are their chunks
+   std::uint8_t bitmap[BITMAP_SIZE] = { 0 };
+   std::size_t chunk_count = 0;
+   auto add_chunk = [&bitmap, &chunk_count](std::size_t chunk)
+   {
+      if (!(bitmap[chunk / 8] & (1 << (chunk % 8))))
+      {
+         bitmap[chunk / 8] |= std::uint8_t(1 << (chunk % 8));
+         chunk_count++;
+      }
+   };
+   for (auto& range : shadow.changes())
+   {
+      auto last = std::min<std::size_t>(range.end - 1, 0xffff) / CHUNK_SIZE;
+      for (std::size_t chunk = range.begin / CHUNK_SIZE; chunk <= last; chunk++)
+         add_chunk(chunk);
+   }
+
+   // The keyframe holds the values read before the capture began as well
+   if (!_record_count)
+   {
+      auto image = shadow.data();
+      for (std::size_t chunk = 0; chunk < CHUNK_COUNT; chunk++)
+      {
+         auto begin = image + chunk * CHUNK_SIZE;
+         if (std::find_if(begin, begin + CHUNK_SIZE, [](std::uint8_t b)
+               { return b != 0; }) != begin + CHUNK_SIZE)
+            add_chunk(chunk);
+      }
+   }
+
+   auto length = RECORD_HEADER_SIZE + BITMAP_SIZE + chunk_count * CHUNK_SIZE;
+   reserve(_size + length);
+
+   auto rec = data() + _size;
+   put_le(rec, std::uint32_t(length));
+   put_le(rec + 4, std::uint32_t(chunk_count));
+   put_le(rec + 8, std::uint64_t(timestamp.count()));
+   std::memcpy(rec + RECORD_HEADER_SIZE, bitmap, BITMAP_SIZE);
+   auto dst = rec + RECORD_HEADER_SIZE + BITMAP_SIZE;
+   for (std::size_t chunk = 0; chunk < CHUNK_COUNT; chunk++)
+   {
+      if (bitmap[chunk / 8] & (1 << (chunk % 8)))
+      {
+         std::memcpy(dst, shadow.data() + chunk * CHUNK_SIZE, CHUNK_SIZE);
+         dst += CHUNK_SIZE;
+      }
+   }
+
+   _size += length;
+   _record_count++;
+}
+
+void
+capture_writer::close()
+{
+   if (!_capacity)
+      return;
+
+   ipc::mapped_region().swap(_region);
+   ipc::file_mapping().swap(_mapping);
+   boost::filesystem::resize_file(_path, _size);
+   _capacity = 0;
+}
+
+void
+capture_writer::reserve(std::size_t size)
+throw (capture_open_error)
+{
+   if (size <= _capacity)
+      return;
+   if (!_capacity)
+      OAC_THROW_EXCEPTION(capture_open_error(_path, "capture is closed"));
+
+   auto capacity = _capacity;
+   while (capacity < size)
+      capacity += GROWTH_SIZE;
+   map(capacity);
+}
+
+void
+capture_writer::map(std::size_t capacity)
+throw (capture_open_error)
+{
+   // The file cannot be resized while it is mapped on some platforms
+   try
+   {
+      ipc::mapped_region().swap(_region);
+      ipc::file_mapping().swap(_mapping);
+      boost::filesystem::resize_file(_path, capacity);
+      ipc::file_mapping(_path.string().c_str(), ipc::read_write).swap(
+            _mapping);
+      ipc::mapped_region(_mapping, ipc::read_write).swap(_region);
+      _capacity = capacity;
+   }
+   catch (const std::exception& e)
+   {
+      OAC_THROW_EXCEPTION(capture_open_error(_path, e.what()));
+   }
+}
+
+
+
+capture_reader::capture_reader(const boost::filesystem::path& path)
+throw (capture_open_error, capture_format_error)
+   : _path(path),
+     _size(0),
+     _position(capture_format::HEADER_SIZE)
+{
+   try
+   {
+      ipc::file_mapping(path.string().c_str(), ipc::read_only).swap(_mapping);
+      ipc::mapped_region(_mapping, ipc::read_only).swap(_region);
+      _size = _region.get_size();
+   }
+   catch (const std::exception& e)
+   {
+      OAC_THROW_EXCEPTION(capture_open_error(path, e.what()));
+   }
+
+   if (_size < capture_format::HEADER_SIZE ||
+       std::memcmp(
+             data(), capture_format::MAGIC, capture_format::MAGIC_SIZE) != 0)
+      OAC_THROW_EXCEPTION(capture_format_error(path, "bad magic number"));
+   if (get_le<std::uint32_t>(data() + 8) != capture_format::VERSION)
+      OAC_THROW_EXCEPTION(capture_format_error(path, "unsupported version"));
+   if (get_le<std::uint32_t>(data() + 12) != capture_format::CHUNK_SIZE)
+      OAC_THROW_EXCEPTION(capture_format_error(path, "unsupported chunk size"));
+}
+
+bool
+capture_reader::next(record& rec)
+throw (capture_format_error)
+{
+   using namespace capture_format;
+
+   if (_position + RECORD_HEADER_SIZE > _size)
+      return false;
+
+   auto src = data() + _position;
+   auto length = get_le<std::uint32_t>(src);
+   if (length == 0)
+      return false;
+
+   rec.chunk_count = get_le<std::uint32_t>(src + 4);
+   if (length != RECORD_HEADER_SIZE + BITMAP_SIZE +
+                 rec.chunk_count * CHUNK_SIZE ||
+       _position + length > _size)
+      OAC_THROW_EXCEPTION(capture_format_error(_path, "truncated record"));
+
+   rec.timestamp = duration(get_le<std::uint64_t>(src + 8));
+   rec.bitmap = src + RECORD_HEADER_SIZE;
+   rec.data = rec.bitmap + BITMAP_SIZE;
+
+   // Walking the chunks advances the data on each bit set in the bitmap
+   if (count_chunks(rec.bitmap) != rec.chunk_count)
+      OAC_THROW_EXCEPTION(capture_format_error(
+            _path, "chunk bitmap does not match chunk count"));
+
+   _position += length;
+   return true;
+}
+
+
+
+replay_user_adapter::replay_user_adapter()
+   : _speed(replay_speed::UNTHROTTLED),
+     _started(false),
+     _finished(true),
+     _replayed_records(0)
+{}
+
+void
+replay_user_adapter::open(
+      const boost::filesystem::path& path,
+      replay_speed speed)
+throw (capture_open_error, capture_format_error)
+{
+   _reader = std::make_shared<capture_reader>(path);
+   std::vector<std::uint8_t> zeros(0x10000);
+   set_block(0, zeros.data(), zeros.size());
+   _speed = speed;
+   _started = false;
+   _replayed_records = 0;
+   read_next();
+}
+
+void
+replay_user_adapter::process()
+{
+   if (!_finished)
+   {
+      if (_speed == replay_speed::UNTHROTTLED)
+         replay_next();
+      else
+      {
+         auto now = boost::chrono::steady_clock::now();
+         if (!_started)
+         {
+            _start = now;
+            _started = true;
+         }
+         auto elapsed = boost::chrono::duration_cast<
+               capture_reader::duration>(now - _start);
+         while (!_finished && _next.timestamp <= elapsed)
+            replay_next();
+      }
+   }
+   simulator_user_adapter::process();
+}
+
+void
+replay_user_adapter::read_next()
+{
+   _finished = !_reader->next(_next);
+}
+
+void
+replay_user_adapter::replay_next()
+{
+   capture_reader::for_each_chunk(_next, [this](
+         offset_address address, const std::uint8_t* chunk)
+   {
+      set_block(address, chunk, capture_format::CHUNK_SIZE);
+   });
+   _replayed_records++;
+   read_next();
+}
+
+}} // namespace oac::fsuipc
@@ -16,6 +16,9 @@
  * along with Open Airbus Cockpit.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <cstring>
+
 #include <liboac/fsuipc/client.h>
 
 namespace oac { namespace fsuipc {
@@ -28,7 +31,18 @@ dummy_user_adapter::process_read_requests()
       *req.value = read_value_from_buffer(
                req.offset.address, req.offset.length);
    }
+   for (auto& req : _block_read_requests)
+   {
+      std::size_t available = sizeof(_buffer) - std::min<std::size_t>(
+            req.address, sizeof(_buffer));
+      auto length = std::min(req.length, available);
+      std::memcpy(req.dst, _buffer + req.address, length);
+      std::memset(static_cast<std::uint8_t*>(req.dst) + length, 0,
+                  req.length - length);
+   }
+   _read_count += _read_requests.size() + _block_read_requests.size();
    _read_requests.clear();
+   _block_read_requests.clear();
 }
 
 void
@@ -41,6 +55,7 @@ dummy_user_adapter::process_write_requests()
                req.offset.length,
                req.offset.value);
    }
+   _write_count += _write_requests.size();
    _write_requests.clear();
 }
 
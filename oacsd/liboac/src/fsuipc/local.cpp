@@ -200,6 +200,18 @@ throw (fsuipc_error)
    }
 }
 
+void
+local_user_adapter::read_block(
+      offset_address address,
+      std::size_t length,
+      void* dst)
+throw (fsuipc_error)
+{
+   DWORD error;
+   if (!FSUIPC_Read(address, length, dst, &error))
+      OAC_THROW_EXCEPTION(fsuipc_error(error, get_result_message(error)));
+}
+
 void
 local_user_adapter::write(
       const valued_offset& valued_offset)
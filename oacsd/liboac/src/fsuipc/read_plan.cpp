@@ -0,0 +1,83 @@
+/*
+ * This file is part of Open Airbus Cockpit
+ * Copyright (C) 2012, 2013 Alvaro Polo
+ *
+ * Open Airbus Cockpit is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Open Airbus Cockpit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Open Airbus Cockpit. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include <liboac/fsuipc/read_plan.h>
+
+namespace oac { namespace fsuipc {
+
+const std::size_t read_plan::DEFAULT_GAP_TOLERANCE(16);
+
+void
+read_plan::build()
+{
+   std::sort(
+         _offsets.begin(),
+         _offsets.end(),
+         [](const planned_offset& lhs, const planned_offset& rhs)
+         {
+            return lhs.offset.address < rhs.offset.address ||
+                   (lhs.offset.address == rhs.offset.address &&
+                    lhs.offset.length < rhs.offset.length);
+         });
+   _offsets.erase(
+         std::unique(
+               _offsets.begin(),
+               _offsets.end(),
+               [](const planned_offset& lhs, const planned_offset& rhs)
+               { return lhs.offset == rhs.offset; }),
+         _offsets.end());
+
+   // Since offsets are sorted by address, each one either extends the
+   // current block or starts a new one after it. A block is complete once
+   // the next one starts, so its position is known by then.
+   _blocks.clear();
+   std::uint32_t block_end = 0;
+   for (auto& po : _offsets)
+   {
+      std::uint32_t address = po.offset.address;
+      std::uint32_t end = address + po.offset.length;
+      if (_blocks.empty() || address > block_end + _gap_tolerance)
+      {
+         block b = { address, 0, 0 };
+         if (!_blocks.empty())
+         {
+            auto& last = _blocks.back();
+            last.length = block_end - last.address;
+            b.position = last.position + last.length;
+         }
+         _blocks.push_back(b);
+         block_end = end;
+      }
+      else
+         block_end = std::max(block_end, end);
+      auto& current = _blocks.back();
+      po.position = current.position + (address - current.address);
+   }
+
+   _buffer_size = 0;
+   if (!_blocks.empty())
+   {
+      auto& last = _blocks.back();
+      last.length = block_end - last.address;
+      _buffer_size = last.position + last.length;
+   }
+}
+
+}} // namespace oac::fsuipc
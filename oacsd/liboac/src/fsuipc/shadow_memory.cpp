@@ -0,0 +1,162 @@
+/*
+ * This file is part of Open Airbus Cockpit
+ * Copyright (C) 2012, 2013 Alvaro Polo
+ *
+ * Open Airbus Cockpit is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Open Airbus Cockpit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Open Airbus Cockpit. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include <liboac/fsuipc/shadow_memory.h>
+
+namespace oac { namespace fsuipc {
+
+namespace {
+
+/**
+ * The padding after the address space, so an offset at its very end may
+ * be read without checking the bounds.
+ */
+const std::size_t IMAGE_PADDING = OFFSET_LEN_DWORD;
+
+} // anonymous namespace
+
+const std::size_t shadow_memory::SIZE(0x10000);
+
+shadow_memory::shadow_memory()
+   : _image(SIZE + IMAGE_PADDING, 0),
+     _dirty((SIZE + IMAGE_PADDING + 63) / 64, 0),
+     _changes_sorted(true)
+{}
+
+void
+shadow_memory::update(
+      std::uint32_t address,
+      const std::uint8_t* data,
+      std::size_t length)
+{
+   if (address >= SIZE)
+      return;
+   length = std::min<std::size_t>(length, SIZE - address);
+
+   // Compare a machine word at a time, and only look for the bytes that
+   // differ when the words do
+   auto image = &_image[address];
+   std::size_t i = 0;
+   for (; i + sizeof(std::uint64_t) <= length; i += sizeof(std::uint64_t))
+   {
+      std::uint64_t fresh, shadow;
+      std::memcpy(&fresh, data + i, sizeof(fresh));
+      std::memcpy(&shadow, image + i, sizeof(shadow));
+      if (fresh == shadow)
+         continue;
+      for (std::size_t j = i; j < i + sizeof(std::uint64_t); j++)
+         if (data[j] != image[j])
+            mark_changed(address + std::uint32_t(j));
+      std::memcpy(image + i, &fresh, sizeof(fresh));
+   }
+   for (; i < length; i++)
+   {
+      if (data[i] != image[i])
+      {
+         mark_changed(address + std::uint32_t(i));
+         image[i] = data[i];
+      }
+   }
+}
+
+offset_value
+shadow_memory::read(const offset& o) const
+{
+   auto data = &_image[o.address];
+   offset_value value = 0;
+   switch (o.length)
+   {
+      case OFFSET_LEN_DWORD:
+         value |= offset_value(data[3]) << 24;
+         value |= offset_value(data[2]) << 16;
+      case OFFSET_LEN_WORD:
+         value |= offset_value(data[1]) << 8;
+      case OFFSET_LEN_BYTE:
+         value |= offset_value(data[0]);
+   }
+   return value;
+}
+
+bool
+shadow_memory::is_dirty(const offset& o) const
+{
+   std::uint32_t end = o.address + std::uint32_t(o.length);
+   for (std::uint32_t addr = o.address; addr < end; addr++)
+      if (_dirty[addr / 64] & (std::uint64_t(1) << (addr % 64)))
+         return true;
+   return false;
+}
+
+const std::vector<shadow_memory::range>&
+shadow_memory::changes()
+{
+   if (!_changes_sorted)
+   {
+      std::sort(
+            _changes.begin(),
+            _changes.end(),
+            [](const range& lhs, const range& rhs)
+            { return lhs.begin < rhs.begin; });
+      std::vector<range> merged;
+      merged.reserve(_changes.size());
+      for (auto& r : _changes)
+      {
+         if (!merged.empty() && r.begin <= merged.back().end)
+            merged.back().end = std::max(merged.back().end, r.end);
+         else
+            merged.push_back(r);
+      }
+      _changes.swap(merged);
+      _changes_sorted = true;
+   }
+   return _changes;
+}
+
+void
+shadow_memory::clear_changes()
+{
+   for (auto& r : _changes)
+      for (auto addr = r.begin; addr < r.end; addr++)
+         _dirty[addr / 64] &= ~(std::uint64_t(1) << (addr % 64));
+   _changes.clear();
+   _changes_sorted = true;
+}
+
+void
+shadow_memory::mark_changed(std::uint32_t address)
+{
+   _dirty[address / 64] |= std::uint64_t(1) << (address % 64);
+   if (!_changes.empty())
+   {
+      auto& last = _changes.back();
+      if (last.end == address)
+      {
+         last.end++;
+         return;
+      }
+      if (address < last.end)
+         _changes_sorted = false;
+   }
+   range r = { address, address + 1 };
+   _changes.push_back(r);
+}
+
+}} // namespace oac::fsuipc
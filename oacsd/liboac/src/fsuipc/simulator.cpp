@@ -0,0 +1,268 @@
+/*
+ * This file is part of Open Airbus Cockpit
+ * Copyright (C) 2012, 2013 Alvaro Polo
+ *
+ * Open Airbus Cockpit is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Open Airbus Cockpit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Open Airbus Cockpit. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include <boost/thread.hpp>
+
+#include <liboac/fsuipc/simulator.h>
+
+namespace oac { namespace fsuipc {
+
+namespace {
+
+/**
+ * The size of the simulated memory. It exceeds the FSUIPC address space by
+ * the length of a double word, so reading an offset at its very end needs
+ * no bound checks.
+ */
+const std::size_t MEMORY_SIZE = 0x10000 + OFFSET_LEN_DWORD;
+
+std::int64_t
+max_value_of(const offset& o)
+{
+   return (std::int64_t(1) << (8 * o.length)) - 1;
+}
+
+} // anonymous namespace
+
+const std::uint32_t simulator_user_adapter::DEFAULT_SEED(5489);
+
+simulator_user_adapter::simulator_user_adapter(std::uint32_t seed)
+   : _memory(MEMORY_SIZE, 0),
+     _random(seed),
+     _now(0),
+     _time_step(0),
+     _ipc_latency(0),
+     _process_count(0),
+     _read_count(0),
+     _write_count(0)
+{}
+
+void
+simulator_user_adapter::set_value(const offset& o, offset_value value)
+{
+   for (int i = 0; i < o.length; i++)
+      _memory[o.address + i] = std::uint8_t(value >> (8 * i));
+}
+
+void
+simulator_user_adapter::set_block(
+      offset_address address,
+      const void* data,
+      std::size_t length)
+{
+   length = std::min<std::size_t>(length, 0x10000 - address);
+   std::memcpy(&_memory[address], data, length);
+}
+
+offset_value
+simulator_user_adapter::get_value(const offset& o) const
+{
+   offset_value value = 0;
+   for (int i = 0; i < o.length; i++)
+      value |= offset_value(_memory[o.address + i]) << (8 * i);
+   return value;
+}
+
+void
+simulator_user_adapter::add_ramp(
+      const offset& o,
+      offset_value from,
+      offset_value to,
+      offset_value step,
+      const duration& period)
+{
+   dynamic d(o, dynamic_kind::RAMP, period, _now);
+   d.from = from;
+   d.to = to;
+   d.step = from <= to ? std::int64_t(step) : -std::int64_t(step);
+   set_value(o, from);
+   add_dynamic(d);
+}
+
+void
+simulator_user_adapter::add_noise(
+      const offset& o,
+      offset_value center,
+      offset_value amplitude,
+      const duration& period)
+{
+   dynamic d(o, dynamic_kind::NOISE, period, _now);
+   d.from = std::max<std::int64_t>(std::int64_t(center) - amplitude, 0);
+   d.to = std::min<std::int64_t>(
+         std::int64_t(center) + amplitude, max_value_of(o));
+   set_value(o, center);
+   add_dynamic(d);
+}
+
+void
+simulator_user_adapter::add_steps(
+      const offset& o,
+      const std::vector<offset_value>& values,
+      const duration& period)
+{
+   if (values.empty())
+      return;
+
+   dynamic d(o, dynamic_kind::STEPS, period, _now);
+   d.values = values;
+   d.next_value = 1 % values.size();
+   set_value(o, values.front());
+   add_dynamic(d);
+}
+
+void
+simulator_user_adapter::remove_dynamics(const offset& o)
+{
+   _dynamics.erase(
+         std::remove_if(
+               _dynamics.begin(),
+               _dynamics.end(),
+               [&o](const dynamic& d) { return d.target == o; }),
+         _dynamics.end());
+}
+
+void
+simulator_user_adapter::advance(const duration& elapsed)
+{
+   _now += elapsed;
+   for (auto& d : _dynamics)
+   {
+      while (d.next_change <= _now)
+      {
+         apply(d);
+         d.next_change += d.period;
+      }
+   }
+}
+
+void
+simulator_user_adapter::read(valued_offset& valued_offset)
+{
+   request req = {
+      request_kind::READ,
+      valued_offset.address,
+      std::size_t(valued_offset.length),
+      &valued_offset.value,
+      0
+   };
+   _requests.push_back(req);
+}
+
+void
+simulator_user_adapter::read_block(
+      offset_address address,
+      std::size_t length,
+      void* dst)
+{
+   request req = { request_kind::READ_BLOCK, address, length, dst, 0 };
+   _requests.push_back(req);
+}
+
+void
+simulator_user_adapter::write(const valued_offset& valued_offset)
+{
+   request req = {
+      request_kind::WRITE,
+      valued_offset.address,
+      std::size_t(valued_offset.length),
+      nullptr,
+      valued_offset.value
+   };
+   _requests.push_back(req);
+}
+
+void
+simulator_user_adapter::process()
+{
+   if (_ipc_latency > duration::zero())
+      boost::this_thread::sleep_for(_ipc_latency);
+   if (_time_step > duration::zero())
+      advance(_time_step);
+
+   for (auto& req : _requests)
+   {
+      switch (req.kind)
+      {
+         case request_kind::READ:
+            *static_cast<offset_value*>(req.dst) = get_value(
+                  offset(req.address, offset_length(req.length)));
+            _read_count++;
+            break;
+         case request_kind::READ_BLOCK:
+         {
+            auto length = std::min<std::size_t>(
+                  req.length, MEMORY_SIZE - req.address);
+            std::memcpy(req.dst, &_memory[req.address], length);
+            std::memset(
+                  static_cast<std::uint8_t*>(req.dst) + length,
+                  0,
+                  req.length - length);
+            _read_count++;
+            break;
+         }
+         case request_kind::WRITE:
+            set_value(offset(req.address, offset_length(req.length)), req.value);
+            _write_count++;
+            break;
+      }
+   }
+   _requests.clear();
+   _process_count++;
+}
+
+void
+simulator_user_adapter::add_dynamic(const dynamic& d)
+{
+   if (d.period > duration::zero())
+      _dynamics.push_back(d);
+}
+
+void
+simulator_user_adapter::apply(dynamic& d)
+{
+   switch (d.kind)
+   {
+      case dynamic_kind::RAMP:
+      {
+         // The ramp moves from the current value, so writes are honored
+         auto value = std::int64_t(get_value(d.target)) + d.step;
+         if ((d.step >= 0 && value > d.to) || (d.step < 0 && value < d.to))
+            value = d.from;
+         set_value(d.target, offset_value(value));
+         break;
+      }
+      case dynamic_kind::NOISE:
+      {
+         // The generator output is used directly rather than through a
+         // distribution, since distributions are implementation defined
+         auto range = std::uint64_t(d.to - d.from + 1);
+         auto value = d.from + std::int64_t(_random() % range);
+         set_value(d.target, offset_value(value));
+         break;
+      }
+      case dynamic_kind::STEPS:
+         set_value(d.target, d.values[d.next_value]);
+         d.next_value = (d.next_value + 1) % d.values.size();
+         break;
+   }
+}
+
+}} // namespace oac::fsuipc
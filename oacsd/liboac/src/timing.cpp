@@ -16,6 +16,8 @@
  * along with Open Airbus Cockpit.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+
 #include <liboac/timing.h>
 
 namespace oac {
@@ -64,4 +66,175 @@ simconnect_tick_observer::on_event(
    notify_all();
 }
 
+const tick_scheduler::duration tick_scheduler::DEFAULT_RESOLUTION(1);
+
+tick_scheduler::tick_scheduler(
+      const std::shared_ptr<boost::asio::io_service>& io_srv,
+      const duration& resolution)
+   : _io_service(io_srv),
+     _timer(*io_srv),
+     _resolution(resolution.count() > 0 ? resolution : DEFAULT_RESOLUTION),
+     _start(clock_type::now()),
+     _wheel(WHEEL_SIZE),
+     _current_slot(0),
+     _armed_slot(0),
+     _stopped(false)
+{}
+
+tick_scheduler::~tick_scheduler()
+{
+   stop();
+}
+
+tick_scheduler::tick_group&
+tick_scheduler::add_group(
+      const std::string& name,
+      const duration& period)
+throw (group_already_exists_error, invalid_period_error)
+{
+   if (period < _resolution)
+      OAC_THROW_EXCEPTION(invalid_period_error(name, period));
+
+   std::lock_guard<std::mutex> lock(_mutex);
+   if (_groups.find(name) != _groups.end())
+      OAC_THROW_EXCEPTION(group_already_exists_error(name));
+
+   auto grp = std::shared_ptr<tick_group>(
+         new tick_group(name, period, period.count() / _resolution.count()));
+   _groups[name] = grp;
+   schedule(*grp, elapsed_slots() + grp->_period_slots);
+   if (!_stopped && (_armed_slot <= _current_slot ||
+                     grp->_due_slot < _armed_slot))
+      arm();
+   return *grp;
+}
+
+tick_scheduler::tick_group&
+tick_scheduler::group(
+      const std::string& name)
+throw (no_such_group_error)
+{
+   std::lock_guard<std::mutex> lock(_mutex);
+   auto entry = _groups.find(name);
+   if (entry == _groups.end())
+      OAC_THROW_EXCEPTION(no_such_group_error(name));
+   return *entry->second;
+}
+
+void
+tick_scheduler::stop()
+{
+   std::lock_guard<std::mutex> lock(_mutex);
+   _stopped = true;
+   boost::system::error_code ec;
+   _timer.cancel(ec);
+}
+
+std::uint64_t
+tick_scheduler::elapsed_slots() const
+{
+   auto elapsed = boost::chrono::duration_cast<duration>(
+         clock_type::now() - _start);
+   return elapsed.count() / _resolution.count();
+}
+
+void
+tick_scheduler::schedule(
+      tick_group& grp,
+      std::uint64_t due_slot)
+{
+   grp._due_slot = due_slot;
+   _wheel[due_slot % WHEEL_SIZE].push_back(&grp);
+}
+
+void
+tick_scheduler::advance(
+      std::uint64_t slot,
+      std::vector<tick_group*>& due_groups)
+{
+   // Once a whole turn is visited, every slot was checked
+   auto first = _current_slot + 1;
+   if (slot >= WHEEL_SIZE)
+      first = std::max(first, slot - WHEEL_SIZE + 1);
+   for (auto s = first; s <= slot; s++)
+   {
+      auto& wheel_slot = _wheel[s % WHEEL_SIZE];
+      for (std::size_t i = 0; i < wheel_slot.size();)
+      {
+         auto grp = wheel_slot[i];
+         if (grp->_due_slot <= slot)
+         {
+            wheel_slot[i] = wheel_slot.back();
+            wheel_slot.pop_back();
+            due_groups.push_back(grp);
+         }
+         else
+            i++;
+      }
+   }
+   _current_slot = slot;
+}
+
+void
+tick_scheduler::arm()
+{
+   // Wake up on the nearest slot with a due group, or a turn later if
+   // none is due within this turn
+   auto next = _current_slot + WHEEL_SIZE;
+   for (auto s = _current_slot + 1; s < next; s++)
+   {
+      auto& wheel_slot = _wheel[s % WHEEL_SIZE];
+      auto due = std::find_if(
+            wheel_slot.begin(),
+            wheel_slot.end(),
+            [s](const tick_group* grp) { return grp->_due_slot == s; });
+      if (due != wheel_slot.end())
+      {
+         next = s;
+         break;
+      }
+   }
+
+   _armed_slot = next;
+   _timer.expires_at(_start + _resolution * duration::rep(next));
+   _timer.async_wait(
+         std::bind(&tick_scheduler::on_timer, this, std::placeholders::_1));
+}
+
+void
+tick_scheduler::on_timer(
+      const boost::system::error_code& ec)
+{
+   if (ec == boost::asio::error::operation_aborted)
+      return;
+
+   std::vector<tick_group*> due_groups;
+   {
+      // The timer may have been armed again while this wait completed
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (_stopped || _timer.expires_at() > clock_type::now())
+         return;
+      advance(std::max(_armed_slot, elapsed_slots()), due_groups);
+   }
+
+   for (auto grp : due_groups)
+      grp->tick();
+
+   std::lock_guard<std::mutex> lock(_mutex);
+   if (_stopped)
+      return;
+
+   // The handlers may take long, so the groups whose ticks passed meanwhile
+   // are scheduled for their next one
+   auto now = std::max(_current_slot, elapsed_slots());
+   for (auto grp : due_groups)
+   {
+      auto due = grp->_due_slot + grp->_period_slots;
+      if (due <= now)
+         due += ((now - due) / grp->_period_slots + 1) * grp->_period_slots;
+      schedule(*grp, due);
+   }
+   arm();
+}
+
 } // namespace oac
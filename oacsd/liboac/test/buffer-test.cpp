@@ -280,6 +280,25 @@ BOOST_AUTO_TEST_CASE(ShouldOperateWithMark)
    BOOST_CHECK_EQUAL(0, buff.available_for_write());
 }
 
+BOOST_AUTO_TEST_CASE(ShouldObtainReadRegion)
+{
+   linear_buffer buff(16);
+
+   stream::write_as<std::uint32_t>(buff, 1000);
+   stream::write_as<std::uint32_t>(buff, 1001);
+   stream::read_as<std::uint32_t>(buff);
+
+   auto region = buff.read_region();
+   BOOST_CHECK_EQUAL(4, boost::asio::buffer_size(region));
+   BOOST_CHECK_EQUAL(
+         1001,
+         *boost::asio::buffer_cast<const std::uint32_t*>(region));
+
+   BOOST_CHECK_EQUAL(4, buff.skip(16));
+   BOOST_CHECK_EQUAL(0, buff.available_for_read());
+   BOOST_CHECK_EQUAL(0, boost::asio::buffer_size(buff.read_region()));
+}
+
 BOOST_AUTO_TEST_SUITE_END();
 
 
@@ -526,6 +545,162 @@ BOOST_AUTO_TEST_CASE(ShouldOperateWithMark)
    BOOST_CHECK_EQUAL(16, buff.available_for_write());
 }
 
+BOOST_AUTO_TEST_CASE(ShouldObtainReadRegionAfterBroken)
+{
+   ring_buffer buff(16);
+   stream::write_as<std::uint32_t>(buff, 1000);
+   stream::write_as<std::uint32_t>(buff, 1001);
+   stream::write_as<std::uint32_t>(buff, 1002);
+   stream::write_as<std::uint32_t>(buff, 1003);
+   stream::read_as<std::uint32_t>(buff);
+   stream::read_as<std::uint32_t>(buff);
+   stream::write_as<std::uint32_t>(buff, 1004);
+
+   auto region = buff.read_region();
+   BOOST_CHECK_EQUAL(8, boost::asio::buffer_size(region));
+   BOOST_CHECK_EQUAL(
+         1002,
+         *boost::asio::buffer_cast<const std::uint32_t*>(region));
+
+   BOOST_CHECK_EQUAL(8, buff.skip(8));
+   BOOST_CHECK_EQUAL(4, buff.available_for_read());
+   BOOST_CHECK_EQUAL(12, buff.available_for_write());
+
+   region = buff.read_region();
+   BOOST_CHECK_EQUAL(4, boost::asio::buffer_size(region));
+   BOOST_CHECK_EQUAL(
+         1004,
+         *boost::asio::buffer_cast<const std::uint32_t*>(region));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+
+BOOST_AUTO_TEST_SUITE(SpscRingBufferTestSuite)
+
+BOOST_AUTO_TEST_CASE(ShouldRoundCapacityUpToPowerOfTwo)
+{
+   BOOST_CHECK_EQUAL(16, spsc_ring_buffer(16).capacity());
+   BOOST_CHECK_EQUAL(16, spsc_ring_buffer(12).capacity());
+   BOOST_CHECK_EQUAL(1, spsc_ring_buffer(0).capacity());
+}
+
+BOOST_AUTO_TEST_CASE(ShouldWriteAndReadAsStream)
+{
+   spsc_ring_buffer buff(16);
+   BOOST_CHECK_EQUAL(0, buff.available_for_read());
+   BOOST_CHECK_EQUAL(16, buff.available_for_write());
+
+   for (std::uint32_t i = 0; i < 4; i++)
+      stream::write_as<std::uint32_t>(buff, 1000 + i);
+   BOOST_CHECK_EQUAL(16, buff.available_for_read());
+   BOOST_CHECK_EQUAL(0, buff.available_for_write());
+   BOOST_CHECK_EQUAL(0, buff.write("x", 1));
+
+   for (std::uint32_t i = 0; i < 4; i++)
+      BOOST_CHECK_EQUAL(1000 + i, stream::read_as<std::uint32_t>(buff));
+   BOOST_CHECK_EQUAL(0, buff.available_for_read());
+   BOOST_CHECK_EQUAL(16, buff.available_for_write());
+}
+
+BOOST_AUTO_TEST_CASE(ShouldReadAndWriteAfterBroken)
+{
+   spsc_ring_buffer buff(16);
+   std::uint8_t data[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+   std::uint8_t result[12];
+
+   BOOST_CHECK_EQUAL(12, buff.write(data, 12));
+   BOOST_CHECK_EQUAL(8, buff.read(result, 8));
+   BOOST_CHECK_EQUAL(12, buff.write(data, 12));
+   BOOST_CHECK_EQUAL(16, buff.available_for_read());
+
+   BOOST_CHECK_EQUAL(4, buff.read(result, 4));
+   BOOST_CHECK_EQUAL(8, result[0]);
+   BOOST_CHECK_EQUAL(11, result[3]);
+   BOOST_CHECK_EQUAL(12, buff.read(result, 16));
+   for (std::uint8_t i = 0; i < 12; i++)
+      BOOST_CHECK_EQUAL(i, result[i]);
+   BOOST_CHECK_EQUAL(0, buff.available_for_read());
+}
+
+BOOST_AUTO_TEST_CASE(ShouldWriteAndReadRegionsInPlace)
+{
+   spsc_ring_buffer buff(16);
+   std::uint8_t data[12] = { 0 };
+   buff.write(data, 12);
+   buff.skip(12);
+
+   auto wregion = buff.write_region();
+   BOOST_CHECK_EQUAL(4, boost::asio::buffer_size(wregion));
+   *boost::asio::buffer_cast<std::uint32_t*>(wregion) = 1000;
+   BOOST_CHECK_EQUAL(0, buff.available_for_read());
+   BOOST_CHECK_EQUAL(4, buff.commit(4));
+
+   wregion = buff.write_region();
+   BOOST_CHECK_EQUAL(12, boost::asio::buffer_size(wregion));
+   *boost::asio::buffer_cast<std::uint32_t*>(wregion) = 1001;
+   BOOST_CHECK_EQUAL(4, buff.commit(4));
+   BOOST_CHECK_EQUAL(8, buff.available_for_read());
+
+   auto rregion = buff.read_region();
+   BOOST_CHECK_EQUAL(4, boost::asio::buffer_size(rregion));
+   BOOST_CHECK_EQUAL(
+         1000,
+         *boost::asio::buffer_cast<const std::uint32_t*>(rregion));
+   BOOST_CHECK_EQUAL(4, buff.skip(4));
+
+   rregion = buff.read_region();
+   BOOST_CHECK_EQUAL(4, boost::asio::buffer_size(rregion));
+   BOOST_CHECK_EQUAL(
+         1001,
+         *boost::asio::buffer_cast<const std::uint32_t*>(rregion));
+   BOOST_CHECK_EQUAL(4, buff.skip(16));
+   BOOST_CHECK_EQUAL(0, buff.available_for_read());
+}
+
+BOOST_AUTO_TEST_CASE(ShouldReadAndWriteLongFlowWithoutLocks)
+{
+   spsc_ring_buffer buff(1024);
+   const std::uint32_t top = 1024 * 1024;
+
+   boost::thread writer([&]() {
+      std::uint32_t counter = 0;
+      while (counter < top)
+      {
+         if (buff.available_for_write() >= sizeof(counter))
+         {
+            buff.write(&counter, sizeof(counter));
+            counter++;
+         }
+         else
+            boost::this_thread::yield();
+      }
+   });
+
+   std::uint32_t mismatches = 0;
+   boost::thread reader([&]() {
+      std::uint32_t counter = 0;
+      while (counter < top)
+      {
+         std::uint32_t value;
+         if (buff.available_for_read() >= sizeof(value))
+         {
+            buff.read(&value, sizeof(value));
+            if (value != counter)
+               mismatches++;
+            counter++;
+         }
+         else
+            boost::this_thread::yield();
+      }
+   });
+   writer.join();
+   reader.join();
+   BOOST_CHECK_EQUAL(0, mismatches);
+   BOOST_CHECK_EQUAL(0, buff.available_for_read());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 
@@ -828,3 +1003,104 @@ BOOST_AUTO_TEST_CASE(ShouldNotDetectModificationOnSameLastTwoValues)
 }
 
 BOOST_AUTO_TEST_SUITE_END()
+
+
+
+BOOST_AUTO_TEST_SUITE(BufferPoolTestSuite)
+
+BOOST_AUTO_TEST_CASE(ShouldCreateBuffersInAdvance)
+{
+   buffer_pool<linear_buffer> pool(
+         std::make_shared<linear_buffer::factory>(64), 4);
+   BOOST_CHECK_EQUAL(4, pool.size());
+   BOOST_CHECK_EQUAL(4, pool.available());
+}
+
+BOOST_AUTO_TEST_CASE(ShouldGrowWhenAllBuffersAreInUse)
+{
+   buffer_pool<linear_buffer> pool(
+         std::make_shared<linear_buffer::factory>(64), 1);
+   auto buff1 = pool.acquire();
+   auto buff2 = pool.acquire();
+   BOOST_CHECK(buff1 != buff2);
+   BOOST_CHECK_EQUAL(2, pool.size());
+   BOOST_CHECK_EQUAL(0, pool.available());
+}
+
+BOOST_AUTO_TEST_CASE(ShouldReuseBufferOnceReleased)
+{
+   buffer_pool<linear_buffer> pool(
+         std::make_shared<linear_buffer::factory>(64));
+   auto buff = pool.acquire();
+   auto raw = buff.get();
+   buff.reset();
+   BOOST_CHECK_EQUAL(1, pool.available());
+
+   buff = pool.acquire();
+   BOOST_CHECK_EQUAL(raw, buff.get());
+   BOOST_CHECK_EQUAL(1, pool.size());
+}
+
+BOOST_AUTO_TEST_CASE(ShouldAcquireEmptyBuffers)
+{
+   buffer_pool<linear_buffer> pool(
+         std::make_shared<linear_buffer::factory>(64));
+   auto buff = pool.acquire();
+   stream::write_as<std::uint32_t>(*buff, 1001);
+   buff->set_mark();
+   buff.reset();
+
+   buff = pool.acquire();
+   BOOST_CHECK_EQUAL(0, buff->available_for_read());
+   BOOST_CHECK_EQUAL(64, buff->available_for_write());
+   BOOST_CHECK(!buff->mark());
+}
+
+BOOST_AUTO_TEST_CASE(ShouldDestroyBuffersReleasedBeyondMaxAvailable)
+{
+   buffer_pool<linear_buffer> pool(
+         std::make_shared<linear_buffer::factory>(64), 0, 2);
+   std::vector<linear_buffer::ptr_type> buffs;
+   for (int i = 0; i < 5; i++)
+      buffs.push_back(pool.acquire());
+   BOOST_CHECK_EQUAL(5, pool.size());
+
+   buffs.clear();
+   BOOST_CHECK_EQUAL(2, pool.size());
+   BOOST_CHECK_EQUAL(2, pool.available());
+}
+
+BOOST_AUTO_TEST_CASE(ShouldReleaseBuffersThatOutliveThePool)
+{
+   linear_buffer::ptr_type buff;
+   {
+      buffer_pool<linear_buffer> pool(
+            std::make_shared<linear_buffer::factory>(64), 2);
+      buff = pool.acquire();
+   }
+   stream::write_as<std::uint32_t>(*buff, 1001);
+   BOOST_CHECK_NO_THROW(buff.reset());
+}
+
+BOOST_AUTO_TEST_CASE(ShouldKeepBuffersWhenUsedFromSeveralThreads)
+{
+   buffer_pool<linear_buffer> pool(
+         std::make_shared<linear_buffer::factory>(64), 0, 8);
+   boost::thread_group threads;
+   for (int i = 0; i < 4; i++)
+      threads.create_thread([&pool]()
+      {
+         for (int j = 0; j < 10000; j++)
+         {
+            auto buff1 = pool.acquire();
+            auto buff2 = pool.acquire();
+            stream::write_as<std::uint32_t>(*buff1, j);
+            stream::write_as<std::uint32_t>(*buff2, j);
+         }
+      });
+   threads.join_all();
+   BOOST_CHECK(pool.size() <= 8);
+   BOOST_CHECK_EQUAL(pool.size(), pool.available());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
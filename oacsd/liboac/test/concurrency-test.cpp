@@ -16,6 +16,11 @@
  * along with Open Airbus Cockpit. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
 #define BOOST_AUTO_TEST_MAIN
 #include <boost/test/auto_unit_test.hpp>
 
@@ -98,4 +103,245 @@ BOOST_AUTO_TEST_CASE(ShouldExecuteLambdaWithArityTwo)
    srv.stop();
 }
 
+BOOST_AUTO_TEST_CASE(ShouldExecuteFunctionReturningVoid)
+{
+   oac::async_executor srv;
+   int num = 0;
+   auto result = srv.execute([&num]() { num = 7; });
+   srv.run_in_background();
+
+   result.get();
+   BOOST_CHECK_EQUAL(7, num);
+   srv.stop();
+}
+
+BOOST_AUTO_TEST_CASE(ShouldDeliverExceptionOfFunction)
+{
+   oac::async_executor srv;
+   auto result = srv.execute([]() -> int { throw std::runtime_error("x"); });
+   srv.run_in_background();
+
+   BOOST_CHECK_THROW(result.get(), std::runtime_error);
+   srv.stop();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+
+BOOST_AUTO_TEST_SUITE(ThreadPoolTest)
+
+int get_seven(void) { return 7; }
+
+BOOST_AUTO_TEST_CASE(ShouldExecuteFunctionReturningValue)
+{
+   oac::thread_pool pool(2);
+   auto result = pool.submit(&get_seven);
+   BOOST_CHECK_EQUAL(7, result.get());
+}
+
+BOOST_AUTO_TEST_CASE(ShouldExecuteFunctionReturningVoid)
+{
+   oac::thread_pool pool(2);
+   int num = 0;
+   auto result = pool.submit([&num]() { num = 7; });
+   result.get();
+   BOOST_CHECK_EQUAL(7, num);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldExecuteMoveOnlyFunction)
+{
+   struct move_only
+   {
+      std::unique_ptr<int> value;
+
+      move_only(int v) : value(new int(v)) {}
+      move_only(move_only&& other) : value(std::move(other.value)) {}
+
+      int operator()() { return *value; }
+
+   private:
+
+      move_only(const move_only&);
+   };
+
+   oac::thread_pool pool(2);
+   auto result = pool.submit(move_only(7));
+   BOOST_CHECK_EQUAL(7, result.get());
+}
+
+BOOST_AUTO_TEST_CASE(ShouldDeliverExceptionOfFunction)
+{
+   oac::thread_pool pool(2);
+   auto result = pool.submit([]() -> int { throw std::runtime_error("x"); });
+   BOOST_CHECK_THROW(result.get(), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldExecuteJobsSubmittedFromJobs)
+{
+   oac::thread_pool pool(4);
+   std::atomic<int> count(0);
+   std::vector<std::future<void>> results;
+   for (int i = 0; i < 100; i++)
+   {
+      results.push_back(pool.submit([&pool, &count]()
+      {
+         for (int j = 0; j < 10; j++)
+            pool.post([&count]() { count++; });
+      }));
+   }
+   for (auto& result : results)
+      result.get();
+   pool.stop();
+   BOOST_CHECK_EQUAL(1000, count);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldStealJobsFromBusyWorkers)
+{
+   oac::thread_pool pool(2);
+   std::vector<std::future<void>> results;
+
+   // A job on a worker submits the others to itself while the second
+   // worker is idle
+   pool.submit([&pool, &results]()
+   {
+      for (int i = 0; i < 8; i++)
+      {
+         results.push_back(pool.submit([]()
+         {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+         }));
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+   }).get();
+   for (auto& result : results)
+      result.get();
+   BOOST_CHECK_GT(pool.stolen_jobs(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(ShouldThrowOnSubmittingToStoppedPool)
+{
+   oac::thread_pool pool(2);
+   pool.stop();
+   BOOST_CHECK_THROW(
+         pool.post([]() {}),
+         oac::thread_pool::pool_stopped_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+
+BOOST_AUTO_TEST_SUITE(StrandTest)
+
+BOOST_AUTO_TEST_CASE(ShouldExecuteJobsInSubmissionOrder)
+{
+   oac::thread_pool pool(4);
+   oac::strand s1(pool), s2(pool);
+   std::vector<int> seq1, seq2;
+   std::future<void> last1, last2;
+   for (int i = 0; i < 1000; i++)
+   {
+      last1 = s1.submit([&seq1, i]() { seq1.push_back(i); });
+      last2 = s2.submit([&seq2, i]() { seq2.push_back(i); });
+   }
+   last1.get();
+   last2.get();
+
+   BOOST_REQUIRE_EQUAL(1000, seq1.size());
+   BOOST_REQUIRE_EQUAL(1000, seq2.size());
+   for (int i = 0; i < 1000; i++)
+   {
+      BOOST_CHECK_EQUAL(i, seq1[i]);
+      BOOST_CHECK_EQUAL(i, seq2[i]);
+   }
+}
+
+BOOST_AUTO_TEST_CASE(ShouldNotExecuteJobsConcurrently)
+{
+   oac::thread_pool pool(4);
+   oac::strand s(pool);
+   std::atomic<int> running(0);
+   std::atomic<int> overlaps(0);
+   std::vector<std::future<void>> results;
+   for (int i = 0; i < 200; i++)
+   {
+      results.push_back(s.submit([&]()
+      {
+         if (running++ > 0)
+            overlaps++;
+         std::this_thread::yield();
+         running--;
+      }));
+   }
+   for (auto& result : results)
+      result.get();
+   BOOST_CHECK_EQUAL(0, overlaps);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+
+BOOST_AUTO_TEST_SUITE(ExecutorBenchmark)
+
+int power_of_two(int i) { return i*i; }
+
+BOOST_AUTO_TEST_CASE(ShouldExecuteEverySmallJobOfManyProducers)
+{
+   const int NPRODUCERS = 4;
+   const int NJOBS = 20000;
+
+   // Several producers submit small jobs with no result and wait for all
+   // of them, so the async_executor serves as the baseline of the pool
+   auto run = [&](const std::function<std::future<void>(int)>& submit)
+   {
+      auto start = std::chrono::steady_clock::now();
+      std::vector<std::thread> producers;
+      for (int p = 0; p < NPRODUCERS; p++)
+      {
+         producers.push_back(std::thread([&]()
+         {
+            std::vector<std::future<void>> results;
+            for (int i = 0; i < NJOBS / NPRODUCERS; i++)
+               results.push_back(submit(i));
+            for (auto& result : results)
+               result.get();
+         }));
+      }
+      for (auto& producer : producers)
+         producer.join();
+      return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+   };
+
+   std::atomic<long long> executor_sum(0);
+   oac::async_executor executor;
+   executor.run_in_background();
+   auto executor_time = run([&executor, &executor_sum](int i)
+   {
+      return executor.execute([&executor_sum, i]()
+      {
+         executor_sum += power_of_two(i);
+      });
+   });
+   executor.stop();
+
+   std::atomic<long long> pool_sum(0);
+   oac::thread_pool pool;
+   auto pool_time = run([&pool, &pool_sum](int i)
+   {
+      return pool.submit([&pool_sum, i]() { pool_sum += power_of_two(i); });
+   });
+
+   BOOST_TEST_MESSAGE(
+         NJOBS << " jobs took " << executor_time << " us on async_executor, " <<
+         pool_time << " us on thread_pool of " << pool.size() << " threads");
+   long long expected = 0;
+   for (int i = 0; i < NJOBS / NPRODUCERS; i++)
+      expected += NPRODUCERS * power_of_two(i);
+   BOOST_CHECK_EQUAL(expected, executor_sum.load());
+   BOOST_CHECK_EQUAL(expected, pool_sum.load());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -16,10 +16,15 @@
  * along with Open Airbus Cockpit.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <fstream>
+#include <map>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 #define BOOST_AUTO_TEST_MAIN
 #include <boost/test/auto_unit_test.hpp>
+#include <boost/chrono.hpp>
 #include <boost/thread.hpp>
 
 #include <liboac/buffer.h>
@@ -185,6 +190,173 @@ BOOST_AUTO_TEST_CASE(MustQueryAfterUpdate)
          .must_return(0x704, OFFSET_LEN_WORD, 0x0506);
 }
 
+BOOST_AUTO_TEST_CASE(MustQueryOverlappingOffsets)
+{
+   let_test()
+         .with_offset(0x700, OFFSET_LEN_DWORD, 0x01020304)
+         .with_query_input(0x700, OFFSET_LEN_DWORD)
+         .with_query_input(0x702, OFFSET_LEN_WORD)
+         .with_query_input(0x703, OFFSET_LEN_BYTE)
+         .query()
+         .results_count_is(3)
+         .must_return(0x700, OFFSET_LEN_DWORD, 0x01020304)
+         .must_return(0x702, OFFSET_LEN_WORD, 0x0102)
+         .must_return(0x703, OFFSET_LEN_BYTE, 0x01);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+
+BOOST_AUTO_TEST_SUITE(FsuipcReadPlan)
+
+BOOST_AUTO_TEST_CASE(MustMergeAdjacentAndOverlappingOffsets)
+{
+   std::list<offset> offsets;
+   offsets.push_back(offset(0x704, OFFSET_LEN_WORD));
+   offsets.push_back(offset(0x700, OFFSET_LEN_DWORD));
+   offsets.push_back(offset(0x702, OFFSET_LEN_DWORD));
+   read_plan plan(0);
+   plan.reset(offsets);
+
+   BOOST_REQUIRE_EQUAL(1, plan.blocks().size());
+   BOOST_CHECK_EQUAL(0x700, plan.blocks()[0].address);
+   BOOST_CHECK_EQUAL(6, plan.blocks()[0].length);
+   BOOST_CHECK_EQUAL(6, plan.buffer_size());
+   BOOST_REQUIRE_EQUAL(3, plan.offsets().size());
+   BOOST_CHECK_EQUAL(0, plan.offsets()[0].position);
+   BOOST_CHECK_EQUAL(2, plan.offsets()[1].position);
+   BOOST_CHECK_EQUAL(4, plan.offsets()[2].position);
+}
+
+BOOST_AUTO_TEST_CASE(MustMergeOffsetsWithinGapTolerance)
+{
+   std::list<offset> offsets;
+   offsets.push_back(offset(0x700, OFFSET_LEN_BYTE));
+   offsets.push_back(offset(0x708, OFFSET_LEN_BYTE));
+   offsets.push_back(offset(0x720, OFFSET_LEN_WORD));
+   read_plan plan(8);
+   plan.reset(offsets);
+
+   BOOST_REQUIRE_EQUAL(2, plan.blocks().size());
+   BOOST_CHECK_EQUAL(0x700, plan.blocks()[0].address);
+   BOOST_CHECK_EQUAL(9, plan.blocks()[0].length);
+   BOOST_CHECK_EQUAL(0, plan.blocks()[0].position);
+   BOOST_CHECK_EQUAL(0x720, plan.blocks()[1].address);
+   BOOST_CHECK_EQUAL(2, plan.blocks()[1].length);
+   BOOST_CHECK_EQUAL(9, plan.blocks()[1].position);
+   BOOST_CHECK_EQUAL(11, plan.buffer_size());
+   BOOST_CHECK_EQUAL(9, plan.offsets()[2].position);
+}
+
+BOOST_AUTO_TEST_CASE(MustRemoveRepeatedOffsets)
+{
+   std::list<offset> offsets;
+   offsets.push_back(offset(0x700, OFFSET_LEN_WORD));
+   offsets.push_back(offset(0x700, OFFSET_LEN_WORD));
+   read_plan plan;
+   plan.reset(offsets);
+
+   BOOST_CHECK_EQUAL(1, plan.offsets().size());
+   BOOST_CHECK_EQUAL(1, plan.blocks().size());
+}
+
+BOOST_AUTO_TEST_CASE(MustSliceLittleEndianValues)
+{
+   std::uint8_t buffer[] = { 0x04, 0x03, 0x02, 0x01 };
+   read_plan::planned_offset dword = { offset(0x700, OFFSET_LEN_DWORD), 0 };
+   read_plan::planned_offset word = { offset(0x702, OFFSET_LEN_WORD), 2 };
+   BOOST_CHECK_EQUAL(0x01020304, read_plan::slice(dword, buffer));
+   BOOST_CHECK_EQUAL(0x0102, read_plan::slice(word, buffer));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+
+BOOST_AUTO_TEST_SUITE(FsuipcShadowMemory)
+
+BOOST_AUTO_TEST_CASE(MustReportNoChangesForSameData)
+{
+   std::uint8_t data[] = { 0x04, 0x03, 0x02, 0x01 };
+   shadow_memory shadow;
+   shadow.update(0x700, data, sizeof(data));
+   shadow.clear_changes();
+   shadow.update(0x700, data, sizeof(data));
+
+   BOOST_CHECK(shadow.changes().empty());
+   BOOST_CHECK(!shadow.is_dirty(offset(0x700, OFFSET_LEN_DWORD)));
+   BOOST_CHECK_EQUAL(
+         0x01020304, shadow.read(offset(0x700, OFFSET_LEN_DWORD)));
+}
+
+BOOST_AUTO_TEST_CASE(MustReportChangedByteRanges)
+{
+   std::uint8_t data[20] = { 0 };
+   shadow_memory shadow;
+   shadow.update(0x700, data, sizeof(data));
+
+   data[1] = 0x01;
+   data[2] = 0x02;
+   data[9] = 0x03;
+   data[18] = 0x04;
+   shadow.update(0x700, data, sizeof(data));
+
+   auto& changes = shadow.changes();
+   BOOST_REQUIRE_EQUAL(3, changes.size());
+   BOOST_CHECK_EQUAL(0x701, changes[0].begin);
+   BOOST_CHECK_EQUAL(0x703, changes[0].end);
+   BOOST_CHECK_EQUAL(0x709, changes[1].begin);
+   BOOST_CHECK_EQUAL(0x70a, changes[1].end);
+   BOOST_CHECK_EQUAL(0x712, changes[2].begin);
+   BOOST_CHECK_EQUAL(0x713, changes[2].end);
+   BOOST_CHECK(shadow.is_dirty(offset(0x700, OFFSET_LEN_WORD)));
+   BOOST_CHECK(!shadow.is_dirty(offset(0x703, OFFSET_LEN_DWORD)));
+   BOOST_CHECK(shadow.is_dirty(offset(0x708, OFFSET_LEN_WORD)));
+   BOOST_CHECK_EQUAL(0x0201, shadow.read(offset(0x701, OFFSET_LEN_WORD)));
+}
+
+BOOST_AUTO_TEST_CASE(MustSortAndMergeChangesOfUnorderedUpdates)
+{
+   std::uint8_t data[] = { 0x01, 0x02 };
+   shadow_memory shadow;
+   shadow.update(0x802, data, sizeof(data));
+   shadow.update(0x800, data, sizeof(data));
+   shadow.update(0x700, data, sizeof(data));
+
+   auto& changes = shadow.changes();
+   BOOST_REQUIRE_EQUAL(2, changes.size());
+   BOOST_CHECK_EQUAL(0x700, changes[0].begin);
+   BOOST_CHECK_EQUAL(0x702, changes[0].end);
+   BOOST_CHECK_EQUAL(0x800, changes[1].begin);
+   BOOST_CHECK_EQUAL(0x804, changes[1].end);
+}
+
+BOOST_AUTO_TEST_CASE(MustForgetChangesWhenCleared)
+{
+   std::uint8_t data[] = { 0x01, 0x02 };
+   shadow_memory shadow;
+   shadow.update(0x700, data, sizeof(data));
+   shadow.clear_changes();
+
+   BOOST_CHECK(shadow.changes().empty());
+   BOOST_CHECK(!shadow.is_dirty(offset(0x700, OFFSET_LEN_WORD)));
+   BOOST_CHECK_EQUAL(0x0201, shadow.read(offset(0x700, OFFSET_LEN_WORD)));
+}
+
+BOOST_AUTO_TEST_CASE(MustIgnoreDataBeyondAddressSpace)
+{
+   std::uint8_t data[] = { 0x01, 0x02, 0x03, 0x04 };
+   shadow_memory shadow;
+   shadow.update(0xfffe, data, sizeof(data));
+
+   auto& changes = shadow.changes();
+   BOOST_REQUIRE_EQUAL(1, changes.size());
+   BOOST_CHECK_EQUAL(0xfffe, changes[0].begin);
+   BOOST_CHECK_EQUAL(0x10000, changes[0].end);
+   BOOST_CHECK_EQUAL(0x0201, shadow.read(offset(0xfffe, OFFSET_LEN_WORD)));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 
@@ -227,6 +399,33 @@ struct let_test
       return *this;
    }
 
+   let_test& with_polling_policy(
+            std::size_t cold_period,
+            std::size_t cooldown)
+   {
+      _observer.set_polling_policy(
+            observer_type::polling_policy(cold_period, cooldown));
+      return *this;
+   }
+
+   let_test& pin(
+            offset_address addr,
+            offset_length len,
+            std::size_t checks)
+   {
+      _observer.set_max_polling_period(offset(addr, len), checks);
+      return *this;
+   }
+
+   let_test& write(
+            offset_address addr,
+            offset_length len,
+            offset_value val)
+   {
+      _observer.write(valued_offset(addr, len, val));
+      return *this;
+   }
+
    let_test& check_for_updates()
    {
       _observer.check_for_updates();
@@ -261,9 +460,67 @@ struct let_test
       return *this;
    }
 
+   let_test& assert_read_blocks_count(std::size_t count)
+   {
+      BOOST_CHECK_EQUAL(count, _observer.get_read_plan().blocks().size());
+      return *this;
+   }
+
+   let_test& assert_offset_value(
+            offset_address addr,
+            offset_length len,
+            offset_value val)
+   {
+      BOOST_CHECK_EQUAL(
+            val,
+            _observer.get_client().user_adapter().read_value_from_buffer(
+                  addr, len));
+      return *this;
+   }
+
+   let_test& assert_write_stats(
+            std::size_t batched,
+            std::size_t overwritten,
+            std::size_t suppressed)
+   {
+      auto stats = _observer.get_write_stats();
+      BOOST_CHECK_EQUAL(batched, stats.batched);
+      BOOST_CHECK_EQUAL(overwritten, stats.overwritten);
+      BOOST_CHECK_EQUAL(suppressed, stats.suppressed);
+      return *this;
+   }
+
+   let_test& assert_polling_stats(std::size_t hot, std::size_t cold)
+   {
+      auto stats = _observer.get_polling_stats();
+      BOOST_CHECK_EQUAL(hot, stats.hot_offsets);
+      BOOST_CHECK_EQUAL(cold, stats.cold_offsets);
+      return *this;
+   }
+
+   let_test& assert_process_calls_per_check(std::size_t count)
+   {
+      auto& adapter = _observer.get_client().user_adapter();
+      auto before = adapter.process_count();
+      _observer.check_for_updates();
+      BOOST_CHECK_EQUAL(count, adapter.process_count() - before);
+      return *this;
+   }
+
+   let_test& assert_reads_per_check(std::size_t count)
+   {
+      auto& adapter = _observer.get_client().user_adapter();
+      auto before = adapter.read_count();
+      _observer.check_for_updates();
+      BOOST_CHECK_EQUAL(count, adapter.read_count() - before);
+      return *this;
+   }
+
 private:
 
-   update_observer<dummy_user_adapter> _observer;
+   typedef update_observer<dummy_user_adapter> observer_type;
+
+   observer_type _observer;
    std::list<valued_offset> _updates;
 
    void on_offset_update(const valued_offset& update)
@@ -338,4 +595,713 @@ BOOST_AUTO_TEST_CASE(MustNotObserveOffsetUpdateAfterReobserving)
          .assert_updates_count(1);
 }
 
+BOOST_AUTO_TEST_CASE(MustObserveOnlyOverlappingOffsetsOnChange)
+{
+   let_test()
+         .observe(0x700, OFFSET_LEN_DWORD)
+         .observe(0x702, OFFSET_LEN_WORD)
+         .observe(0x704, OFFSET_LEN_WORD)
+         .check_for_updates()
+         .and_then()
+         .then_offset_changes(0x703, OFFSET_LEN_BYTE, 0x0a)
+         .check_for_updates()
+         .assert_updates_count(2)
+         .assert_update(0x700, OFFSET_LEN_DWORD, 0x0a000000)
+         .assert_update(0x702, OFFSET_LEN_WORD, 0x0a00);
+}
+
+BOOST_AUTO_TEST_CASE(MustNotObserveChangesInUnobservedBytesOfBlock)
+{
+   let_test()
+         .observe(0x700, OFFSET_LEN_BYTE)
+         .observe(0x708, OFFSET_LEN_BYTE)
+         .assert_read_blocks_count(1)
+         .check_for_updates()
+         .and_then()
+         .then_offset_changes(0x704, OFFSET_LEN_WORD, 0x0102)
+         .check_for_updates()
+         .assert_updates_count(0);
+}
+
+BOOST_AUTO_TEST_CASE(MustObserveChangeOnOffsetOverlappingNewlyObservedOne)
+{
+   let_test()
+         .observe(0x700, OFFSET_LEN_DWORD)
+         .check_for_updates()
+         .and_then()
+         .then_offset_changes(0x702, OFFSET_LEN_WORD, 0x0102)
+         .observe(0x702, OFFSET_LEN_WORD)
+         .check_for_updates()
+         .assert_updates_count(2)
+         .assert_update(0x700, OFFSET_LEN_DWORD, 0x01020000)
+         .assert_update(0x702, OFFSET_LEN_WORD, 0x0102);
+}
+
+BOOST_AUTO_TEST_CASE(MustWriteOnNextCheckAlongWithReads)
+{
+   let_test()
+         .observe(0x700, OFFSET_LEN_DWORD)
+         .check_for_updates()
+         .and_then()
+         .write(0x700, OFFSET_LEN_DWORD, 0x01020304)
+         .write(0x704, OFFSET_LEN_WORD, 0x0506)
+         .assert_updates_count(0)
+         .assert_process_calls_per_check(1)
+         .assert_offset_value(0x700, OFFSET_LEN_DWORD, 0x01020304)
+         .assert_offset_value(0x704, OFFSET_LEN_WORD, 0x0506)
+         .assert_updates_count(1)
+         .assert_update(0x700, OFFSET_LEN_DWORD, 0x01020304)
+         .assert_write_stats(2, 0, 0);
+}
+
+BOOST_AUTO_TEST_CASE(MustWriteOnlyLastValueOfOffset)
+{
+   let_test()
+         .write(0x700, OFFSET_LEN_WORD, 0x0102)
+         .write(0x700, OFFSET_LEN_WORD, 0x0304)
+         .write(0x700, OFFSET_LEN_WORD, 0x0506)
+         .check_for_updates()
+         .assert_offset_value(0x700, OFFSET_LEN_WORD, 0x0506)
+         .assert_write_stats(1, 2, 0);
+}
+
+BOOST_AUTO_TEST_CASE(MustSuppressWriteOfCurrentValue)
+{
+   let_test()
+         .then_offset_changes(0x700, OFFSET_LEN_WORD, 0x0102)
+         .observe(0x700, OFFSET_LEN_WORD)
+         .check_for_updates()
+         .write(0x700, OFFSET_LEN_WORD, 0x0102)
+         .check_for_updates()
+         .assert_write_stats(0, 0, 1);
+}
+
+BOOST_AUTO_TEST_CASE(MustCancelPendingWriteWhenCurrentValueIsWrittenBack)
+{
+   let_test()
+         .then_offset_changes(0x700, OFFSET_LEN_BYTE, 0x0a)
+         .observe(0x700, OFFSET_LEN_BYTE)
+         .check_for_updates()
+         .and_then()
+         .write(0x700, OFFSET_LEN_BYTE, 0x0b)
+         .write(0x700, OFFSET_LEN_BYTE, 0x0a)
+         .check_for_updates()
+         .assert_offset_value(0x700, OFFSET_LEN_BYTE, 0x0a)
+         .assert_updates_count(0)
+         .assert_write_stats(0, 1, 1);
+}
+
+BOOST_AUTO_TEST_CASE(MustNotSuppressWriteOfUnobservedOffset)
+{
+   let_test()
+         .write(0x700, OFFSET_LEN_BYTE, 0)
+         .check_for_updates()
+         .assert_write_stats(1, 0, 0);
+}
+
+BOOST_AUTO_TEST_CASE(MustPollColdOffsetsOnceEveryColdPeriod)
+{
+   let_test()
+         .with_polling_policy(3, 3)
+         .observe(0x700, OFFSET_LEN_BYTE)
+         .observe(0x900, OFFSET_LEN_BYTE)
+         .assert_reads_per_check(2)
+         .assert_reads_per_check(2)
+         .assert_reads_per_check(2)
+         .assert_polling_stats(0, 2)
+         .and_then()
+         .then_offset_changes(0x700, OFFSET_LEN_BYTE, 0x0a)
+         .assert_reads_per_check(0)
+         .assert_reads_per_check(0)
+         .assert_updates_count(0)
+         .assert_reads_per_check(2)
+         .assert_updates_count(1)
+         .assert_update(0x700, OFFSET_LEN_BYTE, 0x0a)
+         .assert_polling_stats(1, 1)
+         .assert_reads_per_check(1);
+}
+
+BOOST_AUTO_TEST_CASE(MustKeepPinnedOffsetsHot)
+{
+   let_test()
+         .with_polling_policy(3, 0)
+         .observe(0x700, OFFSET_LEN_BYTE)
+         .observe(0x900, OFFSET_LEN_BYTE)
+         .pin(0x700, OFFSET_LEN_BYTE, 2)
+         .check_for_updates()
+         .check_for_updates()
+         .check_for_updates()
+         .assert_polling_stats(1, 1)
+         .and_then()
+         .then_offset_changes(0x700, OFFSET_LEN_BYTE, 0x0a)
+         .assert_reads_per_check(1)
+         .assert_updates_count(1)
+         .assert_update(0x700, OFFSET_LEN_BYTE, 0x0a);
+}
+
+BOOST_AUTO_TEST_CASE(MustPollAllOffsetsOnEachCheckByDefault)
+{
+   let_test()
+         .observe(0x700, OFFSET_LEN_BYTE)
+         .observe(0x900, OFFSET_LEN_BYTE)
+         .check_for_updates()
+         .check_for_updates()
+         .check_for_updates()
+         .assert_polling_stats(2, 0)
+         .assert_reads_per_check(2);
+}
+
+BOOST_AUTO_TEST_CASE(MustNotSuppressWriteOfColdOffset)
+{
+   let_test()
+         .with_polling_policy(2, 0)
+         .then_offset_changes(0x700, OFFSET_LEN_BYTE, 0x0a)
+         .observe(0x700, OFFSET_LEN_BYTE)
+         .check_for_updates()
+         .check_for_updates()
+         .assert_polling_stats(0, 1)
+         .write(0x700, OFFSET_LEN_BYTE, 0x0a)
+         .check_for_updates()
+         .assert_write_stats(1, 0, 0);
+}
+
+BOOST_AUTO_TEST_CASE(MustNotLoseWritesRequestedWhileChecking)
+{
+   const std::size_t NWRITES = 2000;
+
+   update_observer<dummy_user_adapter> observer(
+         [](const valued_offset&) {});
+   observer.start_observing(offset(0x700, OFFSET_LEN_WORD));
+
+   boost::thread writer([&observer, NWRITES]()
+   {
+      for (std::size_t i = 0; i < NWRITES; i++)
+         observer.write(valued_offset(
+               offset(offset_address(0x1000 + i * 2), OFFSET_LEN_WORD),
+               offset_value(i)));
+   });
+   while (!writer.timed_join(boost::posix_time::milliseconds(0)))
+      observer.check_for_updates();
+   observer.check_for_updates();
+
+   auto& adapter = observer.get_client().user_adapter();
+   for (std::size_t i = 0; i < NWRITES; i++)
+      BOOST_CHECK_EQUAL(
+            offset_value(i),
+            adapter.read_value_from_buffer(0x1000 + i * 2, OFFSET_LEN_WORD));
+   BOOST_CHECK_EQUAL(NWRITES, observer.get_write_stats().batched);
+}
+
+BOOST_AUTO_TEST_CASE(MustReadAdjacentOffsetsInSingleBlock)
+{
+   let_test()
+         .observe(0x700, OFFSET_LEN_DWORD)
+         .observe(0x704, OFFSET_LEN_WORD)
+         .observe(0x706, OFFSET_LEN_BYTE)
+         .observe(0x900, OFFSET_LEN_BYTE)
+         .assert_read_blocks_count(2)
+         .assert_reads_per_check(2)
+         .and_then()
+         .then_offset_changes(0x706, OFFSET_LEN_BYTE, 0x0a)
+         .then_offset_changes(0x900, OFFSET_LEN_BYTE, 0x0b)
+         .check_for_updates()
+         .assert_updates_count(2)
+         .assert_update(0x706, OFFSET_LEN_BYTE, 0x0a)
+         .assert_update(0x900, OFFSET_LEN_BYTE, 0x0b)
+         .and_then()
+         .unobserve(0x900, OFFSET_LEN_BYTE)
+         .assert_read_blocks_count(1);
+}
+
+BOOST_AUTO_TEST_CASE(MustCoalesceThousandsOfOffsets)
+{
+   const std::size_t NOFFSETS = 4096;
+   const std::size_t NCHECKS = 100;
+
+   // Observe a word every 12 bytes, so they are merged with the default
+   // gap tolerance
+   std::vector<offset> offsets;
+   for (std::size_t i = 0; i < NOFFSETS; i++)
+      offsets.push_back(offset(offset_address(i * 12), OFFSET_LEN_WORD));
+
+   std::size_t updates = 0;
+   update_observer<dummy_user_adapter> observer(
+         [&updates](const valued_offset&) { updates++; });
+   observer.start_observing(offsets);
+   observer.check_for_updates();
+   BOOST_CHECK_EQUAL(NOFFSETS, updates);
+   BOOST_CHECK_EQUAL(1, observer.get_read_plan().blocks().size());
+
+   // Compare the time spent checking for updates with the time spent
+   // reading each offset on its own
+   auto& adapter = observer.get_client().user_adapter();
+   auto start = boost::chrono::steady_clock::now();
+   for (std::size_t i = 0; i < NCHECKS; i++)
+      observer.check_for_updates();
+   auto planned = boost::chrono::steady_clock::now() - start;
+
+   std::list<valued_offset> values;
+   start = boost::chrono::steady_clock::now();
+   for (std::size_t i = 0; i < NCHECKS; i++)
+   {
+      values.clear();
+      for (auto& o : offsets)
+      {
+         values.push_back(valued_offset(o, 0));
+         adapter.read(values.back());
+      }
+      adapter.process();
+   }
+   auto unplanned = boost::chrono::steady_clock::now() - start;
+
+   using boost::chrono::duration_cast;
+   using boost::chrono::microseconds;
+   BOOST_TEST_MESSAGE(
+         "Checking " << NOFFSETS << " offsets " << NCHECKS << " times took " <<
+         duration_cast<microseconds>(planned).count() <<
+         " us with block reads and " <<
+         duration_cast<microseconds>(unplanned).count() <<
+         " us with one read per offset");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+
+BOOST_AUTO_TEST_SUITE(FsuipcSimulator)
+
+typedef simulator_user_adapter::duration sim_duration;
+
+BOOST_AUTO_TEST_CASE(MustFollowRampAndStartOver)
+{
+   offset o(0x700, OFFSET_LEN_WORD);
+   simulator_user_adapter sim;
+   sim.add_ramp(o, 10, 30, 10, sim_duration(100));
+
+   BOOST_CHECK_EQUAL(10, sim.get_value(o));
+   sim.advance(sim_duration(99));
+   BOOST_CHECK_EQUAL(10, sim.get_value(o));
+   sim.advance(sim_duration(1));
+   BOOST_CHECK_EQUAL(20, sim.get_value(o));
+   sim.advance(sim_duration(100));
+   BOOST_CHECK_EQUAL(30, sim.get_value(o));
+   sim.advance(sim_duration(100));
+   BOOST_CHECK_EQUAL(10, sim.get_value(o));
+}
+
+BOOST_AUTO_TEST_CASE(MustFollowDescendingRamp)
+{
+   offset o(0x700, OFFSET_LEN_BYTE);
+   simulator_user_adapter sim;
+   sim.add_ramp(o, 20, 0, 5, sim_duration(10));
+   sim.advance(sim_duration(40));
+   BOOST_CHECK_EQUAL(0, sim.get_value(o));
+   sim.advance(sim_duration(10));
+   BOOST_CHECK_EQUAL(20, sim.get_value(o));
+}
+
+BOOST_AUTO_TEST_CASE(MustProduceSameNoiseForSameSeed)
+{
+   offset o(0x700, OFFSET_LEN_BYTE);
+   simulator_user_adapter sim1(1234), sim2(1234);
+   sim1.add_noise(o, 100, 5, sim_duration(10));
+   sim2.add_noise(o, 100, 5, sim_duration(10));
+   for (int i = 0; i < 100; i++)
+   {
+      sim1.advance(sim_duration(10));
+      sim2.advance(sim_duration(10));
+      BOOST_CHECK_EQUAL(sim1.get_value(o), sim2.get_value(o));
+      BOOST_CHECK_GE(sim1.get_value(o), 95);
+      BOOST_CHECK_LE(sim1.get_value(o), 105);
+   }
+}
+
+BOOST_AUTO_TEST_CASE(MustCycleThroughSteps)
+{
+   offset o(0x700, OFFSET_LEN_DWORD);
+   std::vector<offset_value> values;
+   values.push_back(0x01020304);
+   values.push_back(0x05060708);
+   simulator_user_adapter sim;
+   sim.add_steps(o, values, sim_duration(1000));
+
+   BOOST_CHECK_EQUAL(0x01020304, sim.get_value(o));
+   sim.advance(sim_duration(1000));
+   BOOST_CHECK_EQUAL(0x05060708, sim.get_value(o));
+   sim.advance(sim_duration(1000));
+   BOOST_CHECK_EQUAL(0x01020304, sim.get_value(o));
+   sim.remove_dynamics(o);
+   sim.advance(sim_duration(1000));
+   BOOST_CHECK_EQUAL(0x01020304, sim.get_value(o));
+}
+
+BOOST_AUTO_TEST_CASE(MustProcessRequestsInOrder)
+{
+   simulator_user_adapter sim;
+   sim.set_value(offset(0x700, OFFSET_LEN_WORD), 0x0102);
+
+   valued_offset before(0x700, OFFSET_LEN_WORD, 0);
+   valued_offset after(0x700, OFFSET_LEN_WORD, 0);
+   std::uint8_t block[2];
+   sim.read(before);
+   sim.write(valued_offset(0x700, OFFSET_LEN_WORD, 0x0304));
+   sim.read(after);
+   sim.read_block(0x700, sizeof(block), block);
+   sim.process();
+
+   BOOST_CHECK_EQUAL(0x0102, before.value);
+   BOOST_CHECK_EQUAL(0x0304, after.value);
+   BOOST_CHECK_EQUAL(0x04, block[0]);
+   BOOST_CHECK_EQUAL(0x03, block[1]);
+   BOOST_CHECK_EQUAL(1, sim.process_count());
+   BOOST_CHECK_EQUAL(3, sim.read_count());
+   BOOST_CHECK_EQUAL(1, sim.write_count());
+}
+
+BOOST_AUTO_TEST_CASE(MustAdvanceTimeOnEachProcess)
+{
+   offset o(0x700, OFFSET_LEN_BYTE);
+   simulated_fsuipc_client client;
+   auto& sim = client.user_adapter();
+   sim.set_time_step(sim_duration(100));
+   sim.add_ramp(o, 0, 100, 1, sim_duration(100));
+
+   for (int i = 1; i <= 3; i++)
+   {
+      client.query(std::list<offset>(1, o), [i](const valued_offset& val)
+      {
+         BOOST_CHECK_EQUAL(offset_value(i), val.value);
+      });
+   }
+   BOOST_CHECK(sim_duration(300) == sim.now());
+}
+
+BOOST_AUTO_TEST_CASE(MustDriveUpdateObserver)
+{
+   const std::size_t NOFFSETS = 1000;
+   const std::size_t NCHECKS = 600;
+
+   // Emulate the 6 Hz tick with offsets changing at different rates, as
+   // the variables of an aircraft do
+   auto run = [&]() -> std::size_t
+   {
+      std::size_t updates = 0;
+      update_observer<simulator_user_adapter> observer(
+            [&updates](const valued_offset&) { updates++; });
+      auto& sim = observer.get_client().user_adapter();
+      sim.set_time_step(boost::chrono::milliseconds(166));
+      std::vector<offset> offsets;
+      for (std::size_t i = 0; i < NOFFSETS; i++)
+      {
+         offset o(offset_address(0x1000 + i * 4), OFFSET_LEN_DWORD);
+         auto period = boost::chrono::milliseconds(100 * (1 + i % 50));
+         if (i % 3 == 0)
+            sim.add_noise(o, 1000, 10, period);
+         else if (i % 3 == 1)
+            sim.add_ramp(o, 0, 100000, 7, period);
+         offsets.push_back(o);
+      }
+      observer.start_observing(offsets);
+
+      auto start = boost::chrono::steady_clock::now();
+      for (std::size_t i = 0; i < NCHECKS; i++)
+         observer.check_for_updates();
+      auto elapsed = boost::chrono::steady_clock::now() - start;
+
+      using boost::chrono::duration_cast;
+      using boost::chrono::microseconds;
+      BOOST_TEST_MESSAGE(
+            updates << " updates of " << NOFFSETS << " offsets in " <<
+            NCHECKS << " checks took " <<
+            duration_cast<microseconds>(elapsed).count() << " us");
+      return updates;
+   };
+
+   auto updates = run();
+   BOOST_CHECK_GT(updates, NOFFSETS);
+   BOOST_CHECK_EQUAL(updates, run());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+
+BOOST_AUTO_TEST_SUITE(FsuipcCapture)
+
+typedef capture_writer::duration capture_duration;
+
+/**
+ * A capture file on a temporary path, removed when the test finishes.
+ */
+struct temp_capture
+{
+   boost::filesystem::path path;
+
+   temp_capture()
+      : path(boost::filesystem::temp_directory_path() /
+             boost::filesystem::unique_path("oac-capture-%%%%-%%%%.bin"))
+   {}
+
+   ~temp_capture()
+   {
+      boost::system::error_code ec;
+      boost::filesystem::remove(path, ec);
+   }
+};
+
+void update_dword(shadow_memory& shadow, offset_address addr, std::uint32_t v)
+{
+   shadow.update(addr, reinterpret_cast<std::uint8_t*>(&v), sizeof(v));
+}
+
+BOOST_AUTO_TEST_CASE(MustStoreOnlyChangedChunks)
+{
+   temp_capture capture;
+   shadow_memory shadow;
+   capture_writer writer(capture.path);
+   update_dword(shadow, 0x0700, 1);
+   update_dword(shadow, 0x0704, 2);
+   update_dword(shadow, 0x2000, 3);
+   writer.record(shadow, capture_duration(10));
+   shadow.clear_changes();
+   writer.record(shadow, capture_duration(20));
+   writer.close();
+
+   BOOST_CHECK_EQUAL(2, writer.record_count());
+   BOOST_CHECK_EQUAL(
+         writer.size(), boost::filesystem::file_size(capture.path));
+
+   capture_reader reader(capture.path);
+   capture_reader::record rec;
+   BOOST_REQUIRE(reader.next(rec));
+   BOOST_CHECK(capture_duration(10) == rec.timestamp);
+   BOOST_CHECK_EQUAL(2, rec.chunk_count);
+   std::vector<offset_address> chunks;
+   capture_reader::for_each_chunk(rec, [&chunks](
+         offset_address addr, const std::uint8_t*)
+   {
+      chunks.push_back(addr);
+   });
+   BOOST_REQUIRE_EQUAL(2, chunks.size());
+   BOOST_CHECK_EQUAL(0x0700, chunks[0]);
+   BOOST_CHECK_EQUAL(0x2000, chunks[1]);
+
+   BOOST_REQUIRE(reader.next(rec));
+   BOOST_CHECK(capture_duration(20) == rec.timestamp);
+   BOOST_CHECK_EQUAL(0, rec.chunk_count);
+   BOOST_CHECK(!reader.next(rec));
+
+   reader.rewind();
+   BOOST_CHECK(reader.next(rec));
+   BOOST_CHECK(capture_duration(10) == rec.timestamp);
+}
+
+BOOST_AUTO_TEST_CASE(MustGrowCaptureFileAsNeeded)
+{
+   temp_capture capture;
+   shadow_memory shadow;
+   capture_writer writer(capture.path);
+   std::vector<std::uint8_t> data(0x10000);
+   auto records = 2 * capture_writer::GROWTH_SIZE / data.size() + 1;
+   for (std::size_t i = 0; i < records; i++)
+   {
+      std::fill(data.begin(), data.end(), std::uint8_t(i + 1));
+      shadow.update(0, data.data(), data.size());
+      writer.record(shadow, capture_duration(i));
+      shadow.clear_changes();
+   }
+   writer.close();
+
+   capture_reader reader(capture.path);
+   capture_reader::record rec;
+   std::size_t count = 0;
+   while (reader.next(rec))
+   {
+      BOOST_CHECK_EQUAL(capture_format::CHUNK_COUNT, rec.chunk_count);
+      BOOST_CHECK_EQUAL(count + 1, rec.data[0]);
+      count++;
+   }
+   BOOST_CHECK_EQUAL(records, count);
+}
+
+BOOST_AUTO_TEST_CASE(MustThrowOnReadingInvalidCapture)
+{
+   temp_capture capture;
+   {
+      std::ofstream file(capture.path.string(), std::ios::binary);
+      file << "NOTACAPTUREFILE!";
+   }
+   BOOST_CHECK_THROW(
+         capture_reader reader(capture.path), capture_format_error);
+}
+
+BOOST_AUTO_TEST_CASE(MustThrowOnReadingRecordWithCorruptBitmap)
+{
+   temp_capture capture;
+   {
+      shadow_memory shadow;
+      capture_writer writer(capture.path);
+      update_dword(shadow, 0x0700, 1);
+      writer.record(shadow, capture_duration(10));
+   }
+   {
+      // Mark more chunks in the bitmap than the record contains
+      std::fstream file(
+            capture.path.string(),
+            std::ios::binary | std::ios::in | std::ios::out);
+      file.seekp(
+            capture_format::HEADER_SIZE +
+            capture_format::RECORD_HEADER_SIZE + 100);
+      file.put(char(0xff));
+   }
+
+   capture_reader reader(capture.path);
+   capture_reader::record rec;
+   BOOST_CHECK_THROW(reader.next(rec), capture_format_error);
+}
+
+BOOST_AUTO_TEST_CASE(MustThrowOnReadingMissingCapture)
+{
+   temp_capture capture;
+   BOOST_CHECK_THROW(
+         capture_reader reader(capture.path), capture_open_error);
+}
+
+BOOST_AUTO_TEST_CASE(MustReplayOneRecordOnEachProcessWhenUnthrottled)
+{
+   temp_capture capture;
+   offset o(0x700, OFFSET_LEN_DWORD);
+   {
+      shadow_memory shadow;
+      capture_writer writer(capture.path);
+      for (std::uint32_t i = 1; i <= 3; i++)
+      {
+         update_dword(shadow, o.address, i * 100);
+         writer.record(shadow, capture_duration(i));
+         shadow.clear_changes();
+      }
+   }
+
+   replay_user_adapter replay;
+   replay.open(capture.path);
+   for (std::uint32_t i = 1; i <= 3; i++)
+   {
+      BOOST_CHECK(!replay.finished());
+      replay.process();
+      BOOST_CHECK_EQUAL(i * 100, replay.get_value(o));
+      BOOST_CHECK_EQUAL(i, replay.replayed_records());
+   }
+   BOOST_CHECK(replay.finished());
+   replay.process();
+   BOOST_CHECK_EQUAL(300, replay.get_value(o));
+}
+
+BOOST_AUTO_TEST_CASE(MustReproduceObservedUpdatesOnReplay)
+{
+   temp_capture capture;
+   std::vector<offset> offsets;
+   for (std::size_t i = 0; i < 50; i++)
+      offsets.push_back(
+            offset(offset_address(0x1000 + i * 4), OFFSET_LEN_DWORD));
+
+   typedef std::vector<valued_offset> update_list;
+   update_list recorded, replayed;
+
+   {
+      update_observer<simulator_user_adapter> observer(
+            [&recorded](const valued_offset& v) { recorded.push_back(v); });
+      auto& sim = observer.get_client().user_adapter();
+      sim.set_time_step(boost::chrono::milliseconds(100));
+      for (std::size_t i = 0; i < offsets.size(); i++)
+      {
+         auto period = boost::chrono::milliseconds(100 * (1 + i % 5));
+         sim.add_ramp(offsets[i], 0, 1000, 3, period);
+      }
+      auto writer = std::make_shared<capture_writer>(capture.path);
+      observer.set_check_handler([writer](shadow_memory& shadow)
+      {
+         writer->record(shadow);
+      });
+      observer.start_observing(offsets);
+      for (int i = 0; i < 20; i++)
+         observer.check_for_updates();
+   }
+
+   // Welcoming the offsets reads them, which would replay the first record
+   // before the first check, so the capture is open afterwards
+   update_observer<replay_user_adapter> observer(
+         [&replayed](const valued_offset& v) { replayed.push_back(v); });
+   observer.start_observing(offsets);
+   observer.get_client().user_adapter().open(capture.path);
+   for (int i = 0; i < 20; i++)
+      observer.check_for_updates();
+
+   BOOST_CHECK_GT(recorded.size(), offsets.size());
+   BOOST_REQUIRE_EQUAL(recorded.size(), replayed.size());
+   for (std::size_t i = 0; i < recorded.size(); i++)
+   {
+      BOOST_CHECK(recorded[i] == replayed[i]);
+      BOOST_CHECK_EQUAL(recorded[i].value, replayed[i].value);
+   }
+}
+
+BOOST_AUTO_TEST_CASE(MustReplayCaptureStartedAfterFirstCheck)
+{
+   temp_capture capture;
+   offset still(0x0700, OFFSET_LEN_DWORD);
+   offset moving(0x2000, OFFSET_LEN_DWORD);
+
+   {
+      update_observer<simulator_user_adapter> observer(
+            [](const valued_offset&) {});
+      auto& sim = observer.get_client().user_adapter();
+      sim.set_value(still, 42);
+      sim.set_value(moving, 1);
+      observer.start_observing(still);
+      observer.start_observing(moving);
+      observer.check_for_updates();
+
+      // The still offset does not change once the capture begins
+      auto writer = std::make_shared<capture_writer>(capture.path);
+      observer.set_check_handler([writer](shadow_memory& shadow)
+      {
+         writer->record(shadow);
+      });
+      sim.set_value(moving, 2);
+      observer.check_for_updates();
+   }
+
+   std::map<offset_address, offset_value> replayed;
+   update_observer<replay_user_adapter> observer(
+         [&replayed](const valued_offset& v) { replayed[v.address] = v.value; });
+   observer.start_observing(still);
+   observer.start_observing(moving);
+   observer.get_client().user_adapter().open(capture.path);
+   observer.check_for_updates();
+
+   BOOST_CHECK_EQUAL(42, replayed[still.address]);
+   BOOST_CHECK_EQUAL(2, replayed[moving.address]);
+}
+
+BOOST_AUTO_TEST_CASE(MustForgetChangesWhenCheckHandlerThrows)
+{
+   std::size_t updates = 0;
+   update_observer<simulator_user_adapter> observer(
+         [&updates](const valued_offset&) { updates++; });
+   auto& sim = observer.get_client().user_adapter();
+   offset o(0x0700, OFFSET_LEN_DWORD);
+   observer.start_observing(o);
+   observer.set_check_handler([](shadow_memory&)
+   {
+      throw std::runtime_error("cannot record");
+   });
+   sim.set_value(o, 7);
+   BOOST_CHECK_THROW(observer.check_for_updates(), std::runtime_error);
+   BOOST_CHECK_EQUAL(1, updates);
+
+   observer.set_check_handler(nullptr);
+   observer.check_for_updates();
+   BOOST_CHECK_EQUAL(1, updates);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -91,6 +91,35 @@ struct let_test
       return *this;
    }
 
+   let_test& send_http_get_gathered()
+   {
+      linear_buffer request_line(4096);
+      linear_buffer headers(4096);
+      std::size_t bytes_written = 0;
+
+      auto on_write = [&bytes_written](
+            const attempt<std::size_t>& nbytes)
+      {
+         bytes_written = nbytes.get_value();
+      };
+
+      stream::write_as_string(request_line, "GET / HTTP/1.1\n");
+      stream::write_as_string(headers, "Host: www.google.com\n");
+      stream::write_as_string(headers, "User-Agent: liboac-network\n");
+      stream::write_as_string(headers, "\n");
+
+      std::vector<boost::asio::const_buffer> buffers;
+      buffers.push_back(request_line.read_region());
+      buffers.push_back(headers.read_region());
+
+      _client->connection().write_all(buffers, on_write);
+      _io_srv->reset();
+      _io_srv->run();
+
+      BOOST_CHECK_EQUAL(15+21+27+1, bytes_written);
+      return *this;
+   }
+
    let_test& receive_http_response()
    {
       linear_buffer input_buffer(4096);
@@ -149,6 +178,15 @@ BOOST_AUTO_TEST_CASE(MustConnectToExistingHostWithAvailablePortUsingFutures)
          .close();
 }
 
+BOOST_AUTO_TEST_CASE(MustWriteGatheredBuffers)
+{
+   let_test()
+         .connect("www.google.com", 80)
+         .send_http_get_gathered()
+         .receive_http_response()
+         .close();
+}
+
 BOOST_AUTO_TEST_CASE(MustFailWhileConnectingToUnexistingHost)
 {
    BOOST_CHECK_THROW(
@@ -0,0 +1,132 @@
+/*
+ * This file is part of Open Airbus Cockpit
+ * Copyright (C) 2012, 2013 Alvaro Polo
+ *
+ * Open Airbus Cockpit is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Open Airbus Cockpit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Open Airbus Cockpit. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_AUTO_TEST_MAIN
+#include <boost/test/auto_unit_test.hpp>
+
+#include <set>
+#include <string>
+
+#include <liboac/slot_map.h>
+
+using namespace oac;
+
+BOOST_AUTO_TEST_SUITE(SlotMapTest)
+
+BOOST_AUTO_TEST_CASE(MustFindInsertedValues)
+{
+   slot_map<std::string> map;
+   auto k1 = map.insert("foo");
+   auto k2 = map.insert("bar");
+   BOOST_CHECK_NE(k1, k2);
+   BOOST_CHECK_EQUAL(2, map.size());
+   BOOST_REQUIRE(map.find(k1));
+   BOOST_CHECK_EQUAL("foo", *map.find(k1));
+   BOOST_REQUIRE(map.find(k2));
+   BOOST_CHECK_EQUAL("bar", *map.find(k2));
+}
+
+BOOST_AUTO_TEST_CASE(MustNeverIssueKeyZero)
+{
+   slot_map<int> map;
+   for (int i = 0; i < 10; i++)
+   {
+      auto k = map.insert(i);
+      BOOST_CHECK_NE(0, k);
+      map.erase(k);
+   }
+   BOOST_CHECK(!map.find(0));
+}
+
+BOOST_AUTO_TEST_CASE(MustNotFindErasedValues)
+{
+   slot_map<int> map;
+   auto k = map.insert(7);
+   BOOST_CHECK(map.erase(k));
+   BOOST_CHECK(!map.contains(k));
+   BOOST_CHECK(!map.erase(k));
+   BOOST_CHECK(map.empty());
+}
+
+BOOST_AUTO_TEST_CASE(MustDetectStaleKeysAfterSlotReuse)
+{
+   slot_map<int> map;
+   auto k1 = map.insert(1);
+   map.erase(k1);
+   auto k2 = map.insert(2);
+   BOOST_CHECK_NE(k1, k2);
+   BOOST_CHECK(!map.find(k1));
+   BOOST_REQUIRE(map.find(k2));
+   BOOST_CHECK_EQUAL(2, *map.find(k2));
+}
+
+BOOST_AUTO_TEST_CASE(MustReuseFreeSlots)
+{
+   slot_map<int> map;
+   std::set<slot_map<int>::key_type> keys;
+   for (int i = 0; i < 1000; i++)
+   {
+      auto k = map.insert(i);
+      keys.insert(k);
+      map.erase(k);
+   }
+   BOOST_CHECK_EQUAL(1000, keys.size());
+   BOOST_CHECK(map.empty());
+}
+
+BOOST_AUTO_TEST_CASE(MustIterateOverStoredValues)
+{
+   slot_map<int> map;
+   auto k1 = map.insert(1);
+   auto k2 = map.insert(2);
+   auto k3 = map.insert(3);
+   map.erase(k2);
+
+   int sum = 0;
+   std::set<slot_map<int>::key_type> keys;
+   map.for_each([&](slot_map<int>::key_type k, int& v)
+   {
+      keys.insert(k);
+      sum += v;
+   });
+   BOOST_CHECK_EQUAL(4, sum);
+   BOOST_CHECK_EQUAL(2, keys.size());
+   BOOST_CHECK(keys.count(k1));
+   BOOST_CHECK(keys.count(k3));
+}
+
+BOOST_AUTO_TEST_CASE(MustInvalidateKeysOnClear)
+{
+   slot_map<int> map;
+   auto k1 = map.insert(1);
+   auto k2 = map.insert(2);
+   map.clear();
+   BOOST_CHECK(map.empty());
+   BOOST_CHECK(!map.find(k1));
+   BOOST_CHECK(!map.find(k2));
+}
+
+BOOST_AUTO_TEST_CASE(MustThrowWhenFull)
+{
+   slot_map<char> map;
+   for (std::size_t i = 0; i < slot_map<char>::MAX_SIZE; i++)
+      map.insert('x');
+   BOOST_CHECK_THROW(map.insert('x'), slot_map_full_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
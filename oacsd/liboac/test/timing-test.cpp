@@ -20,6 +20,7 @@
 
 #define BOOST_AUTO_TEST_MAIN
 #include <boost/test/auto_unit_test.hpp>
+#include <boost/thread.hpp>
 
 #include <liboac/timing.h>
 
@@ -60,11 +61,201 @@ BOOST_AUTO_TEST_CASE(MustInvokeHandlersOnTick)
    for (int i = 1; i < 64; i++)
    {
       obs.delegate().tick();
-      int runs = 0;
-      while (runs < 2) { runs += io_srv->run_one(); }
+      io_srv->reset();
+      BOOST_CHECK_EQUAL(2, io_srv->poll());
       BOOST_CHECK_EQUAL(i, num1);
       BOOST_CHECK_EQUAL(-i, num2);
    }
 }
 
+BOOST_AUTO_TEST_CASE(MustCoalesceTicksWhileHandlerIsPending)
+{
+   auto io_srv = std::make_shared<boost::asio::io_service>();
+   asio_tick_observer_adapter<dummy_tick_observer> obs(io_srv);
+   int num = 0;
+   auto id = obs.register_handler([&num]() { num++; });
+
+   obs.delegate().tick();
+   obs.delegate().tick();
+   obs.delegate().tick();
+   io_srv->reset();
+   BOOST_CHECK_EQUAL(1, io_srv->poll());
+   BOOST_CHECK_EQUAL(1, num);
+
+   obs.delegate().tick();
+   io_srv->reset();
+   BOOST_CHECK_EQUAL(1, io_srv->poll());
+   BOOST_CHECK_EQUAL(2, num);
+
+   auto stats = obs.get_stats(id);
+   BOOST_CHECK_EQUAL(2, stats.handled_ticks);
+   BOOST_CHECK_EQUAL(2, stats.overruns);
+}
+
+BOOST_AUTO_TEST_CASE(MustCountOverrunsWhileHandlerIsRunning)
+{
+   auto io_srv = std::make_shared<boost::asio::io_service>();
+   asio_tick_observer_adapter<dummy_tick_observer> obs(io_srv);
+   auto id = obs.register_handler([&obs]() { obs.delegate().tick(); });
+
+   obs.delegate().tick();
+   io_srv->reset();
+   BOOST_CHECK_EQUAL(1, io_srv->poll());
+
+   auto stats = obs.get_stats(id);
+   BOOST_CHECK_EQUAL(1, stats.handled_ticks);
+   BOOST_CHECK_EQUAL(1, stats.overruns);
+}
+
+BOOST_AUTO_TEST_CASE(MustGatherJitterAndDurationOfHandlers)
+{
+   auto io_srv = std::make_shared<boost::asio::io_service>();
+   asio_tick_observer_adapter<dummy_tick_observer> obs(io_srv);
+   auto id = obs.register_handler([]()
+   {
+      boost::this_thread::sleep_for(boost::chrono::milliseconds(5));
+   });
+
+   obs.delegate().tick();
+   boost::this_thread::sleep_for(boost::chrono::milliseconds(5));
+   io_srv->reset();
+   io_srv->poll();
+
+   auto stats = obs.get_stats(id);
+   BOOST_CHECK_EQUAL(1, stats.jitter.total());
+   BOOST_CHECK_EQUAL(1, stats.duration.total());
+   BOOST_CHECK_GE(stats.jitter.max().count(), 5000);
+   BOOST_CHECK_GE(stats.duration.max().count(), 5000);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+
+BOOST_AUTO_TEST_SUITE(TickHistogram)
+
+BOOST_AUTO_TEST_CASE(MustCountSamplesInPowerOfTwoBuckets)
+{
+   typedef tick_histogram::duration usecs;
+   tick_histogram hist;
+   hist.add(usecs(0));
+   hist.add(usecs(1));
+   hist.add(usecs(3));
+   hist.add(usecs(4));
+   hist.add(usecs(1000));
+
+   BOOST_CHECK_EQUAL(1, hist.count(0));
+   BOOST_CHECK_EQUAL(1, hist.count(1));
+   BOOST_CHECK_EQUAL(1, hist.count(2));
+   BOOST_CHECK_EQUAL(1, hist.count(3));
+   BOOST_CHECK_EQUAL(1, hist.count(10));
+   BOOST_CHECK_EQUAL(5, hist.total());
+   BOOST_CHECK(usecs(1000) == hist.max());
+}
+
+BOOST_AUTO_TEST_CASE(MustCountLongSamplesInLastBucket)
+{
+   tick_histogram hist;
+   hist.add(tick_histogram::duration(60 * 1000 * 1000));
+   BOOST_CHECK_EQUAL(1, hist.count(tick_histogram::BUCKET_COUNT - 1));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+
+BOOST_AUTO_TEST_SUITE(TickScheduler)
+
+typedef tick_scheduler::duration tick_duration;
+
+BOOST_AUTO_TEST_CASE(MustNotifyEachGroupAtItsOwnRate)
+{
+   auto io_srv = std::make_shared<boost::asio::io_service>();
+   tick_scheduler sched(io_srv);
+   sched.add_group("fast", tick_duration(10));
+   sched.add_group("slow", tick_duration(50));
+   int fast = 0, slow = 0;
+   sched.register_handler("fast", [&fast]() { fast++; });
+   sched.register_handler("slow", [&]()
+   {
+      if (++slow == 4)
+         sched.stop();
+   });
+   io_srv->run();
+
+   BOOST_CHECK_EQUAL(4, slow);
+   BOOST_CHECK_EQUAL(4, sched.group("slow").tick_count());
+   BOOST_CHECK_GE(fast, 15);
+   BOOST_CHECK_LE(fast, 20);
+}
+
+BOOST_AUTO_TEST_CASE(MustNotifyGroupsWithPeriodBeyondWheelTurn)
+{
+   auto io_srv = std::make_shared<boost::asio::io_service>();
+   tick_scheduler sched(io_srv, tick_duration(1));
+   auto period = tick_duration(tick_scheduler::WHEEL_SIZE + 44);
+   auto& grp = sched.add_group("slow", period);
+   auto start = tick_scheduler::clock_type::now();
+   tick_scheduler::clock_type::time_point notified;
+   grp.register_handler([&]()
+   {
+      notified = tick_scheduler::clock_type::now();
+      sched.stop();
+   });
+   io_srv->run();
+
+   BOOST_CHECK_EQUAL(1, grp.tick_count());
+   BOOST_CHECK(notified - start >= period);
+}
+
+BOOST_AUTO_TEST_CASE(MustNotNotifyMissedTicksLate)
+{
+   auto io_srv = std::make_shared<boost::asio::io_service>();
+   tick_scheduler sched(io_srv);
+   sched.add_group("fast", tick_duration(5));
+   int ticks = 0;
+   sched.register_handler("fast", [&]()
+   {
+      // Block the scheduler for four periods on the first tick
+      if (++ticks == 1)
+         boost::this_thread::sleep_for(boost::chrono::milliseconds(20));
+      else
+         sched.stop();
+   });
+   auto start = tick_scheduler::clock_type::now();
+   io_srv->run();
+
+   BOOST_CHECK_EQUAL(2, ticks);
+   BOOST_CHECK(
+         tick_scheduler::clock_type::now() - start >= tick_duration(30));
+}
+
+BOOST_AUTO_TEST_CASE(MustThrowOnAddingExistingGroup)
+{
+   auto io_srv = std::make_shared<boost::asio::io_service>();
+   tick_scheduler sched(io_srv);
+   sched.add_group("6hz", tick_duration(166));
+   BOOST_CHECK_THROW(
+         sched.add_group("6hz", tick_duration(100)),
+         tick_scheduler::group_already_exists_error);
+}
+
+BOOST_AUTO_TEST_CASE(MustThrowOnAddingGroupWithPeriodBelowResolution)
+{
+   auto io_srv = std::make_shared<boost::asio::io_service>();
+   tick_scheduler sched(io_srv, tick_duration(10));
+   BOOST_CHECK_THROW(
+         sched.add_group("fast", tick_duration(5)),
+         tick_scheduler::invalid_period_error);
+}
+
+BOOST_AUTO_TEST_CASE(MustThrowOnRegisteringHandlerOnUnknownGroup)
+{
+   auto io_srv = std::make_shared<boost::asio::io_service>();
+   tick_scheduler sched(io_srv);
+   BOOST_CHECK_THROW(
+         sched.register_handler("1hz", []() {}),
+         tick_scheduler::no_such_group_error);
+}
+
 BOOST_AUTO_TEST_SUITE_END()